@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rosekv {
+
+/// A bump allocator carving small allocations out of large blocks, all freed
+/// at once when the arena is destroyed.
+///
+/// Memtable entries are never freed individually, so an arena turns each of
+/// their allocations into a pointer increment and keeps them packed in a few
+/// large blocks instead of scattering them over the heap. An `Arena` is not
+/// thread-safe, see `ConcurrentArena`.
+class Arena {
+ public:
+  static constexpr std::size_t kDefaultBlockSize = 4 * 1024 * 1024;
+  static constexpr std::size_t kAlignUnit = alignof(std::max_align_t);
+
+  /// \param block_size The size of the blocks requested from the system.
+  /// \param huge_pages Whether to back blocks with explicit huge pages, which
+  ///                   saves TLB misses on large memtables. Falls back to
+  ///                   regular pages if none are available.
+  explicit Arena(std::size_t block_size = kDefaultBlockSize,
+                 bool huge_pages = false);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /// \return `bytes` bytes of uninitialized memory, `bytes` > 0.
+  char* Allocate(std::size_t bytes) {
+    if (bytes <= alloc_bytes_remaining_) {
+      auto result = alloc_ptr_;
+      alloc_ptr_ += bytes;
+      alloc_bytes_remaining_ -= bytes;
+
+      return result;
+    }
+
+    return AllocateFallback(bytes);
+  }
+
+  /// Like `Allocate()`, but aligned to `kAlignUnit`.
+  char* AllocateAligned(std::size_t bytes);
+
+  /// \return The number of bytes the arena has requested from the system.
+  ///         Thread-safe.
+  std::size_t MemoryUsage() const {
+    return memory_usage_.load(std::memory_order_relaxed);
+  }
+
+  std::size_t BlockSize() const { return block_size_; }
+
+ private:
+  struct Block {
+    char* data;
+    std::size_t size;
+    /// Whether the block was mapped rather than allocated with `new[]`.
+    bool mapped;
+  };
+
+  char* AllocateFallback(std::size_t bytes);
+  char* AllocateNewBlock(std::size_t block_bytes);
+
+  const std::size_t block_size_;
+  const bool huge_pages_;
+  char* alloc_ptr_ = nullptr;
+  std::size_t alloc_bytes_remaining_ = 0;
+  std::vector<Block> blocks_;
+  std::atomic<std::size_t> memory_usage_{0};
+};
+
+/// An arena safe to allocate from concurrently.
+///
+/// Allocations are served from per-core shards, each owning a slice of a
+/// block of the underlying arena, so that threads running on different cores
+/// seldom contend on the same lock or cache line. Only refilling a shard, or
+/// an allocation too large for a shard, locks the whole arena.
+class ConcurrentArena {
+ public:
+  explicit ConcurrentArena(std::size_t block_size = Arena::kDefaultBlockSize,
+                           bool huge_pages = false);
+
+  char* Allocate(std::size_t bytes) { return AllocateImpl(bytes, false); }
+
+  char* AllocateAligned(std::size_t bytes) { return AllocateImpl(bytes, true); }
+
+  /// \return The number of bytes the arena has requested from the system.
+  std::size_t MemoryUsage() const { return arena_.MemoryUsage(); }
+
+ private:
+  struct alignas(64) Shard {
+    std::mutex mtx;
+    char* free_begin = nullptr;
+    std::size_t allocated_and_unused = 0;
+  };
+
+  char* AllocateImpl(std::size_t bytes, bool aligned);
+
+  /// \return The shard of the core the calling thread runs on.
+  Shard* CurrentShard();
+
+  std::mutex arena_mtx_;
+  Arena arena_;
+  const std::size_t shard_block_size_;
+  std::size_t shard_mask_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <kiwi/util/byte_order.hh>
+#include <string>
+#include <string_view>
+
+namespace rosekv {
+
+/// Encoding helpers for the key-value layer. Fixed-width integers are stored
+/// little-endian, variable-width ones as LEB128 varints.
+
+/// \return The number of bytes `value` takes up as a varint.
+inline int VarintLength(uint64_t value) {
+  int len = 1;
+
+  for (; value >= 0x80; value >>= 7) {
+    ++len;
+  }
+
+  return len;
+}
+
+/// Encodes `value` as a varint at `ptr`, which must have room for it.
+///
+/// \return The pointer right after the encoded value.
+inline char* EncodeVarint64(char* ptr, uint64_t value) {
+  auto p = reinterpret_cast<uint8_t*>(ptr);
+
+  for (; value >= 0x80; value >>= 7) {
+    *p++ = static_cast<uint8_t>(value | 0x80);
+  }
+
+  *p++ = static_cast<uint8_t>(value);
+
+  return reinterpret_cast<char*>(p);
+}
+
+inline void PutVarint64(std::string* dst, uint64_t value) {
+  char buf[10];
+  dst->append(buf, EncodeVarint64(buf, value) - buf);
+}
+
+inline void PutFixed32(std::string* dst, uint32_t value) {
+  char buf[sizeof(value)];
+  kiwi::LittleEndian::PutUint32(reinterpret_cast<uint8_t*>(buf), value);
+  dst->append(buf, sizeof(buf));
+}
+
+inline void PutFixed64(std::string* dst, uint64_t value) {
+  char buf[sizeof(value)];
+  kiwi::LittleEndian::PutUint64(reinterpret_cast<uint8_t*>(buf), value);
+  dst->append(buf, sizeof(buf));
+}
+
+/// Appends `value` prefixed with its length as a varint.
+inline void PutLengthPrefixed(std::string* dst, std::string_view value) {
+  PutVarint64(dst, value.size());
+  dst->append(value);
+}
+
+inline uint32_t DecodeFixed32(const char* ptr) {
+  return kiwi::LittleEndian::Uint32(reinterpret_cast<const uint8_t*>(ptr));
+}
+
+inline uint64_t DecodeFixed64(const char* ptr) {
+  return kiwi::LittleEndian::Uint64(reinterpret_cast<const uint8_t*>(ptr));
+}
+
+/// Decodes a varint from `[ptr, limit)`.
+///
+/// \return The pointer right after the varint, or null if it is truncated or
+///         longer than 10 bytes.
+inline const char* DecodeVarint64(const char* ptr, const char* limit,
+                                  uint64_t* value) {
+  uint64_t result = 0;
+
+  for (int shift = 0; shift < 64 && ptr < limit; shift += 7) {
+    auto byte = static_cast<uint8_t>(*ptr++);
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return ptr;
+    }
+  }
+
+  return nullptr;
+}
+
+/// Consumes a varint from the front of `input`.
+///
+/// \return `false` if `input` does not start with a valid varint.
+inline bool GetVarint64(std::string_view* input, uint64_t* value) {
+  auto end = input->data() + input->size();
+  auto ptr = DecodeVarint64(input->data(), end, value);
+
+  if (ptr == nullptr) {
+    return false;
+  }
+
+  input->remove_prefix(ptr - input->data());
+
+  return true;
+}
+
+/// Consumes a fixed 64-bit integer from the front of `input`.
+inline bool GetFixed64(std::string_view* input, uint64_t* value) {
+  if (input->size() < sizeof(*value)) {
+    return false;
+  }
+
+  *value = DecodeFixed64(input->data());
+  input->remove_prefix(sizeof(*value));
+
+  return true;
+}
+
+/// Consumes a length-prefixed string from the front of `input`.
+inline bool GetLengthPrefixed(std::string_view* input,
+                              std::string_view* value) {
+  uint64_t len;
+
+  if (!GetVarint64(input, &len) || input->size() < len) {
+    return false;
+  }
+
+  *value = input->substr(0, len);
+  input->remove_prefix(len);
+
+  return true;
+}
+
+}  // namespace rosekv
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "rosekv/db/version.hh"
+
+namespace rosekv {
+
+/// The input files of a compaction at one level.
+struct CompactionInputs {
+  int level;
+  std::vector<std::shared_ptr<FileMetaData>> files;
+};
+
+/// A set of table files to merge into new files at the output level,
+/// dropping the versions of keys that are shadowed by newer ones.
+class Compaction {
+ public:
+  /// \param input_version The version the inputs were picked from.
+  /// \param inputs The input files, from the start level down.
+  /// \param output_level The level the merged files are written to.
+  /// \param score How far the start level is over its target, for logging.
+  /// \param max_output_file_size The size output files are cut at.
+  Compaction(std::shared_ptr<const Version> input_version,
+             std::vector<CompactionInputs> inputs, int output_level,
+             double score, uint64_t max_output_file_size);
+
+  const Version& input_version() const { return *input_version_; }
+  const std::vector<CompactionInputs>& inputs() const { return inputs_; }
+  int start_level() const { return inputs_.front().level; }
+  int output_level() const { return output_level_; }
+  double score() const { return score_; }
+  uint64_t max_output_file_size() const { return max_output_file_size_; }
+
+  std::size_t NumInputFiles() const;
+  uint64_t TotalInputBytes() const;
+
+  /// Sets whether the input files are being compacted, so that concurrent
+  /// compactions never pick them. Requires the mutex of the database.
+  void MarkFilesBeingCompacted(bool being_compacted) const;
+
+  /// Records the removal of the input files in `edit`.
+  void AddInputDeletions(VersionEdit* edit) const;
+
+  /// \return Whether no data older than the inputs holds `user_key`, in
+  ///         which case a deletion of it can be dropped. Thread-safe, so
+  ///         that subcompactions can share it.
+  bool IsBaseLevelForKey(std::string_view user_key) const;
+
+ private:
+  std::shared_ptr<const Version> input_version_;
+  std::vector<CompactionInputs> inputs_;
+  int output_level_;
+  double score_;
+  uint64_t max_output_file_size_;
+  /// The files of level 0 holding older data than the inputs, which only
+  /// exist when the output level is 0.
+  std::vector<std::shared_ptr<FileMetaData>> older_level0_files_;
+};
+
+}  // namespace rosekv
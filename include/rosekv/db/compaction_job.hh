@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <kiwi/io/file_path.hh>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "rosekv/db/compaction.hh"
+#include "rosekv/db/options.hh"
+#include "rosekv/db/thread_pool.hh"
+#include "rosekv/table/table_builder.hh"
+
+namespace rosekv {
+
+/// Statistics of a compaction.
+struct CompactionStats {
+  uint64_t num_input_files = 0;
+  uint64_t num_output_files = 0;
+  uint64_t num_subcompactions = 0;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+  uint64_t num_input_records = 0;
+  /// The records dropped because a newer version shadows them, or because
+  /// they are deletions with nothing left to delete.
+  uint64_t num_dropped_records = 0;
+  uint64_t micros = 0;
+
+  void Add(const CompactionStats& other) {
+    num_input_files += other.num_input_files;
+    num_output_files += other.num_output_files;
+    num_subcompactions += other.num_subcompactions;
+    bytes_read += other.bytes_read;
+    bytes_written += other.bytes_written;
+    num_input_records += other.num_input_records;
+    num_dropped_records += other.num_dropped_records;
+    micros += other.micros;
+  }
+};
+
+/// Runs a compaction: merges its input files into new tables at the output
+/// level, keeping only the newest version of each key.
+///
+/// A large compaction is split into subcompactions over disjoint ranges of
+/// user keys, which merge their range concurrently on the compaction pool
+/// and write their own output files.
+class CompactionJob {
+ public:
+  /// \param new_file_number Returns a number for a new table file.
+  ///                        Thread-safe.
+  /// \param shutting_down Set when the database is being closed, which
+  ///                      cancels the job.
+  /// \param pool The pool running subcompactions, or null to run them all
+  ///             on the calling thread.
+  CompactionJob(const DBOptions& options, const kiwi::FilePath& db_path,
+                Compaction* compaction,
+                std::function<uint64_t()> new_file_number,
+                const std::atomic<bool>* shutting_down, ThreadPool* pool);
+
+  CompactionJob(const CompactionJob&) = delete;
+  CompactionJob& operator=(const CompactionJob&) = delete;
+
+  /// Writes the output tables. The outputs are deleted on error, and
+  /// otherwise remain unused until the edit of `AddToEdit()` is applied.
+  ///
+  /// \param ec Set if an input could not be read or an output written, or
+  ///           to `std::errc::operation_canceled` when shutting down.
+  void Run(std::error_code& ec);
+
+  /// Records the replacement of the inputs by the outputs in `edit`.
+  void AddToEdit(VersionEdit* edit) const;
+
+  const CompactionStats& GetStats() const { return stats_; }
+
+ private:
+  /// The part of a compaction over the user keys in [`start`, `end`), where
+  /// a missing bound is unbounded.
+  struct Subcompaction {
+    std::optional<std::string> start;
+    std::optional<std::string> end;
+
+    std::unique_ptr<TableBuilder> builder;
+    uint64_t output_number = 0;
+    std::vector<uint64_t> pending_outputs;
+    std::vector<std::shared_ptr<FileMetaData>> outputs;
+    CompactionStats stats;
+    std::error_code status;
+  };
+
+  /// Splits the key range of the inputs into subcompactions holding about
+  /// the same number of input bytes.
+  void GenSubcompactions();
+
+  /// Runs the subcompactions, on the calling thread and on idle threads of
+  /// the pool.
+  void RunSubcompactions();
+
+  void ProcessKeyValues(Subcompaction* sub);
+  void OpenOutput(Subcompaction* sub);
+  void FinishOutput(Subcompaction* sub, std::error_code& ec);
+  void DeleteOutputs(Subcompaction* sub);
+
+  DBOptions options_;
+  kiwi::FilePath db_path_;
+  Compaction* compaction_;
+  std::function<uint64_t()> new_file_number_;
+  const std::atomic<bool>* shutting_down_;
+  ThreadPool* pool_;
+
+  std::vector<Subcompaction> subcompactions_;
+  CompactionStats stats_;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+
+#include "rosekv/db/compaction.hh"
+#include "rosekv/db/options.hh"
+#include "rosekv/db/version.hh"
+
+namespace rosekv {
+
+/// Decides which files to compact next.
+class CompactionPicker {
+ public:
+  virtual ~CompactionPicker() = default;
+
+  /// Picks the most urgent compaction among the files of `version` that are
+  /// not being compacted, and marks its inputs as being compacted. Requires
+  /// the mutex of the database.
+  ///
+  /// \return The compaction, or null if none is needed or possible.
+  virtual std::unique_ptr<Compaction> PickCompaction(
+      std::shared_ptr<const Version> version) = 0;
+};
+
+/// Creates a picker for leveled compaction.
+///
+/// Each level is scored by how far it is over its target: level 0 by its
+/// number of files against `level0_file_num_compaction_trigger`, level n by
+/// its size against `max_bytes_for_level_base` times
+/// `max_bytes_for_level_multiplier` to the power n - 1. The level with the
+/// highest score of at least 1 is compacted into the next one: all of level
+/// 0 at once since its files overlap, or one file of a deeper level at a
+/// time, round-robin over its key range, along with the files it overlaps
+/// in the next level. Compactions run concurrently as long as their inputs
+/// are disjoint.
+std::unique_ptr<CompactionPicker> NewLeveledCompactionPicker(
+    const DBOptions& options);
+
+/// Creates a picker for tiered compaction.
+///
+/// Every file of level 0 and every deeper level is a sorted run, and runs
+/// are ordered from the newest to the oldest data. Once there are
+/// `level0_file_num_compaction_trigger` runs, adjacent runs are merged into
+/// one, taking the place of the oldest:
+///
+/// 1. All of them, if the newer runs hold more than
+///    `tiered_max_size_amplification_percent` of the size of the oldest.
+/// 2. Otherwise, the newest window of `tiered_min_merge_width` to
+///    `tiered_max_merge_width` runs of similar sizes, within
+///    `tiered_size_ratio`.
+/// 3. Otherwise, enough of the newest runs to get back under the trigger.
+///
+/// Each byte is thus rewritten about once per doubling of its run, rather
+/// than once per level, while lookups search every run.
+std::unique_ptr<CompactionPicker> NewTieredCompactionPicker(
+    const DBOptions& options);
+
+}  // namespace rosekv
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "rosekv/db/compaction_job.hh"
+#include "rosekv/db/compaction_picker.hh"
+#include "rosekv/db/dbformat.hh"
+#include "rosekv/db/error_code.hh"
+#include "rosekv/db/memtable.hh"
+#include "rosekv/db/options.hh"
+#include "rosekv/db/thread_pool.hh"
+#include "rosekv/db/version.hh"
+#include "rosekv/wal/wal.hh"
+
+namespace rosekv {
+
+/// Cumulative statistics of the flushes and compactions of a database since
+/// it was opened, e.g. to compare compaction styles.
+struct DBStats {
+  uint64_t num_flushes = 0;
+  uint64_t bytes_flushed = 0;
+  uint64_t num_compactions = 0;
+  /// The sums over all compactions.
+  CompactionStats compactions;
+  /// The sorted runs a lookup may search: the files of level 0 and the
+  /// deeper levels holding files.
+  std::size_t num_sorted_runs = 0;
+
+  /// \return The bytes written to table files per byte flushed.
+  double WriteAmplification() const {
+    return bytes_flushed == 0
+               ? 0
+               : static_cast<double>(bytes_flushed +
+                                     compactions.bytes_written) /
+                     bytes_flushed;
+  }
+};
+
+/// A key-value store logging every update to a WAL before applying it to an
+/// in-memory table.
+///
+/// Each update is written to the WAL as a single record:
+///
+/// ------------------------------------------------------------------------
+/// | Sequence number << 8 | Type (8 bytes) | Key length (varint) | Key |
+/// | Value |
+/// ------------------------------------------------------------------------
+///
+/// On open, the records found in the WAL are replayed into the memtable.
+/// Writers run concurrently: each one takes the next sequence number,
+/// appends its record and inserts into the memtable under a shared lock
+/// only, and readers never block writers.
+///
+/// Once the memtable reaches `write_buffer_size`, it becomes immutable and a
+/// new memtable and WAL segment take the writes. A background thread writes
+/// immutable memtables, oldest first, to level 0 table files, then drops
+/// the WAL segments holding their records. Compactions picked according to
+/// `compaction_style` then merge the tables down the levels on a pool of
+/// `max_background_compactions` threads. Lookups go from the memtable to the
+/// immutable memtables to the tables, newest first.
+class DB {
+ public:
+  /// Opens the database in `options.db_dir`, creating it if needed, and
+  /// replays its WAL.
+  explicit DB(const DBOptions& options);
+
+  /// Cancels the running compactions and waits for them and for the flush
+  /// in progress, if any. Memtables still waiting to be flushed are
+  /// recovered from the WAL on the next open.
+  ~DB();
+
+  DB(const DB&) = delete;
+  DB& operator=(const DB&) = delete;
+
+  /// Sets `key` to `value`.
+  ///
+  /// \param ec Set if the database failed to open or the WAL write failed.
+  void Put(std::string_view key, std::string_view value, std::error_code& ec);
+
+  /// Removes `key`, if present.
+  ///
+  /// \param ec Set if the database failed to open or the WAL write failed.
+  void Delete(std::string_view key, std::error_code& ec);
+
+  /// Looks up the latest value of `key`.
+  ///
+  /// \param ec Set if the database failed to open or a table could not be
+  ///           read.
+  /// \return The value, or `std::nullopt` if the key is absent or on error.
+  std::optional<std::string> Get(std::string_view key, std::error_code& ec);
+
+  /// Flushes the memtable and waits until no immutable memtable is left.
+  ///
+  /// \param ec Set if the database failed to open or a flush failed.
+  void Flush(std::error_code& ec);
+
+  /// Waits until no compaction is running or needed.
+  ///
+  /// \param ec Set if the database failed to open or a compaction failed.
+  void WaitForCompactions(std::error_code& ec);
+
+  /// \return The number of bytes of memory held by the active memtable.
+  std::size_t ApproximateMemTableUsage();
+
+  /// \return The number of immutable memtables waiting to be flushed.
+  std::size_t NumImmutableMemTables();
+
+  /// \return The number of table files.
+  std::size_t NumTableFiles();
+
+  /// \return The number of table files at `level`.
+  std::size_t NumFilesAtLevel(int level);
+
+  DBStats GetStats();
+
+  /// \return The error encountered while opening the database, if any. A
+  ///         database that failed to open rejects all operations with it.
+  std::error_code Status() const { return status_; }
+
+ private:
+  /// A memtable that no longer takes writes, waiting to be flushed.
+  struct ImmutableMemTable {
+    std::shared_ptr<MemTable> mem;
+    /// The start of the WAL segment created when the memtable was switched.
+    /// Once the memtable is flushed, the segments before it can be dropped.
+    LSN wal_end;
+  };
+
+  /// The memtables and tables a lookup goes through. A view is never
+  /// modified: switching or flushing a memtable and compacting install a
+  /// new one, so that readers only hold `read_view_mtx_` to take a
+  /// reference to the current view.
+  struct ReadView {
+    std::shared_ptr<MemTable> mem;
+    /// Newest first.
+    std::vector<std::shared_ptr<MemTable>> imm;
+    std::shared_ptr<const Version> version;
+  };
+
+  void Write(ValueType type, std::string_view key, std::string_view value,
+             std::error_code& ec);
+
+  /// Makes the active memtable immutable and starts a new memtable and WAL
+  /// segment. Blocks while `max_immutable_memtables` are already waiting.
+  /// Requires `write_mtx_` to be held exclusively.
+  void SwitchMemTable(std::error_code& ec);
+
+  /// Replays the records of the WAL that are not in a table yet into the
+  /// memtable.
+  void Recover();
+
+  /// Flushes the immutable memtables in the background.
+  void StartFlushThread();
+
+  /// Writes `mem` to the table file `number`.
+  ///
+  /// \return The opened table, or null if `mem` is empty or on error.
+  std::shared_ptr<Table> WriteLevel0Table(const MemTable& mem,
+                                          uint64_t number,
+                                          std::error_code& ec);
+
+  /// Schedules compactions on the pool while the picker finds some and
+  /// threads are idle. Requires `db_mtx_`.
+  void MaybeScheduleCompaction();
+
+  /// Runs `compaction` on the pool and installs its outputs.
+  void BackgroundCompaction(Compaction* compaction);
+
+  /// \return Whether level 0 has too many files to take another flush.
+  ///         Requires `db_mtx_`.
+  bool IsLevel0Full() const;
+
+  /// Publishes a new `ReadView`. Requires `db_mtx_`.
+  void InstallReadView();
+
+  std::shared_ptr<const ReadView> GetReadView();
+
+  DBOptions options_;
+  kiwi::FilePath db_path_;
+  std::unique_ptr<WAL> wal_;
+  /// The last sequence number handed out to a writer.
+  std::atomic<SequenceNumber> last_sequence_{0};
+  std::error_code status_;
+
+  /// Writers hold `write_mtx_` shared while they log and insert a record,
+  /// and switching memtables holds it exclusively, so that every record
+  /// lands in the memtable matching the WAL segments it was written to.
+  std::shared_mutex write_mtx_;
+  /// Replaced while holding both `write_mtx_` and `db_mtx_`, so holding
+  /// either one is enough to read it.
+  std::shared_ptr<MemTable> mem_;
+  /// The memory held by `mem_` when it was empty.
+  std::size_t mem_base_usage_ = 0;
+
+  /// Guards the immutable memtables, the versions and the background work,
+  /// and is always acquired after `write_mtx_` if both are needed.
+  std::mutex db_mtx_;
+  /// Oldest first.
+  std::deque<ImmutableMemTable> imm_;
+  std::unique_ptr<VersionSet> versions_;
+  std::unique_ptr<CompactionPicker> compaction_picker_;
+  int num_running_compactions_ = 0;
+  DBStats stats_;
+  /// The error of the last failed flush or compaction, which stops the
+  /// background work and is reported by later switches.
+  std::error_code bg_error_;
+  bool stop_flush_thread_ = false;
+  /// Signaled when an immutable memtable is added or level 0 shrinks.
+  std::condition_variable flush_cv_;
+  /// Signaled when a flush or a compaction completes or fails.
+  std::condition_variable bg_done_cv_;
+  std::thread flush_thread_;
+
+  /// Cancels the running compactions once set.
+  std::atomic<bool> shutting_down_{false};
+  std::unique_ptr<ThreadPool> compaction_pool_;
+
+  std::mutex read_view_mtx_;
+  std::shared_ptr<const ReadView> read_view_;
+};
+
+}  // namespace rosekv
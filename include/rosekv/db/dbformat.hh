@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "rosekv/db/coding.hh"
+
+namespace rosekv {
+
+/// The sequence number ordering all updates of the database. Later updates
+/// of a key shadow earlier ones.
+using SequenceNumber = uint64_t;
+
+/// Sequence numbers share 8 bytes with the value type, leaving 56 bits.
+inline constexpr SequenceNumber kMaxSequenceNumber = (uint64_t{1} << 56) - 1;
+
+/// The kind of update an internal key records. The value is persisted in the
+/// WAL and in tables, so existing values must never change.
+enum class ValueType : uint8_t {
+  kDeletion = 0,
+  kValue = 1,
+};
+
+/// The outcome of looking a key up in a memtable or a table.
+enum class LookupResult {
+  kNotFound,  ///< The key has no entry visible at the sequence looked up.
+  kFound,     ///< The newest visible entry holds a value.
+  kDeleted,   ///< The newest visible entry is a deletion.
+};
+
+/// The type sorting first among the entries of a key with the same sequence
+/// number, used to build seek targets.
+inline constexpr ValueType kValueTypeForSeek = ValueType::kValue;
+
+/// An internal key is a user key followed by an 8-byte tag packing the
+/// sequence number and the value type:
+///
+/// ------------------------------------------------------------------------
+/// | User key | Sequence number (7 bytes) << 8 | Value type (1 byte)       |
+/// ------------------------------------------------------------------------
+///
+/// Internal keys order by user key ascending, then by sequence number
+/// descending, so the newest update of a key is met first.
+inline constexpr std::size_t kInternalKeyTagSize = 8;
+
+inline uint64_t PackSequenceAndType(SequenceNumber sequence, ValueType type) {
+  return sequence << 8 | static_cast<uint8_t>(type);
+}
+
+struct ParsedInternalKey {
+  std::string_view user_key;
+  SequenceNumber sequence = 0;
+  ValueType type = ValueType::kValue;
+};
+
+inline void AppendInternalKey(std::string* dst, std::string_view user_key,
+                              SequenceNumber sequence, ValueType type) {
+  dst->append(user_key);
+  PutFixed64(dst, PackSequenceAndType(sequence, type));
+}
+
+/// \return `false` if `internal_key` is too short or has an unknown type.
+inline bool ParseInternalKey(std::string_view internal_key,
+                             ParsedInternalKey* parsed) {
+  if (internal_key.size() < kInternalKeyTagSize) {
+    return false;
+  }
+
+  auto tag = DecodeFixed64(internal_key.data() + internal_key.size() -
+                           kInternalKeyTagSize);
+
+  if ((tag & 0xff) > static_cast<uint8_t>(ValueType::kValue)) {
+    return false;
+  }
+
+  parsed->user_key = internal_key.substr(0, internal_key.size() -
+                                                kInternalKeyTagSize);
+  parsed->sequence = tag >> 8;
+  parsed->type = static_cast<ValueType>(tag & 0xff);
+
+  return true;
+}
+
+inline std::string_view ExtractUserKey(std::string_view internal_key) {
+  return internal_key.substr(0, internal_key.size() - kInternalKeyTagSize);
+}
+
+inline uint64_t ExtractTag(std::string_view internal_key) {
+  return DecodeFixed64(internal_key.data() + internal_key.size() -
+                       kInternalKeyTagSize);
+}
+
+/// Orders internal keys by user key bytewise, then by tag descending.
+struct InternalKeyComparator {
+  int operator()(std::string_view a, std::string_view b) const {
+    if (int r = ExtractUserKey(a).compare(ExtractUserKey(b)); r != 0) {
+      return r;
+    }
+
+    auto a_tag = ExtractTag(a);
+    auto b_tag = ExtractTag(b);
+
+    return a_tag > b_tag ? -1 : a_tag < b_tag ? 1 : 0;
+  }
+};
+
+}  // namespace rosekv
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <system_error>
+
+namespace rosekv {
+
+/// Starts at 1, since an error code of 0 tests as success.
+enum class DBError {
+  kCorruption = 1,
+  kIOError,
+};
+
+class DBErrorCategory : public std::error_category {
+ public:
+  const char* name() const noexcept override { return "DBError"; }
+
+  std::string message(int ev) const override {
+    switch (static_cast<DBError>(ev)) {
+      case DBError::kCorruption:
+        return "Found malformed data in a database file.";
+
+      case DBError::kIOError:
+        return "An I/O error occurred while accessing a database file.";
+
+      default:
+        return "Unknown DB error";
+    }
+  }
+
+  static const DBErrorCategory& instance() {
+    static DBErrorCategory instance;
+
+    return instance;
+  }
+};
+
+inline std::error_code make_error_code(DBError e) {
+  return {static_cast<int>(e), DBErrorCategory::instance()};
+}
+
+inline std::error_condition make_error_condition(DBError e) {
+  return {static_cast<int>(e), DBErrorCategory::instance()};
+}
+
+}  // namespace rosekv
+
+namespace std {
+
+template <>
+struct is_error_code_enum<rosekv::DBError> : true_type {};
+
+}  // namespace std
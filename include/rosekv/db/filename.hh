@@ -0,0 +1,106 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <kiwi/io/file.hh>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace rosekv {
+
+inline constexpr std::string_view kTableFileExtension = ".sst";
+inline constexpr std::string_view kTempFileExtension = ".tmp";
+inline constexpr std::string_view kManifestFilePrefix = "MANIFEST-";
+/// The file naming the active MANIFEST.
+inline constexpr std::string_view kCurrentFileName = "CURRENT";
+
+namespace detail {
+
+inline std::string NumberedFileName(uint64_t number,
+                                    std::string_view extension) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%06llu",
+                static_cast<unsigned long long>(number));
+
+  return buf + std::string(extension);
+}
+
+inline std::optional<uint64_t> ParseNumber(std::string_view stem) {
+  uint64_t number = 0;
+  auto end = stem.data() + stem.size();
+  auto [ptr, ec] = std::from_chars(stem.data(), end, number);
+
+  if (ec != std::errc{} || ptr != end) {
+    return std::nullopt;
+  }
+
+  return number;
+}
+
+inline std::optional<uint64_t> ParseNumberedFileName(
+    std::string_view basename, std::string_view extension) {
+  if (basename.size() <= extension.size() || !basename.ends_with(extension)) {
+    return std::nullopt;
+  }
+
+  return ParseNumber(basename.substr(0, basename.size() - extension.size()));
+}
+
+}  // namespace detail
+
+/// \return The name of the table file with the given number, e.g.
+///         "000007.sst".
+inline std::string TableFileName(uint64_t number) {
+  return detail::NumberedFileName(number, kTableFileExtension);
+}
+
+/// \return The name a table file is written under before being renamed to
+///         its final name, so that a crash never leaves a partial table.
+inline std::string TempFileName(uint64_t number) {
+  return detail::NumberedFileName(number, kTempFileExtension);
+}
+
+/// \return The number of a table file, or `std::nullopt` if `basename` is
+///         not the name of one.
+inline std::optional<uint64_t> ParseTableFileName(std::string_view basename) {
+  return detail::ParseNumberedFileName(basename, kTableFileExtension);
+}
+
+/// \return The number of a temporary file, or `std::nullopt` if `basename`
+///         is not the name of one.
+inline std::optional<uint64_t> ParseTempFileName(std::string_view basename) {
+  return detail::ParseNumberedFileName(basename, kTempFileExtension);
+}
+
+/// Syncs the entries of `dir`, so that files created or renamed in it are
+/// still there after a crash.
+///
+/// \return `true` if the directory was synced, `false` otherwise.
+inline bool SyncDirectory(const kiwi::FilePath& dir) {
+  kiwi::File file{dir, kiwi::File::kFlagOpen | kiwi::File::kFlagRead};
+
+  return file.IsValid() && file.Flush();
+}
+
+/// \return The name of the MANIFEST with the given number, e.g.
+///         "MANIFEST-000003".
+inline std::string ManifestFileName(uint64_t number) {
+  return std::string(kManifestFilePrefix) +
+         detail::NumberedFileName(number, "");
+}
+
+/// \return The number of a MANIFEST, or `std::nullopt` if `basename` is not
+///         the name of one.
+inline std::optional<uint64_t> ParseManifestFileName(
+    std::string_view basename) {
+  if (basename.size() <= kManifestFilePrefix.size() ||
+      !basename.starts_with(kManifestFilePrefix)) {
+    return std::nullopt;
+  }
+
+  return detail::ParseNumber(basename.substr(kManifestFilePrefix.size()));
+}
+
+}  // namespace rosekv
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "rosekv/db/arena.hh"
+#include "rosekv/db/dbformat.hh"
+#include "rosekv/db/memtable_rep.hh"
+#include "rosekv/db/options.hh"
+
+namespace rosekv {
+
+/// An in-memory sorted buffer of the latest updates of the database.
+///
+/// Each update is stored as a single entry holding its internal key and its
+/// value:
+///
+/// ------------------------------------------------------------------------
+/// | Internal key length (varint) | Internal key | Value length (varint) |
+/// | Value |
+/// ------------------------------------------------------------------------
+///
+/// Entries are indexed by a concurrent skiplist or hash table, see
+/// `MemTableType`, so any number of writers may add entries while readers
+/// look keys up without taking any lock. Entries and index nodes are
+/// allocated from an arena, freed along with the memtable.
+class MemTable {
+ public:
+  /// \param options The options of the database, for the memtable type and
+  ///                its arena.
+  explicit MemTable(const DBOptions& options = {});
+
+  MemTable(const MemTable&) = delete;
+  MemTable& operator=(const MemTable&) = delete;
+
+  /// Adds an update of `key`. Thread-safe; `sequence` must be unique.
+  ///
+  /// \param sequence The sequence number of the update.
+  /// \param type Whether the update sets or deletes the key.
+  /// \param key The user key.
+  /// \param value The value, empty for deletions.
+  void Add(SequenceNumber sequence, ValueType type, std::string_view key,
+           std::string_view value);
+
+  /// Looks up the newest update of `key` with a sequence number of at most
+  /// `sequence`.
+  ///
+  /// \param value Receives the value if the result is `kFound`.
+  LookupResult Get(std::string_view key, SequenceNumber sequence,
+                   std::string* value) const;
+
+  /// \return The number of bytes of memory held by the memtable. Thread-safe.
+  std::size_t ApproximateMemoryUsage() const { return arena_.MemoryUsage(); }
+
+  /// Iterates over the entries in internal key order.
+  class Iterator {
+   public:
+    explicit Iterator(const MemTable* mem) : iter_{mem->rep_->NewIterator()} {}
+
+    bool Valid() const { return iter_->Valid(); }
+    void SeekToFirst() { iter_->SeekToFirst(); }
+    void SeekToLast() { iter_->SeekToLast(); }
+    void Next() { iter_->Next(); }
+    void Prev() { iter_->Prev(); }
+
+    /// Positions the iterator at the first entry at or after the internal
+    /// key `target`.
+    void Seek(std::string_view target);
+
+    std::string_view key() const;
+    std::string_view value() const;
+
+   private:
+    std::unique_ptr<MemTableRep::Iterator> iter_;
+    std::string seek_entry_;
+  };
+
+ private:
+  ConcurrentArena arena_;
+  std::unique_ptr<MemTableRep> rep_;
+};
+
+}  // namespace rosekv
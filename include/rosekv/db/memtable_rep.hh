@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+#include "rosekv/db/arena.hh"
+#include "rosekv/db/dbformat.hh"
+
+namespace rosekv {
+
+/// \return The length-prefixed string at `ptr`, e.g. the internal key of a
+///         memtable entry.
+inline std::string_view DecodeLengthPrefixed(const char* ptr) {
+  uint64_t len = 0;
+  // Entries are built by the memtable itself, so their varints are valid.
+  ptr = DecodeVarint64(ptr, ptr + 10, &len);
+  DCHECK(ptr != nullptr);
+
+  return {ptr, len};
+}
+
+/// Orders memtable entries by their internal keys.
+struct MemTableEntryComparator {
+  int operator()(const char* a, const char* b) const {
+    return InternalKeyComparator{}(DecodeLengthPrefixed(a),
+                                   DecodeLengthPrefixed(b));
+  }
+};
+
+/// The data structure indexing the entries of a memtable. Entries are
+/// allocated by the memtable and only referenced by the representation.
+class MemTableRep {
+ public:
+  virtual ~MemTableRep() = default;
+
+  /// Adds `entry`, whose internal key must be unique. Thread-safe.
+  virtual void Insert(const char* entry) = 0;
+
+  /// \return The newest entry of `user_key` with a sequence number of at
+  ///         most `sequence`, or null if there is none. Thread-safe.
+  virtual const char* Lookup(std::string_view user_key,
+                             SequenceNumber sequence) const = 0;
+
+  /// Iterates over the entries in internal key order.
+  class Iterator {
+   public:
+    virtual ~Iterator() = default;
+
+    virtual bool Valid() const = 0;
+    virtual const char* entry() const = 0;
+    virtual void Next() = 0;
+    virtual void Prev() = 0;
+    /// Positions the iterator at the first entry at or after `target`, an
+    /// entry or the length-prefixed internal key of one.
+    virtual void Seek(const char* target) = 0;
+    virtual void SeekToFirst() = 0;
+    virtual void SeekToLast() = 0;
+  };
+
+  virtual std::unique_ptr<Iterator> NewIterator() const = 0;
+};
+
+/// \return A representation keeping entries sorted in a concurrent skiplist,
+///         with O(log n) inserts and lookups and cheap ordered iteration.
+std::unique_ptr<MemTableRep> NewSkipListRep(ConcurrentArena* arena);
+
+/// \return A representation hashing entries by user key into `bucket_count`
+///         lock-free buckets, with O(1) inserts and lookups. Iterators sort
+///         a snapshot of the entries when first positioned, which is meant
+///         for flushes rather than scans.
+std::unique_ptr<MemTableRep> NewHashRep(ConcurrentArena* arena,
+                                        std::size_t bucket_count);
+
+}  // namespace rosekv
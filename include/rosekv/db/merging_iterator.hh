@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "rosekv/table/table.hh"
+
+namespace rosekv {
+
+/// Merges the entries of several tables into a single stream in internal key
+/// order, e.g. the inputs of a compaction.
+///
+/// The children are kept in a binary min-heap on their current key, so each
+/// step costs O(log n) comparisons for n children instead of a scan over all
+/// of them.
+class MergingIterator {
+ public:
+  explicit MergingIterator(
+      std::vector<std::unique_ptr<Table::Iterator>> children);
+
+  MergingIterator(const MergingIterator&) = delete;
+  MergingIterator& operator=(const MergingIterator&) = delete;
+
+  /// \return Whether the iterator points at an entry. A child that hit an
+  ///         error is dropped from the merge, see `Status()`.
+  bool Valid() const { return !heap_.empty(); }
+
+  void SeekToFirst();
+
+  /// Positions the iterator at the first entry at or after the internal key
+  /// `target`.
+  void Seek(std::string_view target);
+
+  void Next();
+
+  std::string_view key() const { return heap_.front()->key(); }
+  std::string_view value() const { return heap_.front()->value(); }
+
+  /// \return The first error a child ran into, if any.
+  std::error_code Status() const { return status_; }
+
+ private:
+  /// Rebuilds the heap out of the valid children.
+  void BuildHeap();
+
+  std::vector<std::unique_ptr<Table::Iterator>> children_;
+  /// The valid children; `heap_.front()` holds the smallest key.
+  std::vector<Table::Iterator*> heap_;
+  std::error_code status_;
+};
+
+}  // namespace rosekv
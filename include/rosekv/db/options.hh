@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "rosekv/table/options.hh"
+#include "rosekv/wal/options.hh"
+
+namespace rosekv {
+
+/// The data structure of the memtable.
+enum class MemTableType {
+  /// A concurrent skiplist, suited to any workload.
+  kSkipList,
+  /// A concurrent hash table, making point inserts and lookups O(1) for
+  /// tables that never scan. The entries are only sorted when flushed.
+  kHash,
+};
+
+/// How compactions shape the table files of a database.
+enum class CompactionStyle {
+  /// Keeps each level below level 0 a single sorted run, some multiple
+  /// larger than the previous level, so lookups read few files at the cost
+  /// of rewriting data once per level.
+  kLeveled,
+  /// Lets sorted runs accumulate and merges runs of similar sizes, which
+  /// rewrites data far less often at the cost of lookups searching more
+  /// runs. Suited to write-heavy tables that are rarely read.
+  kTiered,
+};
+
+struct DBOptions {
+  /// The directory holding the files of the database.
+  std::string db_dir;
+
+  /// The options of the database's WAL. An empty `wal_dir` places the
+  /// segments in the "wal" subdirectory of `db_dir`.
+  Options wal;
+
+  /// The size of the blocks the memtable's arena allocates entries from.
+  std::size_t arena_block_size = 4 * 1024 * 1024;
+
+  /// Whether to back the memtable's arena with explicit huge pages, which
+  /// must have been reserved, e.g. through /proc/sys/vm/nr_hugepages.
+  bool memtable_huge_pages = false;
+
+  MemTableType memtable_type = MemTableType::kSkipList;
+
+  /// The number of buckets of a `kHash` memtable. Lookups stay O(1) while
+  /// the number of distinct keys per memtable is within a small multiple of
+  /// it.
+  std::size_t hash_bucket_count = 1024 * 1024;
+
+  /// The memory a memtable may use before it becomes immutable and is
+  /// flushed to a table file, while a new memtable takes the writes.
+  std::size_t write_buffer_size = 64 * 1024 * 1024;
+
+  /// The number of immutable memtables that may wait for their flush. Once
+  /// reached, writes that fill up the active memtable block until a flush
+  /// completes.
+  int max_immutable_memtables = 2;
+
+  /// The options of the table files memtables are flushed to.
+  TableOptions table;
+
+  /// The number of levels of table files. Flushes write to level 0, whose
+  /// files may overlap; every other level is a sorted run of files.
+  int num_levels = 7;
+
+  /// The number of level 0 files that triggers their compaction into level
+  /// 1. Every level 0 file is searched by lookups, so this bounds their
+  /// read amplification.
+  int level0_file_num_compaction_trigger = 4;
+
+  /// The number of level 0 files at which flushes wait for compactions to
+  /// catch up, which eventually stalls writes.
+  int level0_stop_writes_trigger = 24;
+
+  /// The target size of level 1. Each next level targets
+  /// `max_bytes_for_level_multiplier` times the size of the previous one.
+  uint64_t max_bytes_for_level_base = 256 * 1024 * 1024;
+  double max_bytes_for_level_multiplier = 10;
+
+  /// The size compaction outputs are cut at.
+  uint64_t target_file_size = 64 * 1024 * 1024;
+
+  /// The number of threads running compactions concurrently.
+  int max_background_compactions = 4;
+
+  /// The number of key ranges a compaction may be split into, each merged by
+  /// its own thread of the compaction pool. A compaction is only split into
+  /// ranges of at least `target_file_size` bytes of input.
+  int max_subcompactions = 4;
+
+  /// The size at which the MANIFEST rolls over to a new one starting with a
+  /// snapshot of the database, which bounds the number of edits replayed
+  /// when the database is opened.
+  uint64_t max_manifest_file_size = 4 * 1024 * 1024;
+
+  CompactionStyle compaction_style = CompactionStyle::kLeveled;
+
+  /// With `kTiered`, `level0_file_num_compaction_trigger` is the number of
+  /// sorted runs that triggers a compaction. A run joins a merge if it is at
+  /// most `tiered_size_ratio` percent larger than the runs merged before it.
+  int tiered_size_ratio = 1;
+
+  /// The number of sorted runs a `kTiered` compaction merges, at least.
+  int tiered_min_merge_width = 2;
+
+  /// The number of sorted runs a `kTiered` compaction merges, at most.
+  int tiered_max_merge_width = 32;
+
+  /// Once the sorted runs but the oldest hold this percentage of the size of
+  /// the oldest one, a `kTiered` compaction merges all of them, which bounds
+  /// the space taken by overwritten and deleted data.
+  int tiered_max_size_amplification_percent = 200;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <random>
+
+#include "rosekv/db/arena.hh"
+
+namespace rosekv {
+
+/// A concurrent skiplist of unique keys.
+///
+/// Any number of threads may insert at the same time, and readers never
+/// block: an insert links its node into each level, bottom up, with a single
+/// compare-and-swap per level, retrying on the level it lost a race on. A
+/// node becomes visible to readers once it is linked into level 0, and is
+/// never removed: its memory belongs to the arena, which outlives the
+/// skiplist.
+///
+/// \tparam Key A trivially copyable key, e.g. a pointer to an encoded entry.
+/// \tparam Comparator A callable returning a negative value, 0 or a positive
+///                    value as its first key sorts before, equal to or after
+///                    its second one.
+template <typename Key, typename Comparator>
+class SkipList {
+  struct Node;
+
+ public:
+  static constexpr int kMaxHeight = 12;
+
+  /// \param cmp The order of the keys.
+  /// \param arena The arena allocating the nodes.
+  SkipList(Comparator cmp, ConcurrentArena* arena)
+      : cmp_{cmp}, arena_{arena}, head_{NewNode({}, kMaxHeight)} {
+    for (int level = 0; level < kMaxHeight; ++level) {
+      head_->SetNext(level, nullptr);
+    }
+  }
+
+  SkipList(const SkipList&) = delete;
+  SkipList& operator=(const SkipList&) = delete;
+
+  /// Inserts `key`, which must not be in the skiplist yet. Safe to call
+  /// concurrently with other inserts and with reads.
+  void Insert(const Key& key) {
+    auto height = RandomHeight();
+    auto max_height = max_height_.load(std::memory_order_relaxed);
+
+    while (height > max_height &&
+           !max_height_.compare_exchange_weak(max_height, height,
+                                              std::memory_order_relaxed)) {
+    }
+
+    // Find the nodes the new one goes between on every level, top down.
+    Node* prev[kMaxHeight];
+    Node* next[kMaxHeight];
+    auto before = head_;
+
+    for (int level = std::max(height, max_height) - 1; level >= 0; --level) {
+      FindSpliceForLevel(key, before, level, &prev[level], &next[level]);
+      before = prev[level];
+    }
+
+    auto node = NewNode(key, height);
+
+    for (int level = 0; level < height; ++level) {
+      while (true) {
+        node->NoBarrierSetNext(level, next[level]);
+
+        if (prev[level]->CasNext(level, next[level], node)) {
+          break;
+        }
+
+        // Another insert got in between, so the splice moved forward.
+        FindSpliceForLevel(key, prev[level], level, &prev[level],
+                           &next[level]);
+      }
+    }
+  }
+
+  /// \return Whether a key equal to `key` is in the skiplist.
+  bool Contains(const Key& key) const {
+    auto node = FindGreaterOrEqual(key);
+
+    return node != nullptr && cmp_(key, node->key) == 0;
+  }
+
+  /// Iterates over the keys of a skiplist. Keys inserted concurrently may or
+  /// may not be seen.
+  class Iterator {
+   public:
+    explicit Iterator(const SkipList* list) : list_{list} {}
+
+    bool Valid() const { return node_ != nullptr; }
+
+    const Key& key() const {
+      DCHECK(Valid());
+      return node_->key;
+    }
+
+    void Next() {
+      DCHECK(Valid());
+      node_ = node_->Next(0);
+    }
+
+    void Prev() {
+      DCHECK(Valid());
+      node_ = list_->FindLessThan(node_->key);
+
+      if (node_ == list_->head_) {
+        node_ = nullptr;
+      }
+    }
+
+    /// Positions the iterator at the first key at or after `target`.
+    void Seek(const Key& target) { node_ = list_->FindGreaterOrEqual(target); }
+
+    void SeekToFirst() { node_ = list_->head_->Next(0); }
+
+    void SeekToLast() {
+      node_ = list_->FindLast();
+
+      if (node_ == list_->head_) {
+        node_ = nullptr;
+      }
+    }
+
+   private:
+    const SkipList* list_;
+    Node* node_ = nullptr;
+  };
+
+ private:
+  static constexpr int kBranching = 4;
+
+  struct Node {
+    explicit Node(const Key& k) : key{k} {}
+
+    Node* Next(int level) const {
+      return next_[level].load(std::memory_order_acquire);
+    }
+
+    void SetNext(int level, Node* node) {
+      next_[level].store(node, std::memory_order_release);
+    }
+
+    void NoBarrierSetNext(int level, Node* node) {
+      next_[level].store(node, std::memory_order_relaxed);
+    }
+
+    bool CasNext(int level, Node* expected, Node* node) {
+      return next_[level].compare_exchange_strong(expected, node,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed);
+    }
+
+    const Key key;
+
+   private:
+    /// The links of the node, one per level. Nodes are allocated with room
+    /// for as many links as their height.
+    std::atomic<Node*> next_[1];
+  };
+
+  Node* NewNode(const Key& key, int height) {
+    auto mem = arena_->AllocateAligned(
+        sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
+
+    return new (mem) Node{key};
+  }
+
+  static int RandomHeight() {
+    thread_local std::minstd_rand rng{std::random_device{}()};
+    int height = 1;
+
+    while (height < kMaxHeight && rng() % kBranching == 0) {
+      ++height;
+    }
+
+    return height;
+  }
+
+  /// \return Whether `key` sorts after the key of `node`.
+  bool KeyIsAfterNode(const Key& key, const Node* node) const {
+    return node != nullptr && cmp_(node->key, key) < 0;
+  }
+
+  /// Walks `level` from `before` to the last node before `key`.
+  void FindSpliceForLevel(const Key& key, Node* before, int level,
+                          Node** prev, Node** next) const {
+    while (true) {
+      auto node = before->Next(level);
+
+      if (!KeyIsAfterNode(key, node)) {
+        *prev = before;
+        *next = node;
+        return;
+      }
+
+      before = node;
+    }
+  }
+
+  Node* FindGreaterOrEqual(const Key& key) const {
+    auto node = head_;
+    int level = max_height_.load(std::memory_order_relaxed) - 1;
+
+    while (true) {
+      auto next = node->Next(level);
+
+      if (KeyIsAfterNode(key, next)) {
+        node = next;
+      } else if (level == 0) {
+        return next;
+      } else {
+        --level;
+      }
+    }
+  }
+
+  /// \return The last node before `key`, or `head_` if there is none.
+  Node* FindLessThan(const Key& key) const {
+    auto node = head_;
+    int level = max_height_.load(std::memory_order_relaxed) - 1;
+
+    while (true) {
+      auto next = node->Next(level);
+
+      if (KeyIsAfterNode(key, next)) {
+        node = next;
+      } else if (level == 0) {
+        return node;
+      } else {
+        --level;
+      }
+    }
+  }
+
+  /// \return The last node, or `head_` if the skiplist is empty.
+  Node* FindLast() const {
+    auto node = head_;
+    int level = max_height_.load(std::memory_order_relaxed) - 1;
+
+    while (true) {
+      auto next = node->Next(level);
+
+      if (next != nullptr) {
+        node = next;
+      } else if (level == 0) {
+        return node;
+      } else {
+        --level;
+      }
+    }
+  }
+
+  const Comparator cmp_;
+  ConcurrentArena* const arena_;
+  Node* const head_;
+  std::atomic<int> max_height_{1};
+};
+
+}  // namespace rosekv
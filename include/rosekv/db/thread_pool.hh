@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rosekv {
+
+/// A fixed set of threads running tasks in the order they were scheduled,
+/// e.g. the compactions of a database.
+class ThreadPool {
+ public:
+  /// \param num_threads The number of threads, at least 1.
+  explicit ThreadPool(int num_threads);
+
+  /// Runs the tasks still queued, then joins the threads.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Queues `task` to run on one of the threads. Thread-safe.
+  void Schedule(std::function<void()> task);
+
+  int NumThreads() const { return static_cast<int>(threads_.size()); }
+
+ private:
+  void WorkerLoop();
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <kiwi/io/file_path.hh>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rosekv/db/dbformat.hh"
+#include "rosekv/db/options.hh"
+#include "rosekv/table/table.hh"
+#include "rosekv/wal/segment.hh"
+
+namespace rosekv {
+
+/// The segment type of the MANIFEST. Its format never changes, so block
+/// offsets and checksums are resolved at compile time.
+using ManifestSegment = BasicSegment<kDefaultBlockSize, Crc32cChecksum>;
+
+/// A table file of the database.
+struct FileMetaData {
+  uint64_t number = 0;
+  uint64_t file_size = 0;
+  /// The first and last internal keys of the file.
+  std::string smallest;
+  std::string largest;
+  /// The largest sequence number in the file.
+  SequenceNumber largest_sequence = 0;
+  std::shared_ptr<Table> table;
+  /// Whether a compaction is reading the file. Guarded by the mutex of the
+  /// database.
+  bool being_compacted = false;
+};
+
+/// \return The metadata of the opened table `table`.
+std::shared_ptr<FileMetaData> NewFileMetaData(uint64_t number,
+                                              std::shared_ptr<Table> table);
+
+/// A change to the table files of the database, applied atomically, along
+/// with the counters it moves forward. It is the record of the MANIFEST.
+struct VersionEdit {
+  void AddFile(int level, std::shared_ptr<FileMetaData> file) {
+    new_files.emplace_back(level, std::move(file));
+  }
+
+  void DeleteFile(int level, uint64_t number) {
+    deleted_files.emplace_back(level, number);
+  }
+
+  /// Appends the encoding of the edit to `dst`. Only the number of a new
+  /// file is recorded; the rest of its metadata is read from the table.
+  void EncodeTo(std::string* dst) const;
+
+  /// Decodes an edit encoded by `EncodeTo()`. The new files only have their
+  /// number set.
+  ///
+  /// \return `false` if `src` is malformed.
+  bool DecodeFrom(std::string_view src);
+
+  std::vector<std::pair<int, std::shared_ptr<FileMetaData>>> new_files;
+  std::vector<std::pair<int, uint64_t>> deleted_files;
+
+  std::optional<uint64_t> next_file_number;
+  std::optional<SequenceNumber> last_sequence;
+  /// The oldest WAL segment holding records missing from the tables. The
+  /// segments before it are obsolete.
+  std::optional<uint64_t> min_wal_segment_id;
+  /// The id the WAL gives its next segment as of the edit, which bounds the
+  /// ids the MANIFEST refers to even if the WAL directory loses its segments.
+  std::optional<uint64_t> next_wal_segment_id;
+};
+
+/// An immutable snapshot of the table files of each level.
+///
+/// Level 0 holds the tables written by flushes, which may overlap and are
+/// ordered newest first. Every other level is a single sorted run: its
+/// files do not overlap and are ordered by key, so a lookup reads at most
+/// one file per level.
+class Version {
+ public:
+  explicit Version(int num_levels) : files_(num_levels) {}
+
+  int NumLevels() const { return static_cast<int>(files_.size()); }
+
+  const std::vector<std::shared_ptr<FileMetaData>>& GetFiles(int level) const {
+    return files_[level];
+  }
+
+  /// \return The number of files across all levels.
+  std::size_t NumFiles() const;
+
+  /// \return The total size of the files of `level`.
+  uint64_t NumLevelBytes(int level) const;
+
+  /// Looks up the newest entry of `user_key` with a sequence number of at
+  /// most `sequence`, from level 0 down.
+  ///
+  /// \param value Receives the value if the result is `kFound`.
+  /// \param ec Set if a table could not be read.
+  LookupResult Get(std::string_view user_key, SequenceNumber sequence,
+                   std::string* value, std::error_code& ec) const;
+
+  /// \return The files of `level` holding user keys in the range
+  ///         [`smallest_user_key`, `largest_user_key`].
+  std::vector<std::shared_ptr<FileMetaData>> GetOverlappingFiles(
+      int level, std::string_view smallest_user_key,
+      std::string_view largest_user_key) const;
+
+ private:
+  friend class VersionSet;
+
+  std::vector<std::vector<std::shared_ptr<FileMetaData>>> files_;
+};
+
+/// Tracks the current `Version` of the database and persists its layout.
+///
+/// Every edit is appended to the MANIFEST, a log of `VersionEdit` records
+/// in the chunk format of WAL segments, and installed once synced, so that
+/// a crash leaves either all of an edit or none of it. A table missing from
+/// the MANIFEST, e.g. the output of a compaction interrupted by a crash, is
+/// deleted on recovery.
+///
+/// Once it reaches `max_manifest_file_size`, and whenever the database is
+/// opened, the MANIFEST rolls over to a new one starting with a snapshot of
+/// the current version, and the "CURRENT" file is renamed over to name it.
+/// `VersionSet` is not thread-safe.
+class VersionSet {
+ public:
+  VersionSet(const DBOptions& options, const kiwi::FilePath& db_path);
+
+  VersionSet(const VersionSet&) = delete;
+  VersionSet& operator=(const VersionSet&) = delete;
+
+  /// Replays the MANIFEST, opens the tables of the database and places them
+  /// in their levels, then starts a new MANIFEST. Without a MANIFEST, every
+  /// table found goes to level 0.
+  ///
+  /// \param ec Set if a table or the MANIFEST cannot be read, or the new
+  ///           MANIFEST cannot be written.
+  void Recover(std::error_code& ec);
+
+  std::shared_ptr<const Version> Current() const { return current_; }
+
+  /// \return A number for a new table file.
+  uint64_t NewFileNumber() { return next_file_number_++; }
+
+  /// \return The largest sequence number persisted in the tables, even if
+  ///         compactions have since dropped the record that carried it.
+  SequenceNumber LastSequence() const { return last_sequence_; }
+
+  /// \return The oldest WAL segment holding records missing from the
+  ///         tables, or 0 if unknown.
+  uint64_t MinWALSegmentId() const { return min_wal_segment_id_; }
+
+  /// \return The id of the next WAL segment, as last recorded, or 0 if
+  ///         unknown.
+  uint64_t NextWALSegmentId() const { return next_wal_segment_id_; }
+
+  /// \return The number of the active MANIFEST.
+  uint64_t ManifestNumber() const { return manifest_number_; }
+
+  /// Applies `edit` to the current version and persists the result. On
+  /// error, the current version is left unchanged.
+  void LogAndApply(const VersionEdit& edit, std::error_code& ec);
+
+ private:
+  /// Sorts the files of each level into lookup order.
+  static void SortFiles(Version* version);
+
+  /// Replays the MANIFEST named by the CURRENT file.
+  ///
+  /// \param levels Receives the level of each live table.
+  void ReplayManifest(std::unordered_map<uint64_t, int>* levels,
+                      std::error_code& ec);
+
+  /// Records the counters in `edit`, as they are once it is applied.
+  void AddCounters(VersionEdit* edit) const;
+
+  /// Moves the counters forward to the values recorded in `edit`.
+  void ApplyCounters(const VersionEdit& edit);
+
+  /// Starts a new MANIFEST holding a snapshot of `version` and of the
+  /// counters recorded in `counters`, then points the CURRENT file at it and
+  /// deletes the previous one.
+  void WriteSnapshot(const Version& version, const VersionEdit& counters,
+                     std::error_code& ec);
+
+  /// Appends `record` to the MANIFEST and syncs it.
+  void AppendToManifest(std::string_view record, std::error_code& ec);
+
+  /// Renames a file naming MANIFEST `number` over the CURRENT file.
+  void SetCurrentFile(uint64_t number, std::error_code& ec);
+
+  DBOptions options_;
+  kiwi::FilePath db_path_;
+  std::shared_ptr<const Version> current_;
+  uint64_t next_file_number_ = 1;
+  SequenceNumber last_sequence_ = 0;
+  uint64_t min_wal_segment_id_ = 0;
+  uint64_t next_wal_segment_id_ = 0;
+
+  uint64_t manifest_number_ = 0;
+  std::unique_ptr<ManifestSegment> manifest_;
+};
+
+}  // namespace rosekv
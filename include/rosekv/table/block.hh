@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace rosekv {
+
+/// Orders the keys of a block.
+using KeyComparator = int (*)(std::string_view a, std::string_view b);
+
+/// Compares internal keys, for data and index blocks.
+int CompareInternalKeys(std::string_view a, std::string_view b);
+
+/// Compares keys bytewise, for the properties block.
+int CompareBytewise(std::string_view a, std::string_view b);
+
+/// A read-only view of a block of prefix-compressed entries, see format.hh.
+class Block {
+ public:
+  /// Constructs an empty block.
+  Block() = default;
+
+  /// Wraps `contents` without copying them, e.g. a block of a memory-mapped
+  /// table. The contents must outlive the block.
+  explicit Block(std::string_view contents);
+
+  /// Takes ownership of a block read into `buf`.
+  Block(std::unique_ptr<char[]> buf, std::size_t size);
+
+  Block(Block&&) = default;
+  Block& operator=(Block&&) = default;
+
+  /// \return `false` if the restart array of the block is malformed.
+  bool IsValid() const { return num_restarts_ > 0; }
+
+  std::size_t size() const { return contents_.size(); }
+
+  /// Iterates over the entries of a block.
+  class Iterator {
+   public:
+    Iterator(const Block* block, KeyComparator cmp);
+
+    /// \return Whether the iterator points at an entry. An iterator that ran
+    ///         into malformed entries is invalid, see `IsCorrupted()`.
+    bool Valid() const { return current_ < restarts_offset_; }
+
+    /// \return Whether the iterator stopped at a malformed entry.
+    bool IsCorrupted() const { return corrupted_; }
+
+    void SeekToFirst() {
+      SeekToRestartPoint(0);
+      ParseNextEntry();
+    }
+
+    /// Positions the iterator at the first entry whose key is at or after
+    /// `target`: binary searches the restart points, then scans at most one
+    /// restart interval.
+    void Seek(std::string_view target);
+
+    void Next() { ParseNextEntry(); }
+
+    std::string_view key() const { return key_; }
+    std::string_view value() const { return value_; }
+
+   private:
+    uint32_t GetRestartPoint(uint32_t index) const;
+
+    void SeekToRestartPoint(uint32_t index);
+
+    /// Decodes the entry at `next_`.
+    ///
+    /// \return `false` at the end of the block or on a malformed entry.
+    bool ParseNextEntry();
+
+    void MarkCorrupted();
+
+    const char* data_;
+    KeyComparator cmp_;
+    uint32_t restarts_offset_;
+    uint32_t num_restarts_;
+    /// The offset of the current entry, `restarts_offset_` if none.
+    uint32_t current_;
+    /// The offset of the entry following the current one.
+    uint32_t next_;
+    std::string key_;
+    std::string_view value_;
+    bool corrupted_ = false;
+  };
+
+  Iterator NewIterator(KeyComparator cmp) const { return {this, cmp}; }
+
+ private:
+  void ParseRestarts();
+
+  std::unique_ptr<char[]> owned_;
+  std::string_view contents_;
+  uint32_t restarts_offset_ = 0;
+  uint32_t num_restarts_ = 0;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rosekv {
+
+/// Builds a block of prefix-compressed entries, see format.hh.
+class BlockBuilder {
+ public:
+  /// \param restart_interval The number of entries between restart points.
+  explicit BlockBuilder(int restart_interval);
+
+  /// Clears the builder to start a new block.
+  void Reset();
+
+  /// Appends an entry. Keys must be added in increasing order.
+  void Add(std::string_view key, std::string_view value);
+
+  /// Appends the restart points.
+  ///
+  /// \return The contents of the block, valid until the builder is reset.
+  std::string_view Finish();
+
+  /// \return The size the block would have if finished now.
+  std::size_t CurrentSizeEstimate() const {
+    return buffer_.size() + (restarts_.size() + 1) * sizeof(uint32_t);
+  }
+
+  bool empty() const { return buffer_.empty(); }
+
+ private:
+  const int restart_interval_;
+  std::string buffer_;
+  std::vector<uint32_t> restarts_;
+  /// The number of entries added since the last restart point.
+  int counter_ = 0;
+  bool finished_ = false;
+  std::string last_key_;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "rosekv/db/coding.hh"
+#include "rosekv/wal/checksum.hh"
+
+namespace rosekv {
+
+/// The on-disk layout of a sorted string table (SST):
+///
+/// ------------------------------------------------------------------------
+/// | Data block 1 | ... | Data block N | Index block | Properties block |
+/// | Footer (48 bytes) |
+/// ------------------------------------------------------------------------
+///
+/// Every block is followed by a 4-byte trailer holding the checksum of its
+/// contents, computed with the checksum recorded in the footer, like the
+/// chunks of a WAL segment.
+///
+/// A block holds sorted key-value entries. Each key is stored as the number
+/// of bytes it shares with the previous key and the rest of it, except at
+/// restart points, every few entries, where the full key is stored so that
+/// readers can binary search the restart points:
+///
+/// ------------------------------------------------------------------------
+/// | Shared (varint) | Non-shared (varint) | Value length (varint) |
+/// | Key delta | Value |
+/// ------------------------------------------------------------------------
+/// | ... more entries ... | Restart offsets (4 bytes each) |
+/// | Number of restarts (4 bytes) |
+/// ------------------------------------------------------------------------
+///
+/// The index block maps the last key of each data block to its handle. The
+/// properties block maps property names to their values.
+
+/// The position of a block within a table.
+struct BlockHandle {
+  /// The largest encoded size of a handle.
+  static constexpr std::size_t kMaxEncodedLength = 20;
+
+  uint64_t offset = 0;
+  /// The size of the block, not counting its trailer.
+  uint64_t size = 0;
+
+  void EncodeTo(std::string* dst) const {
+    PutVarint64(dst, offset);
+    PutVarint64(dst, size);
+  }
+
+  /// Consumes a handle from the front of `input`.
+  bool DecodeFrom(std::string_view* input) {
+    return GetVarint64(input, &offset) && GetVarint64(input, &size);
+  }
+};
+
+/// The size of the checksum following every block.
+inline constexpr std::size_t kBlockTrailerSize = 4;
+
+inline constexpr uint64_t kTableMagic = 0x5453564b45534f52;  // "ROSEKVST"
+inline constexpr uint8_t kTableFormatV1 = 1;
+
+/// The fixed-size tail of a table, read first to locate everything else:
+///
+/// ------------------------------------------------------------------------
+/// | Index offset (8 bytes) | Index size (8 bytes) |
+/// | Properties offset (8 bytes) | Properties size (8 bytes) |
+/// | Checksum type (1 byte) | Version (1 byte) | Reserved (2 bytes) |
+/// | CRC32 of the previous 36 bytes (4 bytes) | Magic (8 bytes) |
+/// ------------------------------------------------------------------------
+struct Footer {
+  static constexpr std::size_t kEncodedLength = 48;
+
+  BlockHandle index;
+  BlockHandle properties;
+  ChecksumType checksum = ChecksumType::kCrc32;
+  uint8_t version = kTableFormatV1;
+
+  void EncodeTo(std::string* dst) const;
+
+  /// \return `false` if `input` is not a valid footer.
+  bool DecodeFrom(std::string_view input);
+};
+
+/// The names of the properties stored in the properties block. Integer
+/// properties are stored as varints.
+inline constexpr std::string_view kPropDataSize = "rosekv.data.size";
+inline constexpr std::string_view kPropIndexSize = "rosekv.index.size";
+inline constexpr std::string_view kPropLargestKey = "rosekv.largest.key";
+inline constexpr std::string_view kPropMaxSequence = "rosekv.max.sequence";
+inline constexpr std::string_view kPropNumDataBlocks =
+    "rosekv.num.data.blocks";
+inline constexpr std::string_view kPropNumEntries = "rosekv.num.entries";
+inline constexpr std::string_view kPropRawKeySize = "rosekv.raw.key.size";
+inline constexpr std::string_view kPropRawValueSize = "rosekv.raw.value.size";
+inline constexpr std::string_view kPropSmallestKey = "rosekv.smallest.key";
+
+/// Statistics about a table, stored in its properties block.
+struct TableProperties {
+  uint64_t num_entries = 0;
+  uint64_t num_data_blocks = 0;
+  uint64_t raw_key_size = 0;
+  uint64_t raw_value_size = 0;
+  /// The size of the data blocks, trailers included.
+  uint64_t data_size = 0;
+  uint64_t index_size = 0;
+  /// The first and last internal keys of the table.
+  std::string smallest_key;
+  std::string largest_key;
+  /// The largest sequence number of the entries.
+  uint64_t max_sequence = 0;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "rosekv/wal/checksum.hh"
+
+namespace rosekv {
+
+/// How a table reader accesses the table file.
+enum class TableReadMode {
+  /// Reads each block with `pread()` into a buffer of its own.
+  kPread,
+  /// Maps the whole file, so blocks are read in place without any copy or
+  /// system call. Best for small, frequently read tables.
+  kMmap,
+};
+
+struct TableOptions {
+  /// The size data blocks are cut at, in bytes. Like the blocks of a WAL
+  /// segment, it is the unit tables are read and checksummed in, so smaller
+  /// blocks speed up point lookups and larger ones scans.
+  int64_t block_size = 4 * 1024;
+
+  /// The number of entries between restart points in a block. Lookups
+  /// binary search the restart points, then scan at most this many entries.
+  int block_restart_interval = 16;
+
+  /// The checksum protecting the blocks of new tables. Each table records
+  /// the checksum it was written with.
+  ChecksumType checksum = ChecksumType::kCrc32c;
+
+  /// How tables are read.
+  TableReadMode read_mode = TableReadMode::kPread;
+
+  /// Whether to verify the checksum of every data block read. The index and
+  /// properties blocks are always verified when a table is opened.
+  bool verify_checksums = true;
+};
+
+}  // namespace rosekv
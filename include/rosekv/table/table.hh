@@ -0,0 +1,119 @@
+#pragma once
+
+#include <kiwi/io/file.hh>
+#include <kiwi/io/file_path.hh>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "rosekv/db/dbformat.hh"
+#include "rosekv/table/block.hh"
+#include "rosekv/table/format.hh"
+#include "rosekv/table/options.hh"
+
+namespace rosekv {
+
+/// Reads a sorted string table written by `TableBuilder`.
+///
+/// Opening a table reads and verifies its footer, index block and properties
+/// block, and keeps the index in memory, so a point lookup binary searches
+/// the index, reads a single data block and binary searches its restart
+/// points. In `kMmap` mode the whole file is mapped and blocks are read in
+/// place. A `Table` is immutable and safe to read from concurrently.
+class Table {
+ public:
+  /// Opens the table at `path`.
+  ///
+  /// \param options The options reading the table. The checksum and block
+  ///                size are taken from the table itself.
+  Table(const kiwi::FilePath& path, const TableOptions& options);
+
+  ~Table();
+
+  Table(const Table&) = delete;
+  Table& operator=(const Table&) = delete;
+
+  /// Looks up the newest entry of `user_key` with a sequence number of at
+  /// most `sequence`.
+  ///
+  /// \param value Receives the value if the result is `kFound`.
+  /// \param ec Set if a block could not be read or is corrupted.
+  LookupResult Get(std::string_view user_key, SequenceNumber sequence,
+                   std::string* value, std::error_code& ec) const;
+
+  /// Iterates over the entries of a table in internal key order, reading one
+  /// data block at a time.
+  class Iterator {
+   public:
+    explicit Iterator(const Table* table);
+
+    /// \return Whether the iterator points at an entry. An iterator that hit
+    ///         an error is invalid, see `Status()`.
+    bool Valid() const { return data_iter_ != nullptr && data_iter_->Valid(); }
+
+    void SeekToFirst();
+    void Seek(std::string_view target);
+    void Next();
+
+    std::string_view key() const { return data_iter_->key(); }
+    std::string_view value() const { return data_iter_->value(); }
+
+    std::error_code Status() const { return status_; }
+
+   private:
+    /// Loads the data block the index iterator points at, if any.
+    void InitDataBlock();
+
+    /// Moves to the next data block while the current one is exhausted.
+    void SkipEmptyDataBlocks();
+
+    const Table* table_;
+    Block::Iterator index_iter_;
+    Block data_block_;
+    std::unique_ptr<Block::Iterator> data_iter_;
+    std::error_code status_;
+  };
+
+  std::unique_ptr<Iterator> NewIterator() const {
+    return std::make_unique<Iterator>(this);
+  }
+
+  const TableProperties& GetProperties() const { return props_; }
+
+  /// \return The size of the table file.
+  uint64_t FileSize() const { return file_size_; }
+
+  /// \return The approximate offset in the file of the data for the
+  ///         internal key `key`: the offset of the data block that would
+  ///         hold it, or the end of the data blocks if it is after the last
+  ///         key. Only reads the in-memory index.
+  uint64_t ApproximateOffsetOf(std::string_view key) const;
+
+  /// \return The error encountered while opening the table, if any.
+  std::error_code Status() const { return status_; }
+
+ private:
+  /// Reads the block at `handle` and verifies its checksum if `verify`.
+  Block ReadBlock(const BlockHandle& handle, bool verify,
+                  std::error_code& ec) const;
+
+  /// Reads `n` bytes at `offset`, from the mapping in `kMmap` mode.
+  ///
+  /// \param scratch The buffer to read into in `kPread` mode.
+  /// \return The bytes read, or an empty view on error.
+  std::string_view Read(uint64_t offset, std::size_t n, char* scratch) const;
+
+  bool DecodeProperties(const Block& block);
+
+  TableOptions options_;
+  mutable kiwi::File file_;
+  uint64_t file_size_ = 0;
+  const char* mapped_ = nullptr;
+  Footer footer_;
+  Block index_block_;
+  TableProperties props_;
+  std::error_code status_;
+};
+
+}  // namespace rosekv
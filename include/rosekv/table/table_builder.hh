@@ -0,0 +1,68 @@
+#pragma once
+
+#include <kiwi/io/file.hh>
+#include <kiwi/io/file_path.hh>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "rosekv/table/block_builder.hh"
+#include "rosekv/table/format.hh"
+#include "rosekv/table/options.hh"
+
+namespace rosekv {
+
+/// Writes a sorted string table, see format.hh.
+///
+/// Entries are appended in internal key order and data blocks are written
+/// out as soon as they reach the block size, so building a table only holds
+/// a block and the index in memory. Write errors are sticky: once one
+/// occurs, later calls do nothing and `Finish()` reports it.
+class TableBuilder {
+ public:
+  /// Creates the table file at `path`, replacing any existing file.
+  TableBuilder(const TableOptions& options, const kiwi::FilePath& path);
+
+  TableBuilder(const TableBuilder&) = delete;
+  TableBuilder& operator=(const TableBuilder&) = delete;
+
+  /// Appends an entry. Keys must be internal keys added in increasing order.
+  void Add(std::string_view key, std::string_view value);
+
+  /// Writes the last data block, the index block, the properties block and
+  /// the footer, and syncs the file.
+  ///
+  /// \param ec Set if any write failed.
+  void Finish(std::error_code& ec);
+
+  /// \return The number of entries added so far.
+  uint64_t NumEntries() const { return props_.num_entries; }
+
+  /// \return The size of the file so far, or its final size once finished.
+  uint64_t FileSize() const { return offset_; }
+
+  const TableProperties& GetProperties() const { return props_; }
+
+ private:
+  /// Writes the current data block and records it in the index.
+  void FlushDataBlock();
+
+  /// Writes `contents` followed by its checksum trailer.
+  ///
+  /// \return The handle of the written block.
+  BlockHandle WriteBlock(std::string_view contents);
+
+  std::string EncodeProperties() const;
+
+  TableOptions options_;
+  kiwi::File file_;
+  std::error_code status_;
+  uint64_t offset_ = 0;
+  BlockBuilder data_block_;
+  BlockBuilder index_block_;
+  std::string last_key_;
+  TableProperties props_;
+  bool finished_ = false;
+};
+
+}  // namespace rosekv
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <kiwi/containers/span.hh>
+#include <kiwi/metrics/crc32.hh>
+#include <variant>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace rosekv {
+
+/// The checksum algorithms chunks can be protected with. The value is stored
+/// in the header of v2 segments, so existing values must never change.
+enum class ChecksumType : uint8_t {
+  kCrc32 = 0,   ///< CRC32 (IEEE 802.3), the checksum of v1 segments.
+  kCrc32c = 1,  ///< CRC32C (Castagnoli), hardware accelerated on SSE4.2.
+  kXXH64 = 2,   ///< The low 32 bits of XXH64, fast on large payloads.
+};
+
+inline constexpr ChecksumType kMaxChecksumType = ChecksumType::kXXH64;
+
+/// Checksum policies for segment chunks.
+///
+/// A policy is a default constructible type accumulating the bytes passed to
+/// `Update()`, so that a chunk split over several buffers is checksummed
+/// piece by piece, and returning the 32-bit checksum stored in the chunk
+/// header from `Digest()`. Its `kType` is recorded in the segment header.
+
+/// The CRC32 (IEEE 802.3) checksum chunks have always been written with.
+class Crc32Checksum {
+ public:
+  static constexpr ChecksumType kType = ChecksumType::kCrc32;
+
+  void Update(kiwi::span<const uint8_t> data) {
+    crc_ = kiwi::Crc32(crc_, data);
+  }
+
+  uint32_t Digest() const { return crc_; }
+
+ private:
+  uint32_t crc_ = 0;
+};
+
+namespace detail {
+
+constexpr std::array<uint32_t, 256> MakeCrc32cTable() {
+  constexpr uint32_t kPolynomial = 0x82f63b78;
+  std::array<uint32_t, 256> table{};
+
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+
+    for (int k = 0; k < 8; ++k) {
+      crc = (crc >> 1) ^ (kPolynomial & (0u - (crc & 1)));
+    }
+
+    table[i] = crc;
+  }
+
+  return table;
+}
+
+inline constexpr std::array<uint32_t, 256> kCrc32cTable = MakeCrc32cTable();
+
+/// Extends the CRC32C `crc`, before its final inversion, over `[ptr, end)`
+/// with the lookup table.
+inline uint32_t Crc32cSoftware(uint32_t crc, const uint8_t* ptr,
+                               const uint8_t* end) {
+  for (; ptr != end; ++ptr) {
+    crc = kCrc32cTable[(crc ^ *ptr) & 0xff] ^ (crc >> 8);
+  }
+
+  return crc;
+}
+
+#if defined(__x86_64__)
+/// Same as `Crc32cSoftware()`, with the SSE4.2 `crc32` instruction. Only
+/// called when `HasSse42()`, so the rest of the build needs no `-msse4.2`.
+__attribute__((target("sse4.2"))) inline uint32_t Crc32cSse42(
+    uint32_t crc, const uint8_t* ptr, const uint8_t* end) {
+  uint64_t crc64 = crc;
+
+  for (; end - ptr >= 8; ptr += 8) {
+    uint64_t word;
+    std::memcpy(&word, ptr, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+
+  crc = static_cast<uint32_t>(crc64);
+
+  for (; ptr != end; ++ptr) {
+    crc = _mm_crc32_u8(crc, *ptr);
+  }
+
+  return crc;
+}
+
+/// \return Whether the CPU running the process supports SSE4.2.
+inline bool HasSse42() {
+  static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+
+  return has_sse42;
+}
+#endif
+
+}  // namespace detail
+
+/// The CRC32C (Castagnoli) checksum, computed with the SSE4.2 `crc32`
+/// instruction when the CPU supports it and with a lookup table otherwise.
+class Crc32cChecksum {
+ public:
+  static constexpr ChecksumType kType = ChecksumType::kCrc32c;
+
+  void Update(kiwi::span<const uint8_t> data) {
+    auto ptr = data.data();
+    auto end = ptr + data.size();
+
+#if defined(__x86_64__)
+    if (detail::HasSse42()) {
+      crc_ = ~detail::Crc32cSse42(~crc_, ptr, end);
+
+      return;
+    }
+#endif
+
+    crc_ = ~detail::Crc32cSoftware(~crc_, ptr, end);
+  }
+
+  uint32_t Digest() const { return crc_; }
+
+ private:
+  uint32_t crc_ = 0;
+};
+
+/// The XXH64 hash with seed 0, truncated to its low 32 bits. Runs several
+/// times faster than a table-driven CRC on large payloads.
+class XXH64Checksum {
+ public:
+  static constexpr ChecksumType kType = ChecksumType::kXXH64;
+
+  void Update(kiwi::span<const uint8_t> data) {
+    auto ptr = data.data();
+    auto end = ptr + data.size();
+
+    total_len_ += data.size();
+
+    // Top up a stripe left over from the previous update first.
+    if (buffered_ != 0) {
+      auto n = std::min<std::size_t>(kStripeSize - buffered_, end - ptr);
+
+      std::memcpy(buffer_ + buffered_, ptr, n);
+      buffered_ += n;
+      ptr += n;
+
+      if (buffered_ < kStripeSize) {
+        return;
+      }
+
+      ConsumeStripe(buffer_);
+      buffered_ = 0;
+    }
+
+    for (; end - ptr >= kStripeSize; ptr += kStripeSize) {
+      ConsumeStripe(ptr);
+    }
+
+    std::memcpy(buffer_, ptr, end - ptr);
+    buffered_ = end - ptr;
+  }
+
+  uint32_t Digest() const {
+    uint64_t hash;
+
+    if (total_len_ >= kStripeSize) {
+      hash = std::rotl(acc_[0], 1) + std::rotl(acc_[1], 7) +
+             std::rotl(acc_[2], 12) + std::rotl(acc_[3], 18);
+
+      for (auto acc : acc_) {
+        hash = (hash ^ Round(0, acc)) * kPrime1 + kPrime4;
+      }
+    } else {
+      hash = kPrime5;
+    }
+
+    hash += total_len_;
+
+    auto ptr = buffer_;
+    auto end = buffer_ + buffered_;
+
+    for (; end - ptr >= 8; ptr += 8) {
+      hash ^= Round(0, Read64(ptr));
+      hash = std::rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+
+    if (end - ptr >= 4) {
+      hash ^= Read32(ptr) * kPrime1;
+      hash = std::rotl(hash, 23) * kPrime2 + kPrime3;
+      ptr += 4;
+    }
+
+    for (; ptr != end; ++ptr) {
+      hash ^= *ptr * kPrime5;
+      hash = std::rotl(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+
+    return static_cast<uint32_t>(hash);
+  }
+
+ private:
+  static constexpr uint64_t kPrime1 = 0x9e3779b185ebca87;
+  static constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4f;
+  static constexpr uint64_t kPrime3 = 0x165667b19e3779f9;
+  static constexpr uint64_t kPrime4 = 0x85ebca77c2b2ae63;
+  static constexpr uint64_t kPrime5 = 0x27d4eb2f165667c5;
+  static constexpr int64_t kStripeSize = 32;
+
+  static uint64_t Read64(const uint8_t* ptr) {
+    uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+
+    return value;
+  }
+
+  static uint64_t Read32(const uint8_t* ptr) {
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+
+    return value;
+  }
+
+  static uint64_t Round(uint64_t acc, uint64_t input) {
+    return std::rotl(acc + input * kPrime2, 31) * kPrime1;
+  }
+
+  void ConsumeStripe(const uint8_t* ptr) {
+    for (int i = 0; i < 4; ++i) {
+      acc_[i] = Round(acc_[i], Read64(ptr + 8 * i));
+    }
+  }
+
+  uint64_t acc_[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+  uint64_t total_len_ = 0;
+  uint8_t buffer_[kStripeSize];
+  std::size_t buffered_ = 0;
+};
+
+/// A policy dispatching at runtime to the checksum recorded in each segment's
+/// header, for segments written with different checksums to be read alike.
+class DynamicChecksum {
+ public:
+  explicit DynamicChecksum(ChecksumType type = ChecksumType::kCrc32) {
+    switch (type) {
+      case ChecksumType::kCrc32:
+        break;
+      case ChecksumType::kCrc32c:
+        state_.emplace<Crc32cChecksum>();
+        break;
+      case ChecksumType::kXXH64:
+        state_.emplace<XXH64Checksum>();
+        break;
+    }
+  }
+
+  void Update(kiwi::span<const uint8_t> data) {
+    std::visit([&](auto& state) { state.Update(data); }, state_);
+  }
+
+  uint32_t Digest() const {
+    return std::visit([](const auto& state) { return state.Digest(); },
+                      state_);
+  }
+
+ private:
+  std::variant<Crc32Checksum, Crc32cChecksum, XXH64Checksum> state_;
+};
+
+}  // namespace rosekv
@@ -6,6 +6,12 @@ namespace rosekv {
 
 enum class WALError {
   kTooLargeData,
+  kSegmentNotFound,
+  kInvalidOffset,
+  kIOError,
+  kNonContiguousSegments,
+  kReplicationProtocol,
+  kCorruptedRecord,
 };
 
 class WALErrorCategory : public std::error_category {
@@ -17,6 +23,24 @@ class WALErrorCategory : public std::error_category {
       case WALError::kTooLargeData:
         return "Data size exceeds the segment's maximum allowed capacity.";
 
+      case WALError::kSegmentNotFound:
+        return "The requested segment does not exist.";
+
+      case WALError::kInvalidOffset:
+        return "The requested offset lies outside the segment.";
+
+      case WALError::kIOError:
+        return "An I/O error occurred while accessing a segment file.";
+
+      case WALError::kNonContiguousSegments:
+        return "The segment ids found on disk are not contiguous.";
+
+      case WALError::kReplicationProtocol:
+        return "Received malformed or out of order replication data.";
+
+      case WALError::kCorruptedRecord:
+        return "A record is torn or does not match its checksum.";
+
       default:
         return "Unknown WAL error";
     }
@@ -29,11 +53,11 @@ class WALErrorCategory : public std::error_category {
   }
 };
 
-std::error_code make_error_code(WALError e) {
+inline std::error_code make_error_code(WALError e) {
   return {static_cast<int>(e), WALErrorCategory::instance()};
 }
 
-std::error_condition make_error_condition(WALError e) {
+inline std::error_condition make_error_condition(WALError e) {
   return {static_cast<int>(e), WALErrorCategory::instance()};
 }
 
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+namespace rosekv {
+
+using SegmentId = uint64_t;
+
+/// A log sequence number identifying a record in the WAL.
+///
+/// An LSN packs the id of the segment holding the record and the offset of
+/// the record's first chunk within that segment into a single 64-bit value:
+///
+/// ------------------------------------------------
+/// | Segment id (32 bits) | Segment offset (32 bits) |
+/// ------------------------------------------------
+///
+/// Since the segment id occupies the high bits, comparing two LSNs orders the
+/// records the same way they were written, and an LSN can be stored as a
+/// plain 8-byte integer wherever a pointer into the WAL is needed.
+class LSN {
+ public:
+  static constexpr int kOffsetBits = 32;
+  static constexpr uint64_t kOffsetMask = (uint64_t{1} << kOffsetBits) - 1;
+
+  /// The largest segment id and offset an LSN can represent.
+  static constexpr SegmentId kMaxSegmentId = ~uint64_t{0} >> kOffsetBits;
+  static constexpr int64_t kMaxOffset = kOffsetMask;
+
+  /// Constructs an invalid LSN. Segment ids start at 1, so no record is ever
+  /// located at the zero LSN.
+  constexpr LSN() = default;
+
+  constexpr LSN(SegmentId segment_id, int64_t offset)
+      : value_{(segment_id << kOffsetBits) |
+               (static_cast<uint64_t>(offset) & kOffsetMask)} {}
+
+  /// Reconstructs an LSN from the value returned by `Value()`.
+  static constexpr LSN FromValue(uint64_t value) {
+    LSN lsn;
+    lsn.value_ = value;
+
+    return lsn;
+  }
+
+  /// \return The packed representation of this LSN.
+  constexpr uint64_t Value() const { return value_; }
+
+  /// \return The id of the segment holding the record.
+  constexpr SegmentId GetSegmentId() const { return value_ >> kOffsetBits; }
+
+  /// \return The offset of the record within its segment.
+  constexpr int64_t GetOffset() const {
+    return static_cast<int64_t>(value_ & kOffsetMask);
+  }
+
+  /// \return `true` if this LSN may refer to a record, `false` otherwise.
+  constexpr bool IsValid() const { return GetSegmentId() != 0; }
+
+  constexpr auto operator<=>(const LSN&) const = default;
+
+ private:
+  uint64_t value_ = 0;
+};
+
+static_assert(sizeof(LSN) == sizeof(uint64_t));
+
+inline std::ostream& operator<<(std::ostream& os, LSN lsn) {
+  return os << lsn.GetSegmentId() << ":" << lsn.GetOffset();
+}
+
+}  // namespace rosekv
+
+namespace std {
+
+template <>
+struct hash<rosekv::LSN> {
+  size_t operator()(rosekv::LSN lsn) const noexcept {
+    return hash<uint64_t>{}(lsn.Value());
+  }
+};
+
+}  // namespace std
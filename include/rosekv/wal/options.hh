@@ -3,6 +3,8 @@
 #include <chrono>
 #include <string>
 
+#include "rosekv/wal/checksum.hh"
+
 namespace rosekv {
 
 inline constexpr const char* kDefSegFileExtension = ".seg";
@@ -15,9 +17,35 @@ struct Options {
   /// The file extension used for segment files (e.g. ".seg").
   std::string file_extension_ = kDefSegFileExtension;
 
+  /// The id of the first segment if the directory holds none, e.g. the next
+  /// id the database last recorded, so that the ids it refers to are not
+  /// handed out again. Ids of segments created after that are not covered.
+  uint64_t first_segment_id = 1;
+
   /// The maximum allowed size for a single segment file, in bytes.
   int64_t max_segment_sz = 64 * 1024 * 1024;
 
+  /// The block size of newly created segments, in bytes. Records larger than
+  /// a block are split into one chunk per block, so logs of large records
+  /// benefit from blocks of 256KB or more. Existing segments keep the block
+  /// size they were created with.
+  int64_t block_size = 32 * 1024;
+
+  /// The checksum protecting the chunks of newly created segments. XXH64 and
+  /// hardware accelerated CRC32C are considerably cheaper than CRC32 on large
+  /// records. Existing segments keep the checksum they were created with.
+  ChecksumType checksum = ChecksumType::kCrc32;
+
+  /// The maximum number of sealed segment files kept open for reads. Sealed
+  /// segments are opened lazily and the least recently used one is closed
+  /// once this limit is reached.
+  std::size_t max_open_segments = 64;
+
+  /// The maximum number of bytes of recently written records kept in memory
+  /// while subscribers exist, so that tailing readers which keep up with the
+  /// writes are served without reading the segment files.
+  std::size_t tail_buffer_size = 4 * 1024 * 1024;
+
   /// The number of bytes written before triggering a sync operation.
   /// If zero, syncing is disabled based on byte thresholds.
   int64_t sync_bytes_threshold = 0;
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "rosekv/wal/lsn.hh"
+#include "rosekv/wal/segment.hh"
+
+namespace rosekv {
+
+class WAL;
+
+/// Streams the segments of a WAL to a follower over a connected stream socket
+/// (Unix domain or TCP).
+///
+/// Segments are shipped as raw bytes in the existing chunk format, at most
+/// one block per frame, so the follower's segment files end up byte for byte
+/// identical to the leader's without any re-encoding. Up to
+/// `max_inflight_blocks` frames may be sent before they are acknowledged.
+///
+/// Wire format, all integers little endian:
+///
+/// Frame (leader -> follower):
+/// ---------------------------------------------------------------------
+/// | Segment id (8 bytes) | Offset (4 bytes) | Length (4 bytes) | Data |
+/// ---------------------------------------------------------------------
+///
+/// Ack (follower -> leader):
+/// ---------------------------
+/// | Durable LSN (8 bytes)   |
+/// ---------------------------
+///
+/// The first ack is sent by the follower right after connecting and tells
+/// the leader where to resume streaming.
+class ReplicationSender {
+ public:
+  /// \param wal The WAL to stream, which must outlive the sender.
+  /// \param fd A connected socket, owned and closed by the sender.
+  /// \param max_inflight_blocks The maximum number of unacknowledged frames.
+  ReplicationSender(WAL* wal, int fd, std::size_t max_inflight_blocks = 64);
+
+  /// Stops streaming and closes the socket.
+  ~ReplicationSender();
+
+  ReplicationSender(const ReplicationSender&) = delete;
+  ReplicationSender& operator=(const ReplicationSender&) = delete;
+
+  /// Waits for the follower to report its durable position and starts
+  /// streaming from there on a background thread.
+  ///
+  /// \param ec Set if the handshake fails.
+  void Start(std::error_code& ec);
+
+  /// Stops streaming. Safe to call more than once.
+  void Stop();
+
+  /// \return The position up to which the follower has durably stored the
+  ///         log.
+  LSN GetAckedLSN();
+
+  /// Blocks until the follower has durably stored the log up to `lsn`, at
+  /// most for `timeout`.
+  ///
+  /// \return `true` if the follower caught up, `false` otherwise.
+  bool WaitForAck(LSN lsn, std::chrono::milliseconds timeout);
+
+  /// \return The error that stopped streaming, if any.
+  std::error_code Status();
+
+ private:
+  void SendLoop(LSN from_lsn);
+  void AckLoop();
+  void Fail(std::error_code ec);
+
+  WAL* wal_;
+  int fd_;
+  const std::size_t max_inflight_blocks_;
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+  std::error_code status_;
+  LSN acked_lsn_;
+
+  /// The end positions of the frames sent but not acknowledged yet.
+  std::deque<LSN> inflight_;
+
+  std::thread send_thread_;
+  std::thread ack_thread_;
+};
+
+/// Receives segments streamed by a `ReplicationSender` and appends them to
+/// the segment files in a directory, acknowledging each frame once it is
+/// durable. The directory can later be opened as a `WAL`, e.g. when the
+/// follower is promoted.
+///
+/// \note No `WAL` may be open on the same directory while the receiver runs.
+class ReplicationReceiver {
+ public:
+  /// \param wal_dir The directory holding the follower's segments.
+  /// \param fd A connected socket, owned and closed by the receiver.
+  ReplicationReceiver(std::string wal_dir, int fd);
+  ~ReplicationReceiver();
+
+  ReplicationReceiver(const ReplicationReceiver&) = delete;
+  ReplicationReceiver& operator=(const ReplicationReceiver&) = delete;
+
+  /// Receives frames until the leader closes the connection.
+  ///
+  /// \param ec Set if receiving or storing a frame fails.
+  void Run(std::error_code& ec);
+
+  /// \return The position up to which the log has been stored durably.
+  LSN GetDurableLSN() const { return durable_lsn_.load(); }
+
+ private:
+  bool OpenSegment(SegmentId id);
+  bool SendAck();
+
+  std::string wal_dir_;
+  int fd_;
+  std::unique_ptr<Segment> segment_;
+  SegmentId segment_id_ = 0;
+  std::atomic<LSN> durable_lsn_;
+  std::vector<char> buffer_;
+};
+
+}  // namespace rosekv
@@ -2,64 +2,183 @@
 
 #include <glog/logging.h>
 
-#include <array>
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <kiwi/io/file.hh>
 #include <kiwi/io/iobuf.hh>
 #include <kiwi/metrics/crc32.hh>
 #include <kiwi/util/byte_order.hh>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "rosekv/wal/checksum.hh"
 
 namespace rosekv {
 
 using Slice = kiwi::span<const char>;
 
-class Segment {
+/// The block size argument of a `BasicSegment` taking the block size of each
+/// segment from its format at runtime.
+inline constexpr int64_t kDynamicBlockSize = 0;
+
+/// The block size of v1 segments, and the default one of v2 segments.
+inline constexpr int64_t kDefaultBlockSize = 32 * 1024;
+
+/// A segment file of the WAL.
+///
+/// \tparam kBlockSize The block size of the segment, or `kDynamicBlockSize`
+///                    to use the one declared by the segment's format. A
+///                    fixed block size turns all block offset arithmetic into
+///                    constant divisions and masks, but segments of any other
+///                    block size are rejected as invalid.
+/// \tparam Checksum The checksum policy of the chunks, see checksum.hh. A
+///                  fixed policy rejects segments recorded with any other
+///                  checksum as invalid, while `DynamicChecksum` uses the
+///                  one recorded by each segment.
+template <int64_t kBlockSize = kDefaultBlockSize,
+          typename Checksum = Crc32Checksum>
+class BasicSegment {
   /// Defines the structure of a data chunk stored within the segment file.
   /// Each chunk includes a CRC for integrity, its length, a type indicating
   /// its position in a multi-chunk record, and the actual data.
   ///
-  /// Chunk Format:
+  /// Chunk Format (v1):
   /// ------------------------------------------------------------------------
   /// | CRC (4 bytes) | Length (2 bytes) | Type (1 byte) | Data              |
   /// ------------------------------------------------------------------------
+  ///
+  /// Chunk Format (v2), where the length and the type are packed into a
+  /// varint as `length << 3 | type`, so small chunks take a 5-byte header:
+  /// ------------------------------------------------------------------------
+  /// | CRC (4 bytes) | Length and type (1-4 bytes) | Data                   |
+  /// ------------------------------------------------------------------------
+  ///
+  /// A v2 segment starts with a segment header declaring its format:
+  /// ------------------------------------------------------------------------
+  /// | Magic (4 bytes) | Version (1 byte) | Checksum type (1 byte) |
+  /// | Reserved (2 bytes) | Block size (4 bytes) |
+  /// | CRC32 of the previous 12 bytes (4 bytes) |
+  /// ------------------------------------------------------------------------
+  /// v1 segments have no segment header, always use 32KB blocks and protect
+  /// their chunks with CRC32.
+  ///
+  /// A packed chunk holds several small records behind a single header and
+  /// CRC, prefixed with a table of their lengths:
+  /// ------------------------------------------------------------------------
+  /// | Count (varint) | Length of each record (varint each) | Records       |
+  /// ------------------------------------------------------------------------
   enum ChunkType : uint8_t {
     kFull,    ///< Represents a complete record contained within a single chunk.
     kFirst,   ///< The first chunk of a multi-chunk record.
     kMiddle,  ///< A middle chunk of a multi-chunk record.
-    kLast     ///< The last chunk of a multi-chunk record.
+    kLast,    ///< The last chunk of a multi-chunk record.
+    kPacked   ///< Several complete records packed into a single chunk.
   };
 
+  /// The number of bits of a v2 chunk header varint holding the chunk type.
+  static constexpr int kTypeBits = 3;
+
+  static constexpr bool StartsRecord(ChunkType type) {
+    return type == kFull || type == kFirst || type == kPacked;
+  }
+
+  static constexpr bool EndsRecord(ChunkType type) {
+    return type == kFull || type == kLast || type == kPacked;
+  }
+
 #pragma pack(push, 1)
-  struct ChunkHeader {
+  struct ChunkHeaderV1 {
     uint32_t crc32;
     uint16_t len;
     ChunkType type;
   };
 #pragma pack(pop)
 
-  struct Chunk {
-    ChunkHeader header;
-    Slice data;
+  /// A chunk header decoded from either format.
+  struct ChunkHeader {
+    uint32_t crc32;
+    uint32_t len;
+    ChunkType type;
+    /// The number of bytes the header takes up on disk, or 0 if it could not
+    /// be decoded.
+    int size;
   };
 
-  static constexpr std::size_t kLenOffset = offsetof(ChunkHeader, len);
-  static constexpr std::size_t kCrcOffset = offsetof(ChunkHeader, crc32);
-  static constexpr std::size_t kTypeOffset = offsetof(ChunkHeader, type);
+  static constexpr std::size_t kLenOffset = offsetof(ChunkHeaderV1, len);
+  static constexpr std::size_t kCrcOffset = offsetof(ChunkHeaderV1, crc32);
+  static constexpr std::size_t kTypeOffset = offsetof(ChunkHeaderV1, type);
 
  public:
   using Offset = int64_t;
 
-  static constexpr int kChunkHeaderSize = sizeof(ChunkHeader);
-  static constexpr int kMaxBlockSize = 32768;
-  static constexpr int kMaxPayLoad = kMaxBlockSize - kChunkHeaderSize;
+  static constexpr uint8_t kFormatV1 = 1;
+  static constexpr uint8_t kFormatV2 = 2;
 
-  static int64_t ComputeRequiredSpace(Slice data) {
+  /// The size of a v1 chunk header.
+  static constexpr int kChunkHeaderSize = sizeof(ChunkHeaderV1);
+  /// The largest chunk header of any format.
+  static constexpr int kMaxChunkHeaderSize = 8;
+  /// The block size of v1 segments, and the default one of v2 segments.
+  static constexpr int kMaxBlockSize = kDefaultBlockSize;
+
+  /// The bounds of the block size of v2 segments. Chunk lengths must fit the
+  /// 4-byte varint of a v2 chunk header.
+  static constexpr int64_t kMinBlockSize = 1024;
+  static constexpr int64_t kMaxV2BlockSize = 16 * 1024 * 1024;
+
+  static constexpr uint32_t kSegmentMagic = 0x53564b52;  // "RKVS"
+  static constexpr int kSegmentHeaderSize = 16;
+
+  /// The maximum number of blocks `ReadBatch()` fetches with a single read.
+  static constexpr int kMaxBatchReadBlocks = 32;
+
+  /// The on-disk format of a segment.
+  struct Format {
+    uint8_t version = kFormatV2;
+    int64_t block_size = kMaxBlockSize;
+    ChecksumType checksum = ChecksumType::kCrc32;
+  };
+
+  /// How the file of a segment is opened.
+  enum class OpenMode {
+    /// For reads and appends, creating the file if it does not exist.
+    kReadWrite,
+    /// For reads only, e.g. a sealed segment. A missing file is not created
+    /// and leaves the segment invalid.
+    kReadOnly,
+  };
+
+  /// The outcome of `ReadPartialAt()`.
+  enum class ReadResult {
+    /// The record ends within the segment.
+    kEnded,
+    /// The record continues in the next segment.
+    kContinued,
+    /// A chunk of the record is torn or does not match its checksum, e.g. the
+    /// last record of a segment cut short by a crash.
+    kCorrupted,
+  };
+
+  int64_t ComputeRequiredSpace(Slice data) const {
+    return ComputeRequiredSpace(data.size());
+  }
+
+  /// \return The worst-case number of bytes a record of `size` bytes takes up
+  ///         once encoded into chunks, not counting the segment header.
+  int64_t ComputeRequiredSpace(std::size_t size) const {
+    auto header_size = MaxChunkHeaderSize();
     // TODO(gc): add checked_cast.
-    auto [nblocks, remain] = std::div(data.size(), kMaxPayLoad);
+    auto [nblocks, remain] =
+        std::div(static_cast<int64_t>(size),
+                 static_cast<int64_t>(BlockSize() - header_size));
 
-    return nblocks * kMaxBlockSize + remain +
-           (remain == 0 ? 0 : kChunkHeaderSize);
+    return nblocks * BlockSize() + remain + (remain == 0 ? 0 : header_size);
   }
 
   /// Constructs a Segment object, opening the specified file.
@@ -68,9 +187,45 @@ class Segment {
   ///        appending, and will be created if it does not exist.
   ///
   /// \param filepath The path to the segment file.
-  explicit Segment(kiwi::FilePath filepath)
-      : file_{filepath, kiwi::File::kFlagOpenAlways | kiwi::File::kFlagRead |
-                            kiwi::File::kFlagWrite | kiwi::File::kFlagAppend} {}
+  explicit BasicSegment(kiwi::FilePath filepath)
+      : BasicSegment(std::move(filepath), DefaultFormat()) {}
+
+  /// Constructs a Segment object, opening the specified file in `mode`.
+  ///
+  /// \param filepath The path to the segment file.
+  /// \param mode How to open the file. Appending to a segment opened with
+  ///             `OpenMode::kReadOnly` asserts.
+  BasicSegment(kiwi::FilePath filepath, OpenMode mode)
+      : BasicSegment(std::move(filepath), DefaultFormat(), mode) {}
+
+  /// Constructs a Segment object, opening the specified file.
+  ///
+  /// \param filepath The path to the segment file.
+  /// \param format The format to write if the file is empty. The format of a
+  ///               non-empty file is read from the file itself.
+  /// \param mode How to open the file.
+  BasicSegment(kiwi::FilePath filepath, const Format& format,
+               OpenMode mode = OpenMode::kReadWrite)
+      : file_{filepath, OpenFlags(mode)},
+        format_{format},
+        read_only_{mode == OpenMode::kReadOnly} {
+    DCHECK(format_.version == kFormatV2 || format_.block_size == kMaxBlockSize);
+    DCHECK(format_.block_size >= kMinBlockSize &&
+           format_.block_size <= kMaxV2BlockSize);
+    DCHECK(kBlockSize == kDynamicBlockSize || format_.block_size == kBlockSize);
+    DCHECK(format_.version == kFormatV2 ||
+           format_.checksum == ChecksumType::kCrc32);
+    DCHECK(IsDynamicChecksum() || format_.checksum == DefaultChecksumType());
+
+    // Reopening an existing segment resumes appending at its end.
+    if (file_.IsValid()) {
+      offset_ = file_.GetLength();
+
+      if (offset_ > 0) {
+        LoadFormat();
+      }
+    }
+  }
 
   /// Appends a data slice to the segment file as one or more chunks.
   ///
@@ -79,59 +234,579 @@ class Segment {
   ///         written.
   /// \note This method asserts if the segment is closed or invalid.
   Offset Append(Slice data) {
-    DCHECK(!IsClosed() && IsValid());
+    return AppendV(kiwi::span<const Slice>(&data, 1));
+  }
 
+  /// Appends a record made up of several slices, e.g. a header, a key and a
+  /// value, as if they had been concatenated, but without copying them.
+  ///
+  /// Chunks are cut across slice boundaries as needed, each chunk's CRC is
+  /// computed over all the pieces it covers, and the slices are handed to the
+  /// file wrapped as they are.
+  ///
+  /// \param slices The slices forming the record, in order.
+  /// \return The offset in the file where the first chunk of the record was
+  ///         written.
+  /// \note This method asserts if the segment is closed or invalid.
+  Offset AppendV(kiwi::span<const Slice> slices) {
+    std::size_t nbytes = 0;
+
+    return *AppendPartial(slices, /*continued=*/false,
+                          std::numeric_limits<int64_t>::max(), &nbytes);
+  }
+
+  /// Appends as much of a record as fits in `max_size` more bytes of the
+  /// segment, so that a record can continue in the next segment instead of
+  /// being capped by the segment size.
+  ///
+  /// The chunks written end the record only if all of it fits, and start it
+  /// only if `continued` is `false`.
+  ///
+  /// \param slices The slices forming the rest of the record, in order.
+  /// \param continued Whether the record started in a previous segment.
+  /// \param max_size The number of bytes the segment may still grow by. Block
+  ///                 padding may exceed it by a few bytes.
+  /// \param nbytes Receives the number of bytes of the record appended.
+  /// \return The offset in the file where the first chunk was written, or
+  ///         `std::nullopt` if not even a chunk fits.
+  /// \note This method asserts if the segment is closed or invalid.
+  std::optional<Offset> AppendPartial(kiwi::span<const Slice> slices,
+                                      bool continued, int64_t max_size,
+                                      std::size_t* nbytes) {
+    DCHECK(!IsClosed() && IsValid() && !read_only_);
+
+    auto start = offset_;
+    auto io_buf = BeginAppend();
     auto saved_offset = offset_;
-    std::unique_ptr<kiwi::IOBuf> io_buf;
-    auto avail = AvailableSpaceInCurrentBlock() - kChunkHeaderSize;
+    std::vector<Slice> pieces;
+    std::size_t size = 0;
 
-    if (KIWI_LIKELY(data.size() <= avail)) {
-      io_buf = Encode(data, ChunkType::kFull);
-    } else {
-      auto [first, subspan] = data.split_at(static_cast<size_t>(avail));
-      io_buf = Encode(first, ChunkType::kFirst);
-
-      while (subspan.size() >
-             AvailableSpaceInCurrentBlock() - kChunkHeaderSize) {
-        auto [middle, rest] = subspan.split_at(static_cast<size_t>(
-            AvailableSpaceInCurrentBlock() - kChunkHeaderSize));
-        io_buf->AppendToChain(Encode(middle, ChunkType::kMiddle));
-        subspan = rest;
+    for (const auto& slice : slices) {
+      size += slice.size();
+    }
+
+    // The slice and the position within it where the next chunk starts.
+    std::size_t remaining = size;
+    std::size_t index = 0;
+    std::size_t pos = 0;
+    bool first = !continued;
+
+    do {
+      auto avail = std::min(AvailableSpaceInCurrentBlock(),
+                            max_size - (offset_ - start));
+
+      // A chunk needs room for at least one byte, unless the record is empty.
+      if (avail < MinChunkHeaderSize() + (remaining > 0 ? 1 : 0)) {
+        break;
+      }
+
+      auto header_size = ChunkHeaderSize(
+          std::min<std::size_t>(remaining, avail - MinChunkHeaderSize()));
+      auto len = std::min<std::size_t>(remaining, avail - header_size);
+      bool last = len == remaining;
+
+      pieces.clear();
+
+      for (auto need = len; need > 0;) {
+        auto n = std::min(need, slices[index].size() - pos);
+
+        pieces.push_back(slices[index].subspan(pos, n));
+        need -= n;
+        pos += n;
+
+        if (pos == slices[index].size()) {
+          ++index;
+          pos = 0;
+        }
+      }
+
+      auto type = first ? (last ? ChunkType::kFull : ChunkType::kFirst)
+                        : (last ? ChunkType::kLast : ChunkType::kMiddle);
+      auto chunk = Encode(pieces, type);
+
+      if (io_buf == nullptr) {
+        io_buf = std::move(chunk);
+      } else {
+        io_buf->AppendToChain(std::move(chunk));
+      }
+
+      remaining -= len;
+      first = false;
+    } while (remaining > 0);
+
+    *nbytes = size - remaining;
+
+    if (io_buf != nullptr) {
+      auto written = file_.WriteIOBufAtCurrentPos(*io_buf.get());
+
+      DCHECK_EQ(written, io_buf->ComputeChainDataLength());
+    }
+
+    if (offset_ == saved_offset) {
+      return std::nullopt;
+    }
+
+    return saved_offset;
+  }
+
+  /// Packs a prefix of `records` into a single chunk, so that each record
+  /// costs the varint of its length rather than a chunk header and a CRC.
+  ///
+  /// A packed chunk never crosses a block boundary, so only the records that
+  /// fit in the rest of the current block are packed. If fewer than two fit,
+  /// the first record is appended as a regular record instead, which
+  /// `ReadPackedAt()` reads back as index 0 all the same.
+  ///
+  /// \param records The records to append, in order.
+  /// \param count Receives the number of records appended, at least 1.
+  /// \return The offset of the chunk. Record `i` of the chunk is read back
+  ///         with `ReadPackedAt(offset, i)`.
+  /// \note This method asserts if the segment is closed or invalid.
+  Offset AppendPacked(kiwi::span<const Slice> records, std::size_t* count) {
+    DCHECK(!IsClosed() && IsValid() && !read_only_);
+    DCHECK(!records.empty());
+
+    // The segment header, if not written yet, goes first.
+    auto avail = AvailableSpaceInBlockAt(std::max(offset_, DataOffset()));
+    std::size_t n = 0;
+    int64_t table_size = 0;
+    int64_t data_size = 0;
+
+    for (; n < records.size(); ++n) {
+      auto len = static_cast<int64_t>(records[n].size());
+      auto size = VarintLength(n + 1) + table_size + VarintLength(len) +
+                  data_size + len;
+
+      if (ChunkHeaderSize(size) + size > avail) {
+        break;
       }
 
-      io_buf->AppendToChain(Encode(subspan, ChunkType::kLast));
+      table_size += VarintLength(len);
+      data_size += len;
+    }
+
+    if (n < 2) {
+      *count = 1;
+
+      return Append(records[0]);
+    }
+
+    std::string table(VarintLength(n) + table_size, '\0');
+    auto ptr = reinterpret_cast<uint8_t*>(table.data());
+
+    ptr += EncodeVarint(n, ptr);
+
+    for (std::size_t i = 0; i < n; ++i) {
+      ptr += EncodeVarint(records[i].size(), ptr);
+    }
+
+    std::vector<Slice> pieces;
+    pieces.reserve(n + 1);
+    pieces.push_back(kiwi::span(static_cast<std::string_view>(table)));
+    pieces.insert(pieces.end(), records.begin(), records.begin() + n);
+
+    auto io_buf = BeginAppend();
+    auto saved_offset = offset_;
+    auto chunk = Encode(pieces, ChunkType::kPacked);
+
+    if (io_buf == nullptr) {
+      io_buf = std::move(chunk);
+    } else {
+      io_buf->AppendToChain(std::move(chunk));
     }
 
     auto nbytes = file_.WriteIOBufAtCurrentPos(*io_buf.get());
 
     DCHECK_EQ(nbytes, io_buf->ComputeChainDataLength());
 
+    *count = n;
+
     return saved_offset;
   }
 
   /// Reads data starting from a specific offset in the segment file.
   ///
+  /// \note Chunk payloads are read straight into the returned string, so
+  ///       concurrent readers may share a single `Segment` handle.
+  ///
   /// \param offset The file offset from which to start reading.
+  /// \param next_offset If not null, receives the offset of the record that
+  ///                    follows, as `NextRecordOffset()` would return it.
   /// \return A `std::string` containing the reconstructed data.
-  std::string ReadAt(Offset offset) {
+  std::string ReadAt(Offset offset, Offset* next_offset = nullptr) const {
     DCHECK(!IsClosed() && IsValid());
 
+    offset = GetAlignedReadOffset(offset);
+    ChunkHeader header = DecodeHeader(offset);
     std::string data;
 
+    if (KIWI_LIKELY(EndsRecord(header.type))) {
+      data.resize(header.len);
+      ReadPayload(offset, header, data.data());
+
+      if (next_offset != nullptr) {
+        *next_offset = GetAlignedReadOffset(offset + header.size + header.len);
+      }
+
+      return data;
+    }
+
+    // Size multi-chunk records from their chunk headers first, so the result
+    // is allocated once instead of growing chunk by chunk.
+    data.resize(ReadAt(offset, kiwi::span<char>{}));
+    ReadAt(offset, kiwi::span(data.data(), data.size()), next_offset);
+
+    return data;
+  }
+
+  /// Reads the chunks of the record at `offset` up to `end`, for records that
+  /// may continue in the next segment.
+  ///
+  /// \param offset The offset of a chunk of the record, e.g. the first chunk
+  ///               of the segment for a record continued from the previous
+  ///               segment.
+  /// \param end The offset to stop at, typically the size of the segment.
+  /// \param data The payloads of the chunks read are appended to it.
+  /// \param next_offset If not null, receives the offset right after the
+  ///                    chunks read, as `NextRecordOffset()` would return it.
+  /// \return Whether the record ends within the segment, continues in the
+  ///         next one, or is corrupted. Each chunk is verified against its
+  ///         checksum before it is appended to `data`.
+  ReadResult ReadPartialAt(Offset offset, Offset end, std::string* data,
+                           Offset* next_offset = nullptr) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    bool last = false;
+
+    while (!last) {
+      offset = GetAlignedReadOffset(offset);
+
+      if (offset >= end) {
+        break;
+      }
+
+      ChunkHeader header = DecodeHeader(offset, /*check=*/false);
+
+      if (!IsWellFormed(offset, header) ||
+          offset + header.size + header.len > end) {
+        return ReadResult::kCorrupted;
+      }
+
+      auto size = data->size();
+
+      data->resize(size + header.len);
+
+      if (!TryReadPayload(offset, header, data->data() + size)) {
+        return ReadResult::kCorrupted;
+      }
+
+      offset += header.size + header.len;
+      last = EndsRecord(header.type);
+    }
+
+    if (next_offset != nullptr) {
+      *next_offset = GetAlignedReadOffset(offset);
+    }
+
+    return last ? ReadResult::kEnded : ReadResult::kContinued;
+  }
+
+  /// \return The offset of the first record starting in the segment, past
+  ///         the end of any record continued from the previous segment, or
+  ///         at least `end` if no record starts before `end`. A torn chunk
+  ///         stops the search, for the read at its offset to report it.
+  Offset FirstRecordOffset(Offset end) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    auto offset = GetAlignedReadOffset(0);
+
+    while (offset < end) {
+      ChunkHeader header = DecodeHeader(offset, /*check=*/false);
+
+      if (!IsWellFormed(offset, header) || StartsRecord(header.type)) {
+        break;
+      }
+
+      offset = GetAlignedReadOffset(offset + header.size + header.len);
+    }
+
+    return offset;
+  }
+
+  /// Reads data starting from a specific offset into a caller-provided
+  /// buffer, so hot paths can reuse their buffers across reads.
+  ///
+  /// \param offset The file offset from which to start reading.
+  /// \param buf The buffer receiving the record.
+  /// \param next_offset If not null, receives the offset of the record that
+  ///                    follows, as `NextRecordOffset()` would return it.
+  /// \return The size of the record. If it exceeds the size of `buf`, the
+  ///         contents of `buf` are unspecified and the read must be retried
+  ///         with a buffer of at least the returned size.
+  int64_t ReadAt(Offset offset, kiwi::span<char> buf,
+                 Offset* next_offset = nullptr) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    int64_t size = 0;
+
     while (true) {
       offset = GetAlignedReadOffset(offset);
 
-      Chunk chunk = Decode(offset);
-      auto type = chunk.header.type;
+      ChunkHeader header = DecodeHeader(offset);
 
-      data.append(chunk.data.begin(), chunk.data.end());
+      // Once the buffer is known to be too small, only the headers are read
+      // to find out the required size.
+      if (size + header.len <= static_cast<int64_t>(buf.size())) {
+        ReadPayload(offset, header, buf.data() + size);
+      }
 
-      if (type == ChunkType::kLast || type == ChunkType::kFull) break;
+      size += header.len;
+      offset += header.size + header.len;
 
-      offset += kChunkHeaderSize + chunk.data.size();
+      if (EndsRecord(header.type)) {
+        break;
+      }
+    }
+
+    // Block padding is always written along with the chunk preceding it.
+    if (next_offset != nullptr) {
+      *next_offset = GetAlignedReadOffset(offset);
     }
 
-    return std::move(data);
+    return size;
+  }
+
+  /// Reads data starting from a specific offset as a chain of `kiwi::IOBuf`s,
+  /// one per chunk, each holding the chunk's payload. Unlike `ReadAt()`,
+  /// this never copies a payload once it has been read.
+  ///
+  /// \param offset The file offset from which to start reading.
+  /// \param next_offset If not null, receives the offset of the record that
+  ///                    follows, as `NextRecordOffset()` would return it.
+  /// \return The head of the chain.
+  std::unique_ptr<kiwi::IOBuf> ReadIOBufAt(
+      Offset offset, Offset* next_offset = nullptr) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    std::unique_ptr<kiwi::IOBuf> head;
+
+    while (true) {
+      offset = GetAlignedReadOffset(offset);
+
+      ChunkHeader header = DecodeHeader(offset);
+      auto fragment = kiwi::IOBuf::Create(header.len);
+
+      ReadPayload(offset, header,
+                  reinterpret_cast<char*>(fragment->WritableData()));
+      fragment->Append(header.len);
+
+      if (head == nullptr) {
+        head = std::move(fragment);
+      } else {
+        head->AppendToChain(std::move(fragment));
+      }
+
+      offset += header.size + header.len;
+
+      if (EndsRecord(header.type)) {
+        break;
+      }
+    }
+
+    if (next_offset != nullptr) {
+      *next_offset = GetAlignedReadOffset(offset);
+    }
+
+    return head;
+  }
+
+  /// Reads a single record of the chunk at `offset`.
+  ///
+  /// \param offset The offset returned by `AppendPacked()`.
+  /// \param index The index of the record within the chunk.
+  /// \return The record, or `std::nullopt` if the chunk has no record at
+  ///         `index`. A chunk that is not packed holds a single record.
+  std::optional<std::string> ReadPackedAt(Offset offset,
+                                          std::size_t index) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    offset = GetAlignedReadOffset(offset);
+    ChunkHeader header = DecodeHeader(offset);
+
+    if (header.type != ChunkType::kPacked) {
+      return index == 0 ? std::optional{ReadAt(offset)} : std::nullopt;
+    }
+
+    std::string payload(header.len, '\0');
+    ReadPayload(offset, header, payload.data());
+
+    auto records = ParsePacked(payload);
+
+    if (index >= records.size()) {
+      return std::nullopt;
+    }
+
+    return std::string{records[index]};
+  }
+
+  /// Reads all the records of the chunk at `offset`.
+  ///
+  /// \param offset The offset returned by `AppendPacked()`.
+  /// \return The records, in the order they were packed.
+  std::vector<std::string> ReadPackedAt(Offset offset) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    offset = GetAlignedReadOffset(offset);
+    ChunkHeader header = DecodeHeader(offset);
+
+    if (header.type != ChunkType::kPacked) {
+      return {ReadAt(offset)};
+    }
+
+    std::string payload(header.len, '\0');
+    ReadPayload(offset, header, payload.data());
+
+    auto records = ParsePacked(payload);
+
+    return {records.begin(), records.end()};
+  }
+
+  /// Appends raw bytes in the segment format as they are, e.g. blocks shipped
+  /// from another segment by replication, without encoding them into chunks.
+  ///
+  /// \param data Bytes copied from another segment starting at `Size()`.
+  /// \return `true` if all bytes were written, `false` otherwise.
+  bool AppendRaw(Slice data) {
+    DCHECK(!IsClosed() && IsValid() && !read_only_);
+
+    auto nbytes = file_.WriteAtCurrentPos(data.data(), data.size());
+
+    if (nbytes < 0) {
+      return false;
+    }
+
+    // The format of the source segment is known once its first bytes arrive.
+    if (offset_ == 0 && nbytes > 0) {
+      offset_ += nbytes;
+      LoadFormat();
+    } else {
+      offset_ += nbytes;
+    }
+
+    return static_cast<std::size_t>(nbytes) == data.size();
+  }
+
+  /// Reads raw bytes of the segment without decoding them.
+  ///
+  /// \param offset The offset to read from.
+  /// \param buf The buffer to fill.
+  /// \return The number of bytes read, which is less than the size of `buf`
+  ///         only at the end of the segment, or -1 on error.
+  int64_t ReadRaw(Offset offset, kiwi::span<char> buf) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    return file_.Read(offset, buf.data(), buf.size());
+  }
+
+  /// Computes where the record starting at `offset` ends, walking its chunks
+  /// and verifying their checksums.
+  ///
+  /// \param offset The offset of the record's first chunk.
+  /// \param continued If not null, a record running up to the end of the
+  ///                  segment without its last chunk is accepted, and this
+  ///                  receives whether that is the case.
+  /// \return The offset right after the record, including any block padding
+  ///         that follows it, or `std::nullopt` if `offset` is not the start
+  ///         of a complete record.
+  std::optional<Offset> NextRecordOffset(Offset offset,
+                                         bool* continued = nullptr) const {
+    return WalkRecord(offset, /*first=*/true, continued);
+  }
+
+  /// Computes where the record continued from the previous segment ends.
+  ///
+  /// \param continued Receives whether the record continues further in the
+  ///                  next segment.
+  /// \return The offset right after the record, or `std::nullopt` if the
+  ///         segment does not start with the rest of a record.
+  std::optional<Offset> ContinuationEnd(bool* continued) const {
+    return WalkRecord(GetAlignedReadOffset(0), /*first=*/false, continued);
+  }
+
+  /// Discards everything in the segment from `offset` onwards, so that the
+  /// next append continues at `offset`.
+  ///
+  /// \param offset The new size of the segment, which must be a chunk
+  ///               boundary, e.g. as returned by `NextRecordOffset()`.
+  /// \return `true` if the file was truncated, `false` otherwise.
+  bool Truncate(Offset offset) {
+    DCHECK(!IsClosed() && IsValid() && !read_only_);
+    DCHECK_LE(offset, offset_);
+    DCHECK(offset == 0 || offset >= DataOffset());
+
+    if (!file_.SetLength(offset)) {
+      return false;
+    }
+
+    offset_ = offset;
+
+    return true;
+  }
+
+  /// Reads the records starting at each of `offsets` with as few I/Os as
+  /// possible.
+  ///
+  /// Offsets are sorted, and runs of records falling in the same or adjacent
+  /// blocks are fetched with a single read of up to `kMaxBatchReadBlocks`
+  /// blocks, then decoded from memory. A record extending past such a range
+  /// costs one extra read for its remainder.
+  ///
+  /// \param offsets The offsets of the records to read, in any order. Each
+  ///                must lie within the segment.
+  /// \return The records, in the same order as `offsets`.
+  std::vector<std::string> ReadBatch(kiwi::span<const Offset> offsets) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    for (auto offset : offsets) {
+      CHECK(offset >= 0 && offset < offset_) << " at offset: " << offset;
+    }
+
+    std::vector<std::size_t> order(offsets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](auto a, auto b) {
+      return offsets[a] < offsets[b];
+    });
+
+    std::vector<std::string> records(offsets.size());
+    ReadWindow window;
+
+    for (std::size_t i = 0; i < order.size();) {
+      auto first_block = offsets[order[i]] / BlockSize();
+      auto last_block = first_block;
+      auto j = i + 1;
+
+      for (; j < order.size(); ++j) {
+        auto block = offsets[order[j]] / BlockSize();
+
+        if (block > last_block + 1 ||
+            block - first_block >= kMaxBatchReadBlocks) {
+          break;
+        }
+
+        last_block = block;
+      }
+
+      window.begin = first_block * BlockSize();
+      window.data.clear();
+      ExtendWindow(window,
+                   std::min<Offset>((last_block + 1) * BlockSize(), offset_));
+
+      for (; i < j; ++i) {
+        records[order[i]] = DecodeFromWindow(window, offsets[order[i]]);
+      }
+    }
+
+    return records;
   }
 
   /// Synchronizes the segment file's data to disk.
@@ -149,8 +824,11 @@ class Segment {
   /// \return `true` if the file is closed, `false` otherwise.
   constexpr bool IsClosed() const { return is_closed_; }
 
+  /// \return `true` if the segment was opened with `OpenMode::kReadOnly`.
+  constexpr bool IsReadOnly() const { return read_only_; }
+
   /// \return `true` if the file handle is valid, `false` otherwise.
-  bool IsValid() const { return file_.IsValid(); }
+  bool IsValid() const { return file_.IsValid() && !is_corrupted_; }
 
   /// \return A string containing details about the last file operation error.
   std::string GetErrorDetail() const {
@@ -160,17 +838,343 @@ class Segment {
   /// \return The current size of the segment in bytes.
   constexpr std::size_t Size() const { return offset_; }
 
- private:
-  static Offset GetAlignedReadOffset(Offset offset) {
-    auto remain = kMaxBlockSize - offset % kMaxBlockSize;
+  /// \return The on-disk format of the segment.
+  const Format& GetFormat() const { return format_; }
 
-    if (remain <= kChunkHeaderSize) {
+  /// Maps `offset` to the start of the chunk at or after it: offsets within
+  /// the segment header map to the first chunk, and offsets within block
+  /// padding to the start of the next block.
+  Offset GetAlignedReadOffset(Offset offset) const {
+    if (offset < DataOffset()) {
+      return DataOffset();
+    }
+
+    auto remain = AvailableSpaceInBlockAt(offset);
+
+    if (remain <= MinChunkHeaderSize()) {
       offset += remain;
     }
 
     return offset;
   }
 
+  /// \return The block size, folded into a constant unless the block size is
+  ///         dynamic.
+  constexpr int64_t BlockSize() const {
+    if constexpr (kBlockSize != kDynamicBlockSize) {
+      return kBlockSize;
+    } else {
+      return format_.block_size;
+    }
+  }
+
+ private:
+
+  /// Walks the chunk headers of a record, see `NextRecordOffset()`.
+  ///
+  /// \param first Whether `offset` is expected to start the record.
+  std::optional<Offset> WalkRecord(Offset offset, bool first,
+                                   bool* continued) const {
+    DCHECK(!IsClosed() && IsValid());
+
+    if (continued != nullptr) {
+      *continued = false;
+    }
+
+    while (true) {
+      offset = GetAlignedReadOffset(offset);
+
+      if (continued != nullptr && !first && offset >= offset_) {
+        *continued = true;
+        return offset_;
+      }
+
+      if (offset < 0 || offset + MinChunkHeaderSize() > offset_) {
+        return std::nullopt;
+      }
+
+      ChunkHeader header = DecodeHeader(offset, /*check=*/false);
+
+      if (!IsWellFormed(offset, header) ||
+          StartsRecord(header.type) != first || !VerifyChunk(offset, header)) {
+        return std::nullopt;
+      }
+
+      offset += header.size + header.len;
+
+      if (EndsRecord(header.type)) {
+        return std::min<Offset>(GetAlignedReadOffset(offset), offset_);
+      }
+
+      first = false;
+    }
+  }
+
+  /// \return Whether `header`, decoded at `offset`, describes a chunk of a
+  ///         known type that fits in its block.
+  bool IsWellFormed(Offset offset, const ChunkHeader& header) const {
+    return header.size != 0 && header.type <= ChunkType::kPacked &&
+           header.len <= AvailableSpaceInBlockAt(offset) - header.size;
+  }
+
+  /// \return Whether the checksum of the chunk at `offset` matches its
+  ///         contents.
+  bool VerifyChunk(Offset offset, const ChunkHeader& header) const {
+    std::vector<char> buf(header.len);
+
+    return TryReadPayload(offset, header, buf.data());
+  }
+
+  /// \return Whether `payload`, the contents of the chunk described by
+  ///         `header`, matches the checksum of the chunk.
+  bool VerifyPayload(const ChunkHeader& header, const char* payload) const {
+    // Room for the checksum and the 5-byte varint of any 32-bit value.
+    uint8_t buf[sizeof(uint32_t) + 5];
+
+    if (EncodeHeader(header.len, header.type, buf) != header.size) {
+      return false;
+    }
+
+    auto checksum = NewChecksum();
+    checksum.Update(kiwi::span<const uint8_t>{buf + sizeof(uint32_t),
+                                              header.size - sizeof(uint32_t)});
+    checksum.Update(kiwi::span<const uint8_t>{
+        reinterpret_cast<const uint8_t*>(payload), header.len});
+
+    return checksum.Digest() == header.crc32;
+  }
+
+  /// \return Whether the checksum policy follows the one recorded by each
+  ///         segment.
+  static constexpr bool IsDynamicChecksum() {
+    return std::is_constructible_v<Checksum, ChecksumType>;
+  }
+
+  /// \return The checksum new segments are written with by default.
+  static constexpr ChecksumType DefaultChecksumType() {
+    if constexpr (IsDynamicChecksum()) {
+      return ChecksumType::kCrc32;
+    } else {
+      return Checksum::kType;
+    }
+  }
+
+  /// \return A fresh checksum state for a chunk of this segment.
+  Checksum NewChecksum() const {
+    if constexpr (IsDynamicChecksum()) {
+      return Checksum{format_.checksum};
+    } else {
+      return Checksum{};
+    }
+  }
+
+  /// \return The offset of the first chunk of the segment.
+  int64_t DataOffset() const {
+    return format_.version == kFormatV2 ? kSegmentHeaderSize : 0;
+  }
+
+  /// \return The size of the header of a chunk holding `len` bytes.
+  int64_t ChunkHeaderSize(std::size_t len) const {
+    if (format_.version == kFormatV1) {
+      return kChunkHeaderSize;
+    }
+
+    return sizeof(uint32_t) + VarintLength(len << kTypeBits | ChunkType::kLast);
+  }
+
+  /// \return The size of the header of an empty chunk. Blocks are padded once
+  ///         they have no more room than that left, so every chunk but the
+  ///         one of an empty record holds at least one byte.
+  int64_t MinChunkHeaderSize() const { return ChunkHeaderSize(0); }
+
+  int64_t MaxChunkHeaderSize() const {
+    return ChunkHeaderSize(BlockSize());
+  }
+
+  static int VarintLength(uint64_t value) {
+    int n = 1;
+
+    while (value >= 0x80) {
+      value >>= 7;
+      ++n;
+    }
+
+    return n;
+  }
+
+  static int EncodeVarint(uint64_t value, uint8_t* ptr) {
+    int n = 0;
+
+    while (value >= 0x80) {
+      ptr[n++] = static_cast<uint8_t>(value | 0x80);
+      value >>= 7;
+    }
+
+    ptr[n++] = static_cast<uint8_t>(value);
+
+    return n;
+  }
+
+  /// \return The number of bytes decoded, or 0 if `ptr` does not start with a
+  ///         varint of at most `limit` bytes fitting 32 bits.
+  static int DecodeVarint(const uint8_t* ptr, int limit, uint32_t* value) {
+    uint64_t result = 0;
+
+    for (int n = 0; n < limit && n < 5; ++n) {
+      result |= static_cast<uint64_t>(ptr[n] & 0x7f) << (7 * n);
+
+      if ((ptr[n] & 0x80) == 0) {
+        if (result > UINT32_MAX) {
+          return 0;
+        }
+
+        *value = static_cast<uint32_t>(result);
+
+        return n + 1;
+      }
+    }
+
+    return 0;
+  }
+
+  /// Splits the payload of a packed chunk into its records.
+  ///
+  /// \return The records, or none if the payload is malformed.
+  static std::vector<std::string_view> ParsePacked(std::string_view payload) {
+    auto ptr = reinterpret_cast<const uint8_t*>(payload.data());
+    auto end = ptr + payload.size();
+    uint32_t count = 0;
+    auto n = DecodeVarint(ptr, end - ptr, &count);
+
+    if (n == 0 || count > payload.size()) {
+      LOG(ERROR) << "Malformed packed chunk of size: " << payload.size();
+      return {};
+    }
+
+    std::vector<uint32_t> lengths(count);
+    ptr += n;
+
+    for (auto& len : lengths) {
+      n = DecodeVarint(ptr, end - ptr, &len);
+
+      if (n == 0) {
+        LOG(ERROR) << "Malformed packed chunk of size: " << payload.size();
+        return {};
+      }
+
+      ptr += n;
+    }
+
+    std::vector<std::string_view> records;
+    records.reserve(count);
+
+    for (auto len : lengths) {
+      if (static_cast<int64_t>(len) > end - ptr) {
+        LOG(ERROR) << "Malformed packed chunk of size: " << payload.size();
+        return {};
+      }
+
+      records.emplace_back(reinterpret_cast<const char*>(ptr), len);
+      ptr += len;
+    }
+
+    return records;
+  }
+
+  /// \return The flags of `kiwi::File` opening a segment in `mode`.
+  static constexpr uint32_t OpenFlags(OpenMode mode) {
+    if (mode == OpenMode::kReadOnly) {
+      return kiwi::File::kFlagOpen | kiwi::File::kFlagRead;
+    }
+
+    return kiwi::File::kFlagOpenAlways | kiwi::File::kFlagRead |
+           kiwi::File::kFlagWrite | kiwi::File::kFlagAppend;
+  }
+
+  /// \return The format new segments are written in by default.
+  static constexpr Format DefaultFormat() {
+    return {kFormatV2,
+            kBlockSize == kDynamicBlockSize ? kMaxBlockSize : kBlockSize,
+            DefaultChecksumType()};
+  }
+
+  /// Starts an append, writing the segment header first if the segment is
+  /// still empty.
+  ///
+  /// \return The segment header to write before the chunks, if any.
+  std::unique_ptr<kiwi::IOBuf> BeginAppend() {
+    if (offset_ != 0 || format_.version != kFormatV2) {
+      return nullptr;
+    }
+
+    offset_ = kSegmentHeaderSize;
+
+    return EncodeSegmentHeader(format_);
+  }
+
+  static std::unique_ptr<kiwi::IOBuf> EncodeSegmentHeader(
+      const Format& format) {
+    auto header = kiwi::IOBuf::Create(kSegmentHeaderSize);
+    auto ptr = header->WritableData();
+
+    std::fill(ptr, ptr + kSegmentHeaderSize, 0);
+    kiwi::LittleEndian::PutUint32(ptr, kSegmentMagic);
+    ptr[4] = format.version;
+    ptr[5] = static_cast<uint8_t>(format.checksum);
+    kiwi::LittleEndian::PutUint32(ptr + 8, format.block_size);
+    kiwi::LittleEndian::PutUint32(ptr + 12,
+                                  kiwi::Crc32(0, kiwi::span{ptr, 12}));
+    header->Append(kSegmentHeaderSize);
+
+    return header;
+  }
+
+  /// Detects the format of a non-empty segment from its first bytes. A
+  /// segment not starting with the magic number predates segment headers.
+  void LoadFormat() {
+    uint8_t buf[kSegmentHeaderSize];
+    auto nbytes =
+        file_.Read(0, reinterpret_cast<char*>(buf), kSegmentHeaderSize);
+
+    Format format{kFormatV1, kMaxBlockSize, ChecksumType::kCrc32};
+
+    if (nbytes >= 4 && kiwi::LittleEndian::Uint32(buf) == kSegmentMagic) {
+      format = {buf[4], kiwi::LittleEndian::Uint32(buf + 8),
+                static_cast<ChecksumType>(buf[5])};
+
+      if (nbytes != kSegmentHeaderSize ||
+          kiwi::LittleEndian::Uint32(buf + 12) !=
+              kiwi::Crc32(0, kiwi::span<const uint8_t>{buf, 12}) ||
+          format.version != kFormatV2 || format.block_size < kMinBlockSize ||
+          format.block_size > kMaxV2BlockSize ||
+          format.checksum > kMaxChecksumType) {
+        LOG(ERROR) << "Corrupted segment header, version: "
+                   << static_cast<int>(format.version)
+                   << ", block size: " << format.block_size
+                   << ", checksum: " << static_cast<int>(format.checksum);
+        is_corrupted_ = true;
+        return;
+      }
+    }
+
+    if (!IsDynamicChecksum() && format.checksum != DefaultChecksumType()) {
+      LOG(ERROR) << "Segment checksum: " << static_cast<int>(format.checksum)
+                 << " does not match the expected one: "
+                 << static_cast<int>(DefaultChecksumType());
+      is_corrupted_ = true;
+      return;
+    }
+
+    if (kBlockSize != kDynamicBlockSize && format.block_size != kBlockSize) {
+      LOG(ERROR) << "Segment block size: " << format.block_size
+                 << " does not match the expected one: " << kBlockSize;
+      is_corrupted_ = true;
+      return;
+    }
+
+    format_ = format;
+  }
+
   /// Encodes data and chunk type into a `kiwi::IOBuf` representing a single
   /// chunk.
   ///
@@ -178,54 +1182,99 @@ class Segment {
   /// wraps the data and header into an `IOBuf` chain. It does not handle
   /// block padding or offset management.
   ///
-  /// \param data The data slice to encode.
+  /// \param pieces The slices forming the chunk's payload, in order.
   /// \param type The type of the chunk.
   /// \return A `std::unique_ptr<kiwi::IOBuf>` containing the encoded chunk.
-  static std::unique_ptr<kiwi::IOBuf> EncodeDataToChunk(Slice data,
-                                                        ChunkType type) {
-    auto header = kiwi::IOBuf::Create(kChunkHeaderSize);
+  std::unique_ptr<kiwi::IOBuf> EncodeDataToChunk(kiwi::span<const Slice> pieces,
+                                                 ChunkType type) const {
+    std::size_t len = 0;
+
+    for (const auto& piece : pieces) {
+      len += piece.size();
+    }
+
+    auto header_size = ChunkHeaderSize(len);
+    auto header = kiwi::IOBuf::Create(header_size);
     auto ptr = header->WritableData();
 
-    kiwi::LittleEndian::PutUint16(ptr + kLenOffset, data.size());
-    ptr[kTypeOffset] = type;
+    EncodeHeader(len, type, ptr);
 
-    uint32_t crc = 0;
-    crc = kiwi::Crc32(
-        crc, kiwi::span{ptr + kLenOffset, kChunkHeaderSize - kLenOffset});
-    crc = kiwi::Crc32(crc, kiwi::as_byte_span(data));
-    kiwi::LittleEndian::PutUint32(ptr, crc);
+    auto checksum = NewChecksum();
+    checksum.Update(kiwi::span<const uint8_t>{ptr + sizeof(uint32_t),
+                                              header_size - sizeof(uint32_t)});
 
-    header->Append(kChunkHeaderSize);
-    header->AppendToChain(kiwi::IOBuf::WrapBuffer(data.data(), data.size()));
+    for (const auto& piece : pieces) {
+      checksum.Update(kiwi::as_byte_span(piece));
+    }
+
+    kiwi::LittleEndian::PutUint32(ptr, checksum.Digest());
+    header->Append(header_size);
+
+    for (const auto& piece : pieces) {
+      header->AppendToChain(
+          kiwi::IOBuf::WrapBuffer(piece.data(), piece.size()));
+    }
 
     return header;
   }
 
+  /// Writes the length and type of a chunk header to `ptr`, after the room
+  /// left for its checksum.
+  ///
+  /// \return The size of the header.
+  int64_t EncodeHeader(std::size_t len, ChunkType type, uint8_t* ptr) const {
+    if (format_.version == kFormatV1) {
+      kiwi::LittleEndian::PutUint16(ptr + kLenOffset, len);
+      ptr[kTypeOffset] = type;
+
+      return kChunkHeaderSize;
+    }
+
+    return sizeof(uint32_t) +
+           EncodeVarint(len << kTypeBits | type, ptr + sizeof(uint32_t));
+  }
+
   /// \return The number of bytes available in the current block.
   int64_t AvailableSpaceInCurrentBlock() const {
-    return kMaxBlockSize - offset_ % kMaxBlockSize;
+    return AvailableSpaceInBlockAt(offset_);
+  }
+
+  /// \return The number of bytes between `offset` and the end of its block.
+  int64_t AvailableSpaceInBlockAt(Offset offset) const {
+    // Segments of the default block size, which the WAL writes unless told
+    // otherwise, get the constant folded arithmetic of `DefaultSegment`.
+    if constexpr (kBlockSize == kDynamicBlockSize) {
+      if (format_.block_size == kDefaultBlockSize) {
+        return kDefaultBlockSize - offset % kDefaultBlockSize;
+      }
+    }
+
+    return BlockSize() - offset % BlockSize();
   }
 
   /// Encodes a data slice into one or more chunks, handling block alignment and
   /// padding.
   ///
-  /// This method takes a data slice and its chunk type, creates the necessary
-  /// chunk(s), and manages the `offset_` to reflect the new write position.
-  /// It also inserts padding if the current write would cross a block boundary
-  /// and the remaining space in the block is too small for a header.
+  /// This method takes the pieces of a chunk's payload and its chunk type,
+  /// creates the necessary chunk(s), and manages the `offset_` to reflect the
+  /// new write position. It also inserts padding if the current write would
+  /// cross a block boundary and the remaining space in the block is too small
+  /// for a header.
   ///
-  /// \param data The data slice to encode.
+  /// \param pieces The slices forming the chunk's payload, in order.
   /// \param type The type of the chunk.
   /// \return A `std::unique_ptr<kiwi::IOBuf>` representing the encoded
   ///         chunk(s), potentially including padding.
-  std::unique_ptr<kiwi::IOBuf> Encode(Slice data, ChunkType type) {
-    DCHECK_LE(data.size() + kChunkHeaderSize, AvailableSpaceInCurrentBlock());
+  std::unique_ptr<kiwi::IOBuf> Encode(kiwi::span<const Slice> pieces,
+                                      ChunkType type) {
+    auto chunk = EncodeDataToChunk(pieces, type);
+
+    DCHECK_LE(chunk->ComputeChainDataLength(), AvailableSpaceInCurrentBlock());
 
-    auto chunk = EncodeDataToChunk(data, type);
     offset_ += chunk->ComputeChainDataLength();
     auto sz = AvailableSpaceInCurrentBlock();
 
-    if (sz <= kChunkHeaderSize) {
+    if (sz <= MinChunkHeaderSize()) {
       auto padding = kiwi::IOBuf::Create(sz);
       padding->Append(sz);
       offset_ += sz;
@@ -237,31 +1286,144 @@ class Segment {
     return chunk;
   }
 
-  Chunk Decode(Offset offset) {
-    ChunkHeader header;
-    char buf[kChunkHeaderSize];
+  /// Reads the header of the chunk at `offset`.
+  ///
+  /// \param check Whether to crash if no header can be decoded, rather than
+  ///              returning one whose `size` is 0.
+  ChunkHeader DecodeHeader(Offset offset, bool check = true) const {
+    char buf[kMaxChunkHeaderSize];
+    auto len =
+        std::min(MaxChunkHeaderSize(), AvailableSpaceInBlockAt(offset));
+    auto nbytes = file_.Read(offset, buf, len);
+    auto header = ParseHeader(buf, std::max(nbytes, 0));
+
+    CHECK(!check || header.size != 0) << " at offset: " << offset;
+
+    return header;
+  }
+
+  /// Reads the payload of the chunk at `offset` described by `header` and
+  /// verifies it against the checksum of the chunk.
+  ///
+  /// \return `false` if the payload is cut short or does not match.
+  bool TryReadPayload(Offset offset, const ChunkHeader& header,
+                      char* out) const {
+    return file_.Read(offset + header.size, out, header.len) ==
+               static_cast<int>(header.len) &&
+           VerifyPayload(header, out);
+  }
+
+  /// Same as `TryReadPayload()`, asserting that the payload is intact.
+  void ReadPayload(Offset offset, const ChunkHeader& header, char* out) const {
+    CHECK(TryReadPayload(offset, header, out)) << " at offset: " << offset;
+  }
+
+  /// Parses a chunk header out of the `n` bytes at `buf`.
+  ChunkHeader ParseHeader(const char* buf, int64_t n) const {
+    ChunkHeader header{};
+    auto ptr = reinterpret_cast<const uint8_t*>(buf);
+
+    if (n < MinChunkHeaderSize()) {
+      return header;
+    }
+
+    header.crc32 = kiwi::LittleEndian::Uint32(ptr);
+
+    if (format_.version == kFormatV1) {
+      header.len = kiwi::LittleEndian::Uint16(ptr + kLenOffset);
+      header.type = static_cast<ChunkType>(ptr[kTypeOffset]);
+      header.size = kChunkHeaderSize;
+
+      return header;
+    }
+
+    uint32_t value = 0;
+    auto varint_len = DecodeVarint(ptr + sizeof(uint32_t),
+                                   n - sizeof(uint32_t), &value);
+
+    if (varint_len != 0) {
+      header.len = value >> kTypeBits;
+      header.type = static_cast<ChunkType>(value & ((1 << kTypeBits) - 1));
+      header.size = sizeof(uint32_t) + varint_len;
+    }
+
+    return header;
+  }
+
+  /// A contiguous range of the segment file loaded into memory by
+  /// `ReadBatch()`.
+  struct ReadWindow {
+    Offset begin = 0;
+    std::vector<char> data;
 
-    // Read the chunk header.
-    CHECK_EQ(kChunkHeaderSize, file_.Read(offset, buf, sizeof(buf)));
+    Offset End() const { return begin + data.size(); }
+  };
 
-    header.crc32 = kiwi::LittleEndian::Uint32(reinterpret_cast<uint8_t*>(buf));
-    header.len = kiwi::LittleEndian::Uint16(
-        reinterpret_cast<uint8_t*>(buf + kLenOffset));
-    header.type = static_cast<ChunkType>(*(buf + kTypeOffset));
+  /// Loads `[window.End(), end)` into `window`, so a record that continues
+  /// past the coalesced range can still be decoded from memory.
+  void ExtendWindow(ReadWindow& window, Offset end) const {
+    auto from = window.End();
+    auto size = window.data.size();
+    auto len = end - from;
 
-    CHECK_EQ(header.len,
-             file_.Read(offset + kChunkHeaderSize, buffer_.data(), header.len))
-        << " at offset: " << offset;
+    if (len <= 0) {
+      return;
+    }
 
-    auto data = kiwi::span(buffer_.data(), header.len);
+    window.data.resize(size + len);
+    CHECK_EQ(len, file_.Read(from, window.data.data() + size, len))
+        << " at offset: " << from;
+  }
 
-    return {header, data};
+  /// Decodes the record starting at `offset` from `window`, extending the
+  /// window if the record does not end within it.
+  std::string DecodeFromWindow(ReadWindow& window, Offset offset) const {
+    std::string data;
+
+    while (true) {
+      offset = GetAlignedReadOffset(offset);
+
+      if (offset + MaxChunkHeaderSize() > window.End()) {
+        ExtendWindow(window, std::min<Offset>(
+                                 offset + AvailableSpaceInBlockAt(offset),
+                                 offset_));
+      }
+
+      auto ptr = window.data.data() + (offset - window.begin);
+      ChunkHeader header = ParseHeader(ptr, window.End() - offset);
+
+      CHECK_NE(0, header.size) << " at offset: " << offset;
+
+      if (offset + header.size + header.len > window.End()) {
+        ExtendWindow(window, offset + header.size + header.len);
+        ptr = window.data.data() + (offset - window.begin);
+      }
+
+      CHECK(VerifyPayload(header, ptr + header.size))
+          << " at offset: " << offset;
+
+      data.append(ptr + header.size, header.len);
+      offset += header.size + header.len;
+
+      if (EndsRecord(header.type)) {
+        return data;
+      }
+    }
   }
 
-  std::array<char, kMaxBlockSize> buffer_;
-  kiwi::File file_;
+  mutable kiwi::File file_;
+  Format format_;
   Offset offset_ = 0;
+  bool read_only_ = false;
   bool is_closed_ = false;
+  bool is_corrupted_ = false;
 };
 
+/// The segment type of the WAL, reading segments of any block size and
+/// checksum.
+using Segment = BasicSegment<kDynamicBlockSize, DynamicChecksum>;
+
+/// The segment type of the default format, 32KB blocks protected by CRC32.
+using DefaultSegment = BasicSegment<>;
+
 }  // namespace rosekv
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "rosekv/wal/segment.hh"
+#include "rosekv/wal/segment_catalog.hh"
+
+namespace rosekv {
+
+/// An LRU-bounded cache of open handles to sealed segments.
+///
+/// Sealed segments are opened lazily on their first read and closed again once
+/// they fall out of the cache, which bounds the number of file descriptors the
+/// WAL holds regardless of how many segments are retained on disk. Handles are
+/// shared, so a segment evicted while a reader still uses it stays open until
+/// that reader releases it.
+class SegmentCache {
+ public:
+  using Key = SegmentId;
+
+  /// \param capacity The maximum number of segments kept open at once.
+  explicit SegmentCache(std::size_t capacity)
+      : capacity_{std::max<std::size_t>(capacity, 1)} {}
+
+  /// Looks up the segment identified by `key`, opening the file at `path`
+  /// on a miss and evicting the least recently used handle if the cache is
+  /// full.
+  ///
+  /// \param key The key identifying the segment.
+  /// \param path The path of the segment file, used only on a miss.
+  /// \return The segment handle, or `nullptr` if the file could not be opened.
+  std::shared_ptr<Segment> Get(const Key& key, const kiwi::FilePath& path) {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+
+    if (auto it = index_.find(key); it != index_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+
+      return it->second->second;
+    }
+
+    // Sealed segments are never written again, and a missing one must not
+    // be recreated empty by a read.
+    auto segment =
+        std::make_shared<Segment>(path, Segment::OpenMode::kReadOnly);
+
+    if (!segment->IsValid()) {
+      LOG(ERROR) << "Failed to open segment: " << path << ": "
+                 << segment->GetErrorDetail();
+
+      return nullptr;
+    }
+
+    InsertLocked(key, segment);
+
+    return segment;
+  }
+
+  /// Inserts an already opened segment, e.g. the active segment once it has
+  /// been sealed, so that it does not need to be reopened on the next read.
+  void Put(const Key& key, std::shared_ptr<Segment> segment) {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+
+    if (auto it = index_.find(key); it != index_.end()) {
+      lru_.erase(it->second);
+      index_.erase(it);
+    }
+
+    InsertLocked(key, std::move(segment));
+  }
+
+  /// Drops the handle identified by `key`, if it is cached.
+  ///
+  /// \return The dropped handle, so the caller decides where the file gets
+  ///         closed, or `nullptr` if it was not cached.
+  std::shared_ptr<Segment> Erase(const Key& key) {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+
+    auto it = index_.find(key);
+
+    if (it == index_.end()) {
+      return nullptr;
+    }
+
+    auto segment = std::move(it->second->second);
+    lru_.erase(it->second);
+    index_.erase(it);
+
+    return segment;
+  }
+
+  /// \return The number of segments currently held open by the cache.
+  std::size_t Size() const {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+
+    return lru_.size();
+  }
+
+  /// \return The maximum number of segments kept open at once.
+  constexpr std::size_t Capacity() const { return capacity_; }
+
+ private:
+  using Entry = std::pair<Key, std::shared_ptr<Segment>>;
+
+  void InsertLocked(const Key& key, std::shared_ptr<Segment> segment) {
+    lru_.emplace_front(key, std::move(segment));
+    index_.emplace(key, lru_.begin());
+
+    while (lru_.size() > capacity_) {
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+    }
+  }
+
+  const std::size_t capacity_;
+  mutable std::mutex mtx_;
+
+  /// Most recently used handles are kept at the front.
+  std::list<Entry> lru_;
+  std::unordered_map<Key, std::list<Entry>::iterator> index_;
+};
+
+}  // namespace rosekv
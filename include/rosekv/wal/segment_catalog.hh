@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "rosekv/wal/lsn.hh"
+#include "rosekv/wal/options.hh"
+#include "rosekv/wal/segment.hh"
+
+namespace rosekv {
+
+/// The ordered set of segment files making up the log.
+///
+/// Segments are identified by a numeric id rather than by their basename, so
+/// ordering does not depend on how file names compare as strings. Ids are
+/// required to be contiguous, which lets the catalog map an LSN to its
+/// segment with a single index computation instead of a tree lookup.
+class SegmentCatalog {
+ public:
+  struct Entry {
+    SegmentId id;
+    kiwi::FilePath path;
+  };
+
+  /// The number of decimal digits in a segment file name, enough to hold any
+  /// 64-bit id so that names also sort numerically in directory listings.
+  static constexpr int kSegmentIdWidth = 20;
+
+  /// \return The file name of the segment with the given id, e.g.
+  ///         "00000000000000000001.seg".
+  static std::string SegmentFileName(SegmentId id) {
+    char buf[kSegmentIdWidth + 1];
+    std::snprintf(buf, sizeof(buf), "%020llu",
+                  static_cast<unsigned long long>(id));
+
+    return buf + std::string(kDefSegFileExtension);
+  }
+
+  /// Parses the segment id out of a segment file name. Names without zero
+  /// padding (e.g. "9.seg") are accepted as well.
+  ///
+  /// \return The segment id, or `std::nullopt` if `basename` is not a valid
+  ///         segment file name.
+  static std::optional<SegmentId> ParseSegmentFileName(
+      std::string_view basename) {
+    std::string_view ext = kDefSegFileExtension;
+
+    if (basename.size() <= ext.size() || !basename.ends_with(ext)) {
+      return std::nullopt;
+    }
+
+    auto stem = basename.substr(0, basename.size() - ext.size());
+    SegmentId id = 0;
+    auto end = stem.data() + stem.size();
+    auto [ptr, ec] = std::from_chars(stem.data(), end, id);
+
+    if (ec != std::errc{} || ptr != end) {
+      return std::nullopt;
+    }
+
+    return id;
+  }
+
+  /// Adds a segment found on disk. Segments may be added in any order; call
+  /// `Seal()` once all of them are known.
+  void Add(SegmentId id, kiwi::FilePath path) {
+    pending_.push_back({id, std::move(path)});
+  }
+
+  /// Sorts the segments added through `Add()` by id.
+  ///
+  /// \return `false` if the ids are not contiguous, in which case the catalog
+  ///         is left empty.
+  bool Seal() {
+    std::sort(pending_.begin(), pending_.end(),
+              [](const auto& a, const auto& b) { return a.id < b.id; });
+
+    for (std::size_t i = 1; i < pending_.size(); ++i) {
+      if (pending_[i].id != pending_[i - 1].id + 1) {
+        LOG(ERROR) << "Missing segment(s) between id: " << pending_[i - 1].id
+                   << " and id: " << pending_[i].id;
+        pending_.clear();
+
+        return false;
+      }
+    }
+
+    entries_ = std::move(pending_);
+    pending_.clear();
+
+    return true;
+  }
+
+  /// Appends a newly created segment, which must directly follow the last one.
+  void PushBack(SegmentId id, kiwi::FilePath path) {
+    DCHECK(entries_.empty() || id == LastId() + 1);
+
+    entries_.push_back({id, std::move(path)});
+  }
+
+  /// Removes and returns the oldest segment.
+  ///
+  /// \pre The catalog is not empty.
+  Entry PopFront() {
+    auto entry = std::move(entries_.front());
+    entries_.pop_front();
+
+    return entry;
+  }
+
+  /// Removes and returns the newest segment.
+  ///
+  /// \pre The catalog is not empty.
+  Entry PopBack() {
+    auto entry = std::move(entries_.back());
+    entries_.pop_back();
+
+    return entry;
+  }
+
+  /// \return The segment with the given id, or `nullptr` if it is not part of
+  ///         the catalog. Runs in constant time.
+  const Entry* Find(SegmentId id) const {
+    if (entries_.empty() || id < FirstId() || id > LastId()) {
+      return nullptr;
+    }
+
+    return &entries_[id - FirstId()];
+  }
+
+  /// \return The segment holding the record at `lsn`, or `nullptr`.
+  const Entry* Find(LSN lsn) const { return Find(lsn.GetSegmentId()); }
+
+  bool Empty() const { return entries_.empty(); }
+  std::size_t Size() const { return entries_.size(); }
+
+  /// \pre The catalog is not empty.
+  SegmentId FirstId() const { return entries_.front().id; }
+
+  /// \pre The catalog is not empty.
+  SegmentId LastId() const { return entries_.back().id; }
+
+ private:
+  std::deque<Entry> pending_;
+  std::deque<Entry> entries_;
+};
+
+}  // namespace rosekv
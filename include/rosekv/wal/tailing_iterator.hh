@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include "rosekv/wal/lsn.hh"
+
+namespace rosekv {
+
+class WAL;
+
+/// Follows the WAL as it grows, delivering every record from a starting LSN
+/// onwards in write order.
+///
+/// Recently written records are handed over straight from an in-memory tail
+/// kept by the WAL while subscribers exist, so a subscriber that keeps up
+/// never touches the segment files. One that falls behind the tail reads
+/// from the files until it catches up again.
+///
+/// \note A `TailingIterator` must not outlive the `WAL` it was created from.
+///       Records discarded by `WAL::TruncateAfter()` or `TruncateFrom()` that
+///       were already delivered are not retracted.
+class TailingIterator {
+ public:
+  TailingIterator(WAL* wal, LSN from_lsn);
+  ~TailingIterator();
+
+  TailingIterator(const TailingIterator&) = delete;
+  TailingIterator& operator=(const TailingIterator&) = delete;
+
+  /// Advances to the next record, blocking until one is written.
+  ///
+  /// \param ec Set if the next record can no longer be read, e.g. because
+  ///           its segment was dropped by `WAL::TruncateBefore()`.
+  /// \return `true` if the iterator now points at a record, `false` on error
+  ///         or once the WAL is being destroyed.
+  bool Next(std::error_code& ec);
+
+  /// Like `Next(ec)`, but gives up after waiting for `timeout`.
+  ///
+  /// \return `false` as well if no record was written within `timeout`.
+  bool Next(std::chrono::milliseconds timeout, std::error_code& ec);
+
+  /// \return The LSN of the current record.
+  LSN GetLSN() const { return lsn_; }
+
+  /// \return The data of the current record.
+  const std::string& GetData() const { return *data_; }
+
+  /// \return The LSN at which the next record is expected, e.g. where a
+  ///         record that failed to read starts.
+  LSN GetNextLSN() const { return next_lsn_; }
+
+ private:
+  bool Next(const std::chrono::steady_clock::time_point* deadline,
+            std::error_code& ec);
+
+  WAL* wal_;
+
+  /// The LSN at which the next record is expected. It may point at the end
+  /// of a sealed segment, in which case the record lives in the next one.
+  LSN next_lsn_;
+
+  LSN lsn_;
+  std::shared_ptr<const std::string> data_;
+};
+
+}  // namespace rosekv
@@ -1,14 +1,20 @@
 #pragma once
 
 #include <condition_variable>
+#include <deque>
 #include <kiwi/common/error_or.hh>
-#include <map>
 #include <mutex>
 #include <shared_mutex>
+#include <thread>
+#include <vector>
 
 #include "rosekv/wal/error_code.hh"
+#include "rosekv/wal/lsn.hh"
 #include "rosekv/wal/options.hh"
 #include "rosekv/wal/segment.hh"
+#include "rosekv/wal/segment_cache.hh"
+#include "rosekv/wal/segment_catalog.hh"
+#include "rosekv/wal/tailing_iterator.hh"
 
 namespace rosekv {
 
@@ -29,25 +35,195 @@ class WAL {
  public:
   explicit WAL(const Options& options);
 
+  /// Waits for pending segment reclamation to finish.
+  ~WAL();
+
   /// Synchronize the data to the disk.
   void Sync();
 
-  void Write(Slice data, std::error_code& ec);
+  /// Appends a record to the active segment. A record that does not fit in
+  /// the rest of the segment continues in as many new segments as needed.
+  ///
+  /// \param data The record to append.
+  /// \param ec Set if the WAL failed to open.
+  /// \return The LSN of the record, or an invalid LSN on error.
+  LSN Write(Slice data, std::error_code& ec);
+
+  /// Appends a record made up of several slices, e.g. a header, a key and a
+  /// value, without concatenating them first.
+  ///
+  /// \param slices The slices forming the record, in order.
+  /// \param ec Set if the WAL failed to open.
+  /// \return The LSN of the record, or an invalid LSN on error.
+  LSN WriteV(kiwi::span<const Slice> slices, std::error_code& ec);
+
+  /// Reads the record at `lsn`.
+  ///
+  /// Sealed segments are opened on demand through an LRU-bounded cache, so
+  /// only the active segment is guaranteed to hold an open file descriptor.
+  ///
+  /// \param lsn The LSN of the record, as returned by `Write()`.
+  /// \param ec Set if the segment does not exist, cannot be opened, or does
+  ///           not contain the offset, or if the record is torn or does not
+  ///           match its checksum.
+  /// \return The record data, or an empty string on error.
+  std::string Read(LSN lsn, std::error_code& ec);
+
+  /// Drops all segments that only hold records before `lsn`.
+  ///
+  /// Obsolete segments are removed from the catalog right away, so they can
+  /// no longer be read, while their files are closed and deleted by a
+  /// background thread. The active segment is never dropped.
+  ///
+  /// \param lsn The oldest LSN that must remain readable, typically the one
+  ///            covered by the latest checkpoint.
+  /// \return The number of segments scheduled for deletion.
+  std::size_t TruncateBefore(LSN lsn);
+
+  /// Seals the active segment and starts a new one, so that the records
+  /// written so far can later be dropped by `TruncateBefore()` without
+  /// touching any record written afterwards, e.g. once they are persisted
+  /// elsewhere.
+  ///
+  /// \param ec Set if the WAL failed to open.
+  /// \return The start of the new segment, which every later record is at
+  ///         or after, or an invalid LSN on error.
+  LSN SwitchSegment(std::error_code& ec);
+
+  /// Discards all records written after the one at `lsn`, e.g. to drop the
+  /// uncommitted suffix of a consensus log after a leader change.
+  ///
+  /// The segment where that record ends is cut right after it and becomes the
+  /// active segment again; later segments are deleted. Subsequent writes
+  /// continue from the cut, and no segment is rewritten.
+  ///
+  /// \param lsn The LSN of the last record to keep.
+  /// \param ec Set if `lsn` is not the start of a record in the log.
+  void TruncateAfter(LSN lsn, std::error_code& ec);
+
+  /// Discards the record at `lsn` and all records written after it, e.g. to
+  /// drop a torn or corrupted tail found while replaying the log.
+  ///
+  /// Like `TruncateAfter()`, the segment of `lsn` is cut there and becomes
+  /// the active segment again; later segments are deleted.
+  ///
+  /// \param lsn The LSN of the first record to discard, which may be the end
+  ///            of its segment.
+  /// \param ec Set if the segment of `lsn` does not exist or does not extend
+  ///           to its offset.
+  void TruncateFrom(LSN lsn, std::error_code& ec);
+
+  /// Subscribes to the records written from `from_lsn` onwards.
+  ///
+  /// The returned iterator blocks until new records are written and hands
+  /// recent ones over from memory, so consumers see a write as soon as
+  /// `Write()` returns instead of polling the segment files.
+  ///
+  /// \param from_lsn The LSN of the first record to deliver, or an invalid
+  ///                 LSN to start from the oldest record.
+  std::unique_ptr<TailingIterator> Subscribe(LSN from_lsn = {});
+
+  /// Reads raw segment bytes starting at `lsn` without decoding them, e.g. to
+  /// ship whole blocks to a replica.
+  ///
+  /// \param lsn The position to read from, not necessarily a record start.
+  /// \param buf The buffer to fill.
+  /// \param ec Set if the segment does not exist or cannot be read.
+  /// \return The number of bytes read, which is 0 at the end of the segment.
+  int64_t ReadRaw(LSN lsn, kiwi::span<char> buf, std::error_code& ec);
+
+  /// Gets the block size of a segment, e.g. to ship it to a replica one block
+  /// per frame. Segments keep the block size they were created with.
+  ///
+  /// \param id The id of the segment.
+  /// \param ec Set if the segment does not exist or cannot be read.
+  /// \return The block size of the segment, or 0 on error.
+  int64_t GetBlockSize(SegmentId id, std::error_code& ec);
+
+  /// \return The position of the oldest record in the log.
+  LSN GetBeginLSN();
+
+  /// \return The position at which the next record will be written.
+  LSN GetEndLSN();
+
+  /// Blocks until the log grows past `lsn`, at most for `timeout`.
+  ///
+  /// \return `true` if the log ends after `lsn`, `false` on timeout or once
+  ///         the WAL is being destroyed.
+  bool WaitForWrite(LSN lsn, std::chrono::milliseconds timeout);
+
+  /// \return The error encountered while opening the WAL, if any. A WAL that
+  ///         failed to open rejects all writes with this error.
+  std::error_code Status() const { return status_; }
 
  private:
+  friend class TailingIterator;
+
+  /// A recently written record kept in memory for subscribers.
+  struct TailRecord {
+    LSN lsn;
+    LSN next_lsn;
+    std::shared_ptr<const std::string> data;
+  };
+
+  /// Reads the record at or right after `lsn`, e.g. the first record of a
+  /// segment for an LSN with offset 0.
+  ///
+  /// \param record_lsn If not null, receives the LSN of the record read.
+  /// \param next_lsn If not null, receives the LSN of the following record.
+  std::string ReadRecord(LSN lsn, LSN* record_lsn, LSN* next_lsn,
+                         std::error_code& ec);
+  std::shared_ptr<Segment> GetSegmentLocked(LSN lsn, std::error_code& ec);
+  /// Cuts segment `id`, whose handle is `seg`, at `end` and makes it the
+  /// active segment, deleting the segments after it.
+  void CutLocked(SegmentId id, std::shared_ptr<Segment> seg,
+                 Segment::Offset end, std::error_code& ec);
+  void AppendToTail(LSN lsn, kiwi::span<const Slice> slices);
   Segment* GetActiveSegment() const;
+  /// \return The format of newly created segments.
+  Segment::Format GetSegmentFormat() const;
   Segment* NewSegment();
   void UpdateIOStat(std::size_t nbytes);
   bool NeedSync() const;
   void StartSyncThread();
+  void ReclaimSegments();
 
   Options options_;
-  std::map<std::string, std::unique_ptr<Segment>> segments_;
-  IOStats io_stats_;
+  /// All segments on disk, ordered by id. Only the active (last) segment is
+  /// opened eagerly; sealed ones go through `segment_cache_`.
+  SegmentCatalog segments_;
+  std::shared_ptr<Segment> active_segment_;
+  SegmentCache segment_cache_;
+  IOStats io_stats_{};
   kiwi::File::Error error_;
+  std::error_code status_;
 
   std::shared_mutex wal_rw_mtx_;
-  int next_segment_id_;
+  SegmentId next_segment_id_ = 1;
+
+  /// Segments dropped by `TruncateBefore()` waiting to be deleted, oldest
+  /// first. The handle, if the segment was open, is released on the reclaim
+  /// thread too so that closing the file never happens under `wal_rw_mtx_`.
+  struct ObsoleteSegment {
+    kiwi::FilePath path;
+    std::shared_ptr<Segment> segment;
+  };
+
+  bool stop_reclaim_thread_ = false;
+  std::vector<ObsoleteSegment> obsolete_segments_;
+  std::mutex reclaim_mtx_;
+  std::condition_variable reclaim_cv_;
+  std::thread reclaim_thread_;
+
+  /// Subscribers wait on `tail_cv_` for `end_lsn_` to move. `tail_mtx_` is
+  /// always acquired after `wal_rw_mtx_` if both are needed.
+  std::mutex tail_mtx_;
+  std::condition_variable tail_cv_;
+  LSN end_lsn_;
+  int num_subscribers_ = 0;
+  bool closing_ = false;
+  std::deque<TailRecord> tail_records_;
+  std::size_t tail_bytes_ = 0;
 
   bool stop_sync_thread_;
   std::mutex sync_mtx_;
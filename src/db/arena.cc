@@ -0,0 +1,157 @@
+#include "rosekv/db/arena.hh"
+
+#include <glog/logging.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace rosekv {
+
+namespace {
+
+constexpr std::size_t kHugePageSize = 2 * 1024 * 1024;
+
+/// \return The number of bytes needed to align `ptr` to `Arena::kAlignUnit`.
+std::size_t AlignmentSlop(const char* ptr) {
+  auto mod = reinterpret_cast<uintptr_t>(ptr) & (Arena::kAlignUnit - 1);
+
+  return mod == 0 ? 0 : Arena::kAlignUnit - mod;
+}
+
+}  // namespace
+
+Arena::Arena(std::size_t block_size, bool huge_pages)
+    : block_size_{std::max(block_size, kAlignUnit)}, huge_pages_{huge_pages} {}
+
+Arena::~Arena() {
+  for (const auto& block : blocks_) {
+    if (block.mapped) {
+      ::munmap(block.data, block.size);
+    } else {
+      delete[] block.data;
+    }
+  }
+}
+
+char* Arena::AllocateAligned(std::size_t bytes) {
+  auto slop = AlignmentSlop(alloc_ptr_);
+
+  if (bytes + slop <= alloc_bytes_remaining_) {
+    auto result = alloc_ptr_ + slop;
+    alloc_ptr_ += bytes + slop;
+    alloc_bytes_remaining_ -= bytes + slop;
+
+    return result;
+  }
+
+  // New blocks are always aligned.
+  return AllocateFallback(bytes);
+}
+
+char* Arena::AllocateFallback(std::size_t bytes) {
+  // Large allocations get a block of their own, so as not to waste the rest
+  // of the current one.
+  if (bytes > block_size_ / 4) {
+    return AllocateNewBlock(bytes);
+  }
+
+  alloc_ptr_ = AllocateNewBlock(block_size_);
+  alloc_bytes_remaining_ = block_size_;
+
+  auto result = alloc_ptr_;
+  alloc_ptr_ += bytes;
+  alloc_bytes_remaining_ -= bytes;
+
+  return result;
+}
+
+char* Arena::AllocateNewBlock(std::size_t block_bytes) {
+  Block block{nullptr, block_bytes, false};
+
+#if defined(MAP_HUGETLB)
+  if (huge_pages_ && block_bytes >= kHugePageSize) {
+    auto size = (block_bytes + kHugePageSize - 1) / kHugePageSize *
+                kHugePageSize;
+    auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if (ptr != MAP_FAILED) {
+      block = {static_cast<char*>(ptr), size, true};
+    } else {
+      LOG_FIRST_N(WARNING, 1)
+          << "Failed to map huge pages for the arena, use regular pages";
+    }
+  }
+#endif
+
+  if (block.data == nullptr) {
+    block.data = new char[block_bytes];
+  }
+
+  blocks_.push_back(block);
+  memory_usage_.fetch_add(block.size + sizeof(Block),
+                          std::memory_order_relaxed);
+
+  return block.data;
+}
+
+ConcurrentArena::ConcurrentArena(std::size_t block_size, bool huge_pages)
+    : arena_{block_size, huge_pages},
+      // Shards refill with small slices, so that an idle shard holds little.
+      shard_block_size_{std::clamp<std::size_t>(block_size / 8, 4096, 131072)} {
+  auto num_shards =
+      std::bit_ceil(std::max(1u, std::thread::hardware_concurrency()));
+
+  shard_mask_ = num_shards - 1;
+  shards_ = std::make_unique<Shard[]>(num_shards);
+}
+
+char* ConcurrentArena::AllocateImpl(std::size_t bytes, bool aligned) {
+  if (bytes > shard_block_size_ / 4) {
+    std::lock_guard<std::mutex> lk_guard{arena_mtx_};
+
+    return aligned ? arena_.AllocateAligned(bytes) : arena_.Allocate(bytes);
+  }
+
+  auto shard = CurrentShard();
+  std::lock_guard<std::mutex> lk_guard{shard->mtx};
+  auto slop = aligned ? AlignmentSlop(shard->free_begin) : 0;
+
+  if (bytes + slop > shard->allocated_and_unused) {
+    // The rest of the shard's slice is wasted, which is at most a quarter of
+    // a slice.
+    std::lock_guard<std::mutex> arena_lk_guard{arena_mtx_};
+
+    shard->free_begin = arena_.AllocateAligned(shard_block_size_);
+    shard->allocated_and_unused = shard_block_size_;
+    slop = 0;
+  }
+
+  auto result = shard->free_begin + slop;
+  shard->free_begin += bytes + slop;
+  shard->allocated_and_unused -= bytes + slop;
+
+  return result;
+}
+
+ConcurrentArena::Shard* ConcurrentArena::CurrentShard() {
+#if defined(__linux__)
+  if (auto cpu = ::sched_getcpu(); cpu >= 0) {
+    return &shards_[cpu & shard_mask_];
+  }
+#endif
+
+  thread_local auto index = std::hash<std::thread::id>{}(
+      std::this_thread::get_id());
+
+  return &shards_[index & shard_mask_];
+}
+
+}  // namespace rosekv
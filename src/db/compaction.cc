@@ -0,0 +1,102 @@
+#include "rosekv/db/compaction.hh"
+
+#include <algorithm>
+
+namespace rosekv {
+
+Compaction::Compaction(std::shared_ptr<const Version> input_version,
+                       std::vector<CompactionInputs> inputs, int output_level,
+                       double score, uint64_t max_output_file_size)
+    : input_version_{std::move(input_version)},
+      inputs_{std::move(inputs)},
+      output_level_{output_level},
+      score_{score},
+      max_output_file_size_{max_output_file_size} {
+  if (output_level_ != 0) {
+    return;
+  }
+
+  // Level 0 is ordered by sequence number, so the files that are not inputs
+  // and hold no sequence number as large as the inputs are older.
+  SequenceNumber largest_sequence = 0;
+
+  for (const auto& input : inputs_) {
+    for (const auto& file : input.files) {
+      largest_sequence = std::max(largest_sequence, file->largest_sequence);
+    }
+  }
+
+  for (const auto& file : input_version_->GetFiles(0)) {
+    if (file->largest_sequence < largest_sequence &&
+        std::none_of(inputs_.begin(), inputs_.end(), [&](const auto& input) {
+          return std::find(input.files.begin(), input.files.end(), file) !=
+                 input.files.end();
+        })) {
+      older_level0_files_.push_back(file);
+    }
+  }
+}
+
+std::size_t Compaction::NumInputFiles() const {
+  std::size_t count = 0;
+
+  for (const auto& input : inputs_) {
+    count += input.files.size();
+  }
+
+  return count;
+}
+
+uint64_t Compaction::TotalInputBytes() const {
+  uint64_t bytes = 0;
+
+  for (const auto& input : inputs_) {
+    for (const auto& file : input.files) {
+      bytes += file->file_size;
+    }
+  }
+
+  return bytes;
+}
+
+void Compaction::MarkFilesBeingCompacted(bool being_compacted) const {
+  for (const auto& input : inputs_) {
+    for (const auto& file : input.files) {
+      file->being_compacted = being_compacted;
+    }
+  }
+}
+
+void Compaction::AddInputDeletions(VersionEdit* edit) const {
+  for (const auto& input : inputs_) {
+    for (const auto& file : input.files) {
+      edit->DeleteFile(input.level, file->number);
+    }
+  }
+}
+
+bool Compaction::IsBaseLevelForKey(std::string_view user_key) const {
+  for (const auto& file : older_level0_files_) {
+    if (user_key >= ExtractUserKey(file->smallest) &&
+        user_key <= ExtractUserKey(file->largest)) {
+      return false;
+    }
+  }
+
+  for (int level = output_level_ + 1; level < input_version_->NumLevels();
+       ++level) {
+    const auto& files = input_version_->GetFiles(level);
+    auto it = std::partition_point(
+        files.begin(), files.end(), [&](const auto& file) {
+          return ExtractUserKey(file->largest) < user_key;
+        });
+
+    if (it != files.end() && user_key >= ExtractUserKey((*it)->smallest)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace rosekv
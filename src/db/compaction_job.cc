@@ -0,0 +1,303 @@
+#include "rosekv/db/compaction_job.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <kiwi/io/file_util.hh>
+#include <mutex>
+#include <string>
+
+#include "rosekv/db/error_code.hh"
+#include "rosekv/db/filename.hh"
+#include "rosekv/db/merging_iterator.hh"
+
+namespace rosekv {
+
+CompactionJob::CompactionJob(const DBOptions& options,
+                             const kiwi::FilePath& db_path,
+                             Compaction* compaction,
+                             std::function<uint64_t()> new_file_number,
+                             const std::atomic<bool>* shutting_down,
+                             ThreadPool* pool)
+    : options_{options},
+      db_path_{db_path},
+      compaction_{compaction},
+      new_file_number_{std::move(new_file_number)},
+      shutting_down_{shutting_down},
+      pool_{pool} {}
+
+void CompactionJob::Run(std::error_code& ec) {
+  auto start = std::chrono::steady_clock::now();
+
+  stats_.num_input_files = compaction_->NumInputFiles();
+  stats_.bytes_read = compaction_->TotalInputBytes();
+
+  GenSubcompactions();
+  stats_.num_subcompactions = subcompactions_.size();
+
+  if (subcompactions_.size() > 1 && pool_ != nullptr) {
+    RunSubcompactions();
+  } else {
+    for (auto& sub : subcompactions_) {
+      ProcessKeyValues(&sub);
+    }
+  }
+
+  for (const auto& sub : subcompactions_) {
+    if (sub.status) {
+      ec = sub.status;
+      break;
+    }
+  }
+
+  if (ec) {
+    for (auto& sub : subcompactions_) {
+      DeleteOutputs(&sub);
+    }
+
+    return;
+  }
+
+  for (const auto& sub : subcompactions_) {
+    stats_.num_output_files += sub.outputs.size();
+    stats_.bytes_written += sub.stats.bytes_written;
+    stats_.num_input_records += sub.stats.num_input_records;
+    stats_.num_dropped_records += sub.stats.num_dropped_records;
+  }
+
+  stats_.micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
+
+void CompactionJob::AddToEdit(VersionEdit* edit) const {
+  compaction_->AddInputDeletions(edit);
+
+  for (const auto& sub : subcompactions_) {
+    for (const auto& file : sub.outputs) {
+      edit->AddFile(compaction_->output_level(), file);
+    }
+  }
+}
+
+void CompactionJob::GenSubcompactions() {
+  auto total_bytes = compaction_->TotalInputBytes();
+  auto max_subcompactions = std::min<uint64_t>(
+      std::max(1, options_.max_subcompactions),
+      total_bytes / std::max<uint64_t>(options_.target_file_size, 1));
+
+  subcompactions_.emplace_back();
+
+  // A run written to level 0 must be a single file.
+  if (max_subcompactions <= 1 || compaction_->output_level() == 0) {
+    return;
+  }
+
+  // The boundaries of the input files are the candidate split points, and
+  // the index of each input tells how many of its bytes come before them.
+  std::vector<std::string> keys;
+
+  for (const auto& input : compaction_->inputs()) {
+    for (const auto& file : input.files) {
+      keys.emplace_back(ExtractUserKey(file->smallest));
+      keys.emplace_back(ExtractUserKey(file->largest));
+    }
+  }
+
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  auto bytes_before = [this](std::string_view user_key) {
+    std::string target;
+    AppendInternalKey(&target, user_key, kMaxSequenceNumber,
+                      kValueTypeForSeek);
+    uint64_t bytes = 0;
+
+    for (const auto& input : compaction_->inputs()) {
+      for (const auto& file : input.files) {
+        bytes += file->table->ApproximateOffsetOf(target);
+      }
+    }
+
+    return bytes;
+  };
+
+  auto bytes_per_subcompaction = bytes_before(keys.back()) / max_subcompactions;
+
+  for (std::size_t i = 1; i + 1 < keys.size() &&
+                          subcompactions_.size() < max_subcompactions;
+       ++i) {
+    if (bytes_before(keys[i]) >=
+        bytes_per_subcompaction * subcompactions_.size()) {
+      subcompactions_.back().end = keys[i];
+      subcompactions_.emplace_back().start = keys[i];
+    }
+  }
+}
+
+void CompactionJob::RunSubcompactions() {
+  struct State {
+    std::size_t num_subcompactions;
+    std::atomic<std::size_t> next{0};
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::size_t num_done = 0;
+  };
+
+  auto state = std::make_shared<State>();
+  state->num_subcompactions = subcompactions_.size();
+
+  // Whichever thread comes first takes the next subcompaction. The calling
+  // thread takes its share too and never waits for a subcompaction nobody
+  // started, so the job completes even if the pool has no idle thread, and
+  // the tasks starting after the job only find nothing left to take.
+  auto work = [this, state] {
+    std::size_t num_done = 0;
+
+    for (auto i = state->next++; i < state->num_subcompactions;
+         i = state->next++) {
+      ProcessKeyValues(&subcompactions_[i]);
+      ++num_done;
+    }
+
+    if (num_done != 0) {
+      std::lock_guard<std::mutex> lk_guard{state->mtx};
+      state->num_done += num_done;
+      state->cv.notify_all();
+    }
+  };
+
+  for (std::size_t i = 1; i < subcompactions_.size(); ++i) {
+    pool_->Schedule(work);
+  }
+
+  work();
+
+  std::unique_lock<std::mutex> lk_guard{state->mtx};
+  state->cv.wait(lk_guard, [&] {
+    return state->num_done == state->num_subcompactions;
+  });
+}
+
+void CompactionJob::ProcessKeyValues(Subcompaction* sub) {
+  std::vector<std::unique_ptr<Table::Iterator>> children;
+
+  for (const auto& input : compaction_->inputs()) {
+    for (const auto& file : input.files) {
+      children.push_back(file->table->NewIterator());
+    }
+  }
+
+  MergingIterator iter{std::move(children)};
+  std::string current_user_key;
+  bool has_current_user_key = false;
+  auto& ec = sub->status;
+
+  if (sub->start.has_value()) {
+    std::string target;
+    AppendInternalKey(&target, *sub->start, kMaxSequenceNumber,
+                      kValueTypeForSeek);
+    iter.Seek(target);
+  } else {
+    iter.SeekToFirst();
+  }
+
+  for (; iter.Valid(); iter.Next()) {
+    if (shutting_down_->load(std::memory_order_relaxed)) {
+      ec = std::make_error_code(std::errc::operation_canceled);
+      break;
+    }
+
+    ParsedInternalKey ikey;
+
+    if (!ParseInternalKey(iter.key(), &ikey)) {
+      LOG(ERROR) << "Corrupted key in a compaction input";
+      ec = make_error_code(DBError::kCorruption);
+      break;
+    }
+
+    if (sub->end.has_value() && ikey.user_key >= *sub->end) {
+      break;
+    }
+
+    ++sub->stats.num_input_records;
+
+    // Versions of a key come newest first, and nothing reads older ones.
+    if (has_current_user_key && ikey.user_key == current_user_key) {
+      ++sub->stats.num_dropped_records;
+      continue;
+    }
+
+    current_user_key.assign(ikey.user_key);
+    has_current_user_key = true;
+
+    if (ikey.type == ValueType::kDeletion &&
+        compaction_->IsBaseLevelForKey(ikey.user_key)) {
+      ++sub->stats.num_dropped_records;
+      continue;
+    }
+
+    if (sub->builder == nullptr) {
+      OpenOutput(sub);
+    }
+
+    sub->builder->Add(iter.key(), iter.value());
+
+    if (sub->builder->FileSize() >= compaction_->max_output_file_size()) {
+      if (FinishOutput(sub, ec); ec) {
+        break;
+      }
+    }
+  }
+
+  if (!ec) {
+    ec = iter.Status();
+  }
+
+  if (!ec && sub->builder != nullptr) {
+    FinishOutput(sub, ec);
+  }
+}
+
+void CompactionJob::OpenOutput(Subcompaction* sub) {
+  sub->output_number = new_file_number_();
+  sub->pending_outputs.push_back(sub->output_number);
+
+  // Until the edit is applied, the output is not in the MANIFEST, so
+  // recovery deletes it if the compaction is interrupted. Errors creating
+  // it are reported by `Finish()`.
+  sub->builder = std::make_unique<TableBuilder>(
+      options_.table, db_path_.Append(TableFileName(sub->output_number)));
+}
+
+void CompactionJob::FinishOutput(Subcompaction* sub, std::error_code& ec) {
+  sub->builder->Finish(ec);
+  sub->builder.reset();
+
+  if (ec) {
+    return;
+  }
+
+  auto path = db_path_.Append(TableFileName(sub->output_number));
+  auto table = std::make_shared<Table>(path, options_.table);
+
+  if ((ec = table->Status())) {
+    return;
+  }
+
+  sub->stats.bytes_written += table->FileSize();
+  sub->outputs.push_back(NewFileMetaData(sub->output_number, std::move(table)));
+}
+
+void CompactionJob::DeleteOutputs(Subcompaction* sub) {
+  sub->builder.reset();
+  sub->outputs.clear();
+
+  for (auto number : sub->pending_outputs) {
+    kiwi::DeleteFile(db_path_.Append(TableFileName(number)));
+  }
+}
+
+}  // namespace rosekv
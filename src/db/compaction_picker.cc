@@ -0,0 +1,364 @@
+#include "rosekv/db/compaction_picker.hh"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rosekv {
+
+namespace {
+
+bool AnyBeingCompacted(
+    const std::vector<std::shared_ptr<FileMetaData>>& files) {
+  return std::any_of(files.begin(), files.end(),
+                     [](const auto& file) { return file->being_compacted; });
+}
+
+class LeveledCompactionPicker : public CompactionPicker {
+ public:
+  explicit LeveledCompactionPicker(const DBOptions& options)
+      : options_{options}, compact_pointers_(std::max(1, options.num_levels)) {}
+
+  std::unique_ptr<Compaction> PickCompaction(
+      std::shared_ptr<const Version> version) override {
+    std::vector<std::pair<double, int>> scores;
+
+    // The last level has nowhere to go.
+    for (int level = 0; level + 1 < version->NumLevels(); ++level) {
+      auto score = ComputeScore(*version, level);
+
+      if (score >= 1) {
+        scores.emplace_back(score, level);
+      }
+    }
+
+    // Levels furthest over their target go first, but a level whose files
+    // are all busy yields to the next one.
+    std::sort(scores.rbegin(), scores.rend());
+
+    for (auto [score, level] : scores) {
+      auto compaction = level == 0 ? PickLevel0(version, score)
+                                   : PickLevel(version, level, score);
+
+      if (compaction != nullptr) {
+        compaction->MarkFilesBeingCompacted(true);
+        return compaction;
+      }
+    }
+
+    return nullptr;
+  }
+
+ private:
+  /// Files already being compacted do not count, so that a level is not
+  /// picked again for work that is under way.
+  double ComputeScore(const Version& version, int level) const {
+    const auto& files = version.GetFiles(level);
+
+    if (level == 0) {
+      // Every file of level 0 is searched by lookups, so it is scored by
+      // its number of files rather than by its size.
+      auto count = std::count_if(files.begin(), files.end(), [](auto& file) {
+        return !file->being_compacted;
+      });
+
+      return static_cast<double>(count) /
+             std::max(1, options_.level0_file_num_compaction_trigger);
+    }
+
+    uint64_t bytes = 0;
+
+    for (const auto& file : files) {
+      if (!file->being_compacted) {
+        bytes += file->file_size;
+      }
+    }
+
+    return static_cast<double>(bytes) / MaxBytesForLevel(level);
+  }
+
+  double MaxBytesForLevel(int level) const {
+    auto bytes = static_cast<double>(options_.max_bytes_for_level_base);
+
+    for (int i = 1; i < level; ++i) {
+      bytes *= options_.max_bytes_for_level_multiplier;
+    }
+
+    return std::max(bytes, 1.0);
+  }
+
+  /// Picks all of level 0, since its files may overlap one another.
+  std::unique_ptr<Compaction> PickLevel0(
+      std::shared_ptr<const Version> version, double score) {
+    const auto& files = version->GetFiles(0);
+
+    if (AnyBeingCompacted(files)) {
+      return nullptr;
+    }
+
+    std::string_view smallest = ExtractUserKey(files.front()->smallest);
+    std::string_view largest = ExtractUserKey(files.front()->largest);
+
+    for (const auto& file : files) {
+      smallest = std::min(smallest, ExtractUserKey(file->smallest));
+      largest = std::max(largest, ExtractUserKey(file->largest));
+    }
+
+    auto next = version->GetOverlappingFiles(1, smallest, largest);
+
+    if (AnyBeingCompacted(next)) {
+      return nullptr;
+    }
+
+    std::vector<CompactionInputs> inputs{{0, files}, {1, std::move(next)}};
+
+    return std::make_unique<Compaction>(std::move(version), std::move(inputs),
+                                        1, score, options_.target_file_size);
+  }
+
+  /// Picks the first idle file after the last one compacted at `level`.
+  std::unique_ptr<Compaction> PickLevel(std::shared_ptr<const Version> version,
+                                        int level, double score) {
+    const auto& files = version->GetFiles(level);
+    const auto& pointer = compact_pointers_[level];
+    auto start = std::partition_point(
+        files.begin(), files.end(), [&](const auto& file) {
+          return !pointer.empty() &&
+                 InternalKeyComparator{}(file->largest, pointer) <= 0;
+        });
+    auto offset = start - files.begin();
+
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      const auto& file = files[(offset + i) % files.size()];
+
+      if (file->being_compacted) {
+        continue;
+      }
+
+      auto next = version->GetOverlappingFiles(level + 1,
+                                               ExtractUserKey(file->smallest),
+                                               ExtractUserKey(file->largest));
+
+      if (AnyBeingCompacted(next)) {
+        continue;
+      }
+
+      compact_pointers_[level] = file->largest;
+      std::vector<CompactionInputs> inputs{{level, {file}},
+                                           {level + 1, std::move(next)}};
+
+      return std::make_unique<Compaction>(std::move(version),
+                                          std::move(inputs), level + 1, score,
+                                          options_.target_file_size);
+    }
+
+    return nullptr;
+  }
+
+  DBOptions options_;
+  /// The largest key of the last file compacted at each level.
+  std::vector<std::string> compact_pointers_;
+};
+
+/// A sorted run: a file of level 0, or all the files of a deeper level.
+struct SortedRun {
+  int level;
+  std::vector<std::shared_ptr<FileMetaData>> files;
+  uint64_t size = 0;
+  bool being_compacted = false;
+};
+
+class TieredCompactionPicker : public CompactionPicker {
+ public:
+  explicit TieredCompactionPicker(const DBOptions& options)
+      : options_{options} {}
+
+  std::unique_ptr<Compaction> PickCompaction(
+      std::shared_ptr<const Version> version) override {
+    auto runs = GetSortedRuns(*version);
+    auto trigger = std::max(2, options_.level0_file_num_compaction_trigger);
+
+    if (runs.size() < static_cast<std::size_t>(trigger)) {
+      return nullptr;
+    }
+
+    auto score = static_cast<double>(runs.size()) / trigger;
+    auto compaction = PickSizeAmplification(version, runs, score);
+
+    if (compaction == nullptr) {
+      compaction = PickSizeRatio(version, runs, score);
+    }
+
+    if (compaction == nullptr) {
+      compaction = PickRunCount(version, runs, score);
+    }
+
+    if (compaction != nullptr) {
+      compaction->MarkFilesBeingCompacted(true);
+    }
+
+    return compaction;
+  }
+
+ private:
+  /// \return The sorted runs of `version`, newest first.
+  static std::vector<SortedRun> GetSortedRuns(const Version& version) {
+    std::vector<SortedRun> runs;
+
+    for (int level = 0; level < version.NumLevels(); ++level) {
+      for (const auto& file : version.GetFiles(level)) {
+        if (level == 0 || runs.empty() || runs.back().level != level) {
+          runs.push_back({level, {}});
+        }
+
+        auto& run = runs.back();
+        run.files.push_back(file);
+        run.size += file->file_size;
+        run.being_compacted |= file->being_compacted;
+      }
+    }
+
+    return runs;
+  }
+
+  /// Merges all the runs once the newer ones take too much space compared to
+  /// the oldest one, which holds most of the live data.
+  std::unique_ptr<Compaction> PickSizeAmplification(
+      const std::shared_ptr<const Version>& version,
+      const std::vector<SortedRun>& runs, double score) const {
+    uint64_t newer_size = 0;
+
+    for (const auto& run : runs) {
+      if (run.being_compacted) {
+        return nullptr;
+      }
+
+      newer_size += &run == &runs.back() ? 0 : run.size;
+    }
+
+    if (newer_size * 100 < options_.tiered_max_size_amplification_percent *
+                               std::max<uint64_t>(runs.back().size, 1)) {
+      return nullptr;
+    }
+
+    return NewCompaction(version, runs, 0, runs.size(), score);
+  }
+
+  /// Merges the newest window of idle runs in which every run is at most
+  /// `tiered_size_ratio` percent larger than the runs before it, so that
+  /// data is only rewritten when the run holding it has about doubled.
+  std::unique_ptr<Compaction> PickSizeRatio(
+      const std::shared_ptr<const Version>& version,
+      const std::vector<SortedRun>& runs, double score) const {
+    auto min_width =
+        static_cast<std::size_t>(std::max(2, options_.tiered_min_merge_width));
+    auto max_width = std::max(
+        min_width, static_cast<std::size_t>(options_.tiered_max_merge_width));
+
+    for (std::size_t begin = 0; begin < runs.size(); ++begin) {
+      if (runs[begin].being_compacted) {
+        continue;
+      }
+
+      auto size = runs[begin].size;
+      auto end = begin + 1;
+
+      for (; end < runs.size() && end - begin < max_width; ++end) {
+        const auto& run = runs[end];
+
+        if (run.being_compacted ||
+            size * (100 + options_.tiered_size_ratio) / 100 < run.size) {
+          break;
+        }
+
+        size += run.size;
+      }
+
+      if (end - begin >= min_width) {
+        return NewCompaction(version, runs, begin, end, score);
+      }
+    }
+
+    return nullptr;
+  }
+
+  /// Merges the newest idle runs regardless of their sizes, down to one
+  /// less than the trigger.
+  std::unique_ptr<Compaction> PickRunCount(
+      const std::shared_ptr<const Version>& version,
+      const std::vector<SortedRun>& runs, double score) const {
+    auto width = std::max<std::size_t>(
+        2, runs.size() + 1 - options_.level0_file_num_compaction_trigger);
+
+    for (std::size_t begin = 0; begin < runs.size(); ++begin) {
+      auto end = begin;
+
+      while (end < runs.size() && end - begin < width &&
+             !runs[end].being_compacted) {
+        ++end;
+      }
+
+      if (end - begin >= 2) {
+        return NewCompaction(version, runs, begin, end, score);
+      }
+    }
+
+    return nullptr;
+  }
+
+  /// Merges the runs [`begin`, `end`) into a single run, which takes the
+  /// place of the oldest one.
+  std::unique_ptr<Compaction> NewCompaction(
+      std::shared_ptr<const Version> version,
+      const std::vector<SortedRun>& runs, std::size_t begin, std::size_t end,
+      double score) const {
+    std::vector<CompactionInputs> inputs;
+
+    for (auto i = begin; i < end; ++i) {
+      if (inputs.empty() || inputs.back().level != runs[i].level) {
+        inputs.push_back({runs[i].level, {}});
+      }
+
+      auto& files = inputs.back().files;
+      files.insert(files.end(), runs[i].files.begin(), runs[i].files.end());
+    }
+
+    // The output goes as deep as it can while staying above the older runs:
+    // the levels between the oldest input and the next older run are empty.
+    int output_level = runs[end - 1].level;
+
+    if (output_level == 0) {
+      auto next_level =
+          end < runs.size() ? runs[end].level : version->NumLevels();
+      output_level = std::max(0, next_level - 1);
+    }
+
+    // Files of level 0 are runs of their own, so a run written there is a
+    // single file.
+    auto max_output_file_size = output_level == 0
+                                    ? std::numeric_limits<uint64_t>::max()
+                                    : options_.target_file_size;
+
+    return std::make_unique<Compaction>(std::move(version), std::move(inputs),
+                                        output_level, score,
+                                        max_output_file_size);
+  }
+
+  DBOptions options_;
+};
+
+}  // namespace
+
+std::unique_ptr<CompactionPicker> NewLeveledCompactionPicker(
+    const DBOptions& options) {
+  return std::make_unique<LeveledCompactionPicker>(options);
+}
+
+std::unique_ptr<CompactionPicker> NewTieredCompactionPicker(
+    const DBOptions& options) {
+  return std::make_unique<TieredCompactionPicker>(options);
+}
+
+}  // namespace rosekv
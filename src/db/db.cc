@@ -0,0 +1,586 @@
+#include "rosekv/db/db.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <kiwi/io/file_util.hh>
+
+#include "rosekv/db/filename.hh"
+#include "rosekv/table/table_builder.hh"
+
+namespace rosekv {
+
+DB::DB(const DBOptions& options)
+    : options_{options},
+      db_path_{kiwi::FilePath::FromASCII(options_.db_dir)} {
+  kiwi::File::Error error;
+
+  mem_ = std::make_shared<MemTable>(options_);
+  mem_base_usage_ = mem_->ApproximateMemoryUsage();
+
+  versions_ = std::make_unique<VersionSet>(options_, db_path_);
+  compaction_picker_ =
+      options_.compaction_style == CompactionStyle::kTiered
+          ? NewTieredCompactionPicker(options_)
+          : NewLeveledCompactionPicker(options_);
+
+  {
+    std::lock_guard<std::mutex> lk_guard{db_mtx_};
+    InstallReadView();
+  }
+
+  kiwi::CreateDirectoryAndGetError(db_path_, &error);
+
+  if (error != kiwi::File::kFileOk) {
+    LOG(ERROR) << "Failed to create the database directory: " << db_path_;
+    status_ = make_error_code(DBError::kIOError);
+    return;
+  }
+
+  if (options_.wal.wal_dir.empty()) {
+    options_.wal.wal_dir = db_path_.Append("wal").value();
+  }
+
+  if (versions_->Recover(status_); status_) {
+    return;
+  }
+
+  options_.wal.first_segment_id =
+      std::max<uint64_t>(options_.wal.first_segment_id,
+                         versions_->NextWALSegmentId());
+  wal_ = std::make_unique<WAL>(options_.wal);
+
+  if ((status_ = wal_->Status())) {
+    return;
+  }
+
+  // A crash may have come between installing a flushed table and dropping
+  // the segments it covers.
+  if (auto id = versions_->MinWALSegmentId(); id != 0) {
+    wal_->TruncateBefore({id, 0});
+  }
+
+  last_sequence_ = versions_->LastSequence();
+  Recover();
+
+  if (status_) {
+    return;
+  }
+
+  compaction_pool_ =
+      std::make_unique<ThreadPool>(options_.max_background_compactions);
+
+  {
+    std::lock_guard<std::mutex> lk_guard{db_mtx_};
+    InstallReadView();
+    MaybeScheduleCompaction();
+  }
+
+  flush_thread_ = std::thread{&DB::StartFlushThread, this};
+}
+
+DB::~DB() {
+  if (!flush_thread_.joinable()) {
+    return;
+  }
+
+  shutting_down_ = true;
+
+  {
+    std::lock_guard<std::mutex> lk_guard{db_mtx_};
+    stop_flush_thread_ = true;
+  }
+
+  flush_cv_.notify_one();
+  bg_done_cv_.notify_all();
+  flush_thread_.join();
+
+  // The compactions still queued are canceled as soon as they start.
+  compaction_pool_.reset();
+}
+
+void DB::Put(std::string_view key, std::string_view value,
+             std::error_code& ec) {
+  Write(ValueType::kValue, key, value, ec);
+}
+
+void DB::Delete(std::string_view key, std::error_code& ec) {
+  Write(ValueType::kDeletion, key, {}, ec);
+}
+
+std::optional<std::string> DB::Get(std::string_view key,
+                                   std::error_code& ec) {
+  if (status_) {
+    ec = status_;
+    return std::nullopt;
+  }
+
+  auto view = GetReadView();
+  std::string value;
+  auto result = view->mem->Get(key, kMaxSequenceNumber, &value);
+
+  for (auto it = view->imm.begin();
+       result == LookupResult::kNotFound && it != view->imm.end(); ++it) {
+    result = (*it)->Get(key, kMaxSequenceNumber, &value);
+  }
+
+  if (result == LookupResult::kNotFound) {
+    result = view->version->Get(key, kMaxSequenceNumber, &value, ec);
+  }
+
+  if (ec || result != LookupResult::kFound) {
+    return std::nullopt;
+  }
+
+  return value;
+}
+
+void DB::Flush(std::error_code& ec) {
+  if (status_) {
+    ec = status_;
+    return;
+  }
+
+  {
+    std::lock_guard<std::shared_mutex> lk_guard{write_mtx_};
+
+    if (SwitchMemTable(ec); ec) {
+      return;
+    }
+  }
+
+  std::unique_lock<std::mutex> lk_guard{db_mtx_};
+  bg_done_cv_.wait(lk_guard, [this] {
+    return imm_.empty() || bg_error_ || stop_flush_thread_;
+  });
+
+  ec = bg_error_;
+}
+
+void DB::WaitForCompactions(std::error_code& ec) {
+  if (status_) {
+    ec = status_;
+    return;
+  }
+
+  // Every flush and compaction schedules the compactions it makes needed
+  // before it completes, so none is needed once they are all done.
+  std::unique_lock<std::mutex> lk_guard{db_mtx_};
+  bg_done_cv_.wait(lk_guard, [this] {
+    return (imm_.empty() && num_running_compactions_ == 0) || bg_error_ ||
+           stop_flush_thread_;
+  });
+
+  ec = bg_error_;
+}
+
+std::size_t DB::ApproximateMemTableUsage() {
+  return GetReadView()->mem->ApproximateMemoryUsage();
+}
+
+std::size_t DB::NumImmutableMemTables() {
+  std::lock_guard<std::mutex> lk_guard{db_mtx_};
+
+  return imm_.size();
+}
+
+std::size_t DB::NumTableFiles() {
+  return GetReadView()->version->NumFiles();
+}
+
+std::size_t DB::NumFilesAtLevel(int level) {
+  auto view = GetReadView();
+
+  if (level < 0 || level >= view->version->NumLevels()) {
+    return 0;
+  }
+
+  return view->version->GetFiles(level).size();
+}
+
+DBStats DB::GetStats() {
+  auto version = GetReadView()->version;
+  std::lock_guard<std::mutex> lk_guard{db_mtx_};
+  auto stats = stats_;
+
+  stats.num_sorted_runs = version->GetFiles(0).size();
+
+  for (int level = 1; level < version->NumLevels(); ++level) {
+    stats.num_sorted_runs += !version->GetFiles(level).empty();
+  }
+
+  return stats;
+}
+
+void DB::Write(ValueType type, std::string_view key, std::string_view value,
+               std::error_code& ec) {
+  if (status_) {
+    ec = status_;
+    return;
+  }
+
+  // Memory held by an empty memtable, e.g. the buckets of a hash memtable,
+  // never makes it full.
+  auto is_full = [this] {
+    auto usage = mem_->ApproximateMemoryUsage();
+
+    return usage >= options_.write_buffer_size && usage > mem_base_usage_;
+  };
+
+  while (true) {
+    {
+      std::shared_lock<std::shared_mutex> lk_guard{write_mtx_};
+
+      if (!is_full()) {
+        // The sequence number travels with the record, so replaying the WAL
+        // restores the same order even if concurrent writers reach it out
+        // of order.
+        auto sequence =
+            last_sequence_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        std::string header;
+        PutFixed64(&header, PackSequenceAndType(sequence, type));
+        PutVarint64(&header, key.size());
+
+        const Slice slices[] = {
+            kiwi::span(static_cast<std::string_view>(header)),
+            kiwi::span(key), kiwi::span(value)};
+
+        if (wal_->WriteV(slices, ec); ec) {
+          return;
+        }
+
+        mem_->Add(sequence, type, key, value);
+
+        return;
+      }
+    }
+
+    // The first writer to find the memtable full switches it, the others
+    // then find the new one.
+    std::lock_guard<std::shared_mutex> lk_guard{write_mtx_};
+
+    if (is_full()) {
+      if (SwitchMemTable(ec); ec) {
+        return;
+      }
+    }
+  }
+}
+
+void DB::SwitchMemTable(std::error_code& ec) {
+  std::unique_lock<std::mutex> lk_guard{db_mtx_};
+  auto max_imm = static_cast<std::size_t>(
+      std::max(1, options_.max_immutable_memtables));
+
+  if (imm_.size() >= max_imm) {
+    LOG(WARNING) << "Stalling writes: " << imm_.size()
+                 << " immutable memtables are waiting to be flushed";
+
+    bg_done_cv_.wait(lk_guard, [&] {
+      return imm_.size() < max_imm || bg_error_ || stop_flush_thread_;
+    });
+  }
+
+  if (bg_error_) {
+    ec = bg_error_;
+    return;
+  }
+
+  // Records written from now on go to the new segment, so the segments
+  // before it only hold records of the memtables switched so far.
+  auto wal_end = wal_->SwitchSegment(ec);
+
+  if (ec) {
+    return;
+  }
+
+  imm_.push_back({std::move(mem_), wal_end});
+  mem_ = std::make_shared<MemTable>(options_);
+  mem_base_usage_ = mem_->ApproximateMemoryUsage();
+  InstallReadView();
+
+  lk_guard.unlock();
+  flush_cv_.notify_one();
+}
+
+void DB::Recover() {
+  auto iter = wal_->Subscribe();
+  std::error_code ec;
+  std::size_t count = 0;
+
+  // Memtables are flushed in the order they were switched and each one only
+  // holds larger sequence numbers than the previous ones, so the tables hold
+  // every record up to their largest sequence number and none after it.
+  auto flushed_sequence = last_sequence_.load();
+
+  // Nothing writes to the WAL yet, so the iterator stops at its end.
+  while (iter->Next(std::chrono::milliseconds(0), ec)) {
+    std::string_view record = iter->GetData();
+    uint64_t tag;
+    std::string_view key;
+
+    if (!GetFixed64(&record, &tag) || !GetLengthPrefixed(&record, &key) ||
+        (tag & 0xff) > static_cast<uint8_t>(ValueType::kValue)) {
+      LOG(ERROR) << "Corrupted WAL record at: " << iter->GetLSN();
+      status_ = make_error_code(DBError::kCorruption);
+      return;
+    }
+
+    auto sequence = tag >> 8;
+
+    if (sequence <= flushed_sequence) {
+      continue;
+    }
+
+    mem_->Add(sequence, static_cast<ValueType>(tag & 0xff), key, record);
+    last_sequence_ = std::max(last_sequence_.load(), sequence);
+    ++count;
+  }
+
+  // A crash in the middle of an append tears the last record, and replay
+  // stops there as it does at the first record failing its checksum. The WAL
+  // is cut at that record so that new records follow the good ones.
+  if (ec == make_error_code(WALError::kCorruptedRecord)) {
+    LOG(WARNING) << "Discarding the WAL from a torn or corrupted record at: "
+                 << iter->GetNextLSN();
+    ec.clear();
+    wal_->TruncateFrom(iter->GetNextLSN(), ec);
+  }
+
+  if (ec) {
+    status_ = ec;
+    return;
+  }
+
+  LOG(INFO) << "Recovered " << count << " records from the WAL, last "
+            << "sequence: " << last_sequence_.load();
+}
+
+void DB::StartFlushThread() {
+  std::unique_lock<std::mutex> lk_guard{db_mtx_};
+
+  while (true) {
+    if (!stop_flush_thread_ && !imm_.empty() && !bg_error_ &&
+        IsLevel0Full()) {
+      LOG(WARNING) << "Stalling flushes: level 0 has "
+                   << versions_->Current()->GetFiles(0).size() << " files";
+    }
+
+    flush_cv_.wait(lk_guard, [this] {
+      return stop_flush_thread_ ||
+             (!imm_.empty() && !bg_error_ && !IsLevel0Full());
+    });
+
+    if (stop_flush_thread_) {
+      break;
+    }
+
+    auto imm = imm_.front();
+    auto number = versions_->NewFileNumber();
+
+    lk_guard.unlock();
+
+    std::error_code ec;
+    auto table = WriteLevel0Table(*imm.mem, number, ec);
+
+    lk_guard.lock();
+
+    if (!ec && table != nullptr) {
+      VersionEdit edit;
+      edit.AddFile(0, NewFileMetaData(number, table));
+      edit.min_wal_segment_id = imm.wal_end.GetSegmentId();
+      edit.next_wal_segment_id = wal_->GetEndLSN().GetSegmentId() + 1;
+
+      if (versions_->LogAndApply(edit, ec); ec) {
+        kiwi::DeleteFile(db_path_.Append(TableFileName(number)));
+      } else {
+        ++stats_.num_flushes;
+        stats_.bytes_flushed += table->FileSize();
+      }
+    }
+
+    if (ec) {
+      LOG(ERROR) << "Failed to flush a memtable: " << ec.message();
+      bg_error_ = ec;
+      bg_done_cv_.notify_all();
+      continue;
+    }
+
+    // The table is recorded in the version, so the records it holds are no
+    // longer needed in the WAL. They are dropped before the flush completes,
+    // so that waiters find the WAL truncated.
+    wal_->TruncateBefore(imm.wal_end);
+
+    imm_.pop_front();
+    InstallReadView();
+    MaybeScheduleCompaction();
+    bg_done_cv_.notify_all();
+  }
+}
+
+std::shared_ptr<Table> DB::WriteLevel0Table(const MemTable& mem,
+                                            uint64_t number,
+                                            std::error_code& ec) {
+  MemTable::Iterator iter{&mem};
+  iter.SeekToFirst();
+
+  if (!iter.Valid()) {
+    return nullptr;
+  }
+
+  // The table is written under a temporary name first, so that a crash
+  // never leaves a partial table behind.
+  auto temp_path = db_path_.Append(TempFileName(number));
+  auto path = db_path_.Append(TableFileName(number));
+  TableBuilder builder{options_.table, temp_path};
+
+  for (; iter.Valid(); iter.Next()) {
+    builder.Add(iter.key(), iter.value());
+  }
+
+  builder.Finish(ec);
+
+  kiwi::File::Error error;
+
+  if (!ec && !kiwi::ReplaceFile(temp_path, path, &error)) {
+    LOG(ERROR) << "Failed to rename table: " << temp_path << " to: " << path;
+    ec = make_error_code(DBError::kIOError);
+  }
+
+  if (ec) {
+    kiwi::DeleteFile(temp_path);
+    return nullptr;
+  }
+
+  // The rename must be durable before the WAL records the table holds are
+  // dropped.
+  if (!SyncDirectory(db_path_)) {
+    LOG(ERROR) << "Failed to sync directory: " << db_path_;
+    ec = make_error_code(DBError::kIOError);
+    kiwi::DeleteFile(path);
+    return nullptr;
+  }
+
+  auto table = std::make_shared<Table>(path, options_.table);
+
+  if ((ec = table->Status())) {
+    return nullptr;
+  }
+
+  LOG(INFO) << "Flushed " << builder.NumEntries() << " entries to table: "
+            << path << ", size: " << builder.FileSize();
+
+  return table;
+}
+
+void DB::MaybeScheduleCompaction() {
+  if (shutting_down_ || bg_error_) {
+    return;
+  }
+
+  while (num_running_compactions_ < options_.max_background_compactions) {
+    std::shared_ptr<Compaction> compaction =
+        compaction_picker_->PickCompaction(versions_->Current());
+
+    if (compaction == nullptr) {
+      break;
+    }
+
+    ++num_running_compactions_;
+    compaction_pool_->Schedule(
+        [this, compaction] { BackgroundCompaction(compaction.get()); });
+  }
+}
+
+void DB::BackgroundCompaction(Compaction* compaction) {
+  CompactionJob job{options_, db_path_, compaction,
+                    [this] {
+                      std::lock_guard<std::mutex> lk_guard{db_mtx_};
+                      return versions_->NewFileNumber();
+                    },
+                    &shutting_down_, compaction_pool_.get()};
+  std::error_code ec;
+
+  job.Run(ec);
+
+  std::unique_lock<std::mutex> lk_guard{db_mtx_};
+  VersionEdit edit;
+
+  if (!ec) {
+    job.AddToEdit(&edit);
+    versions_->LogAndApply(edit, ec);
+  }
+
+  compaction->MarkFilesBeingCompacted(false);
+
+  if (!ec) {
+    InstallReadView();
+
+    // Readers still holding a previous version keep the inputs open, and
+    // their data stays readable until they are done.
+    for (const auto& [level, number] : edit.deleted_files) {
+      kiwi::DeleteFile(db_path_.Append(TableFileName(number)));
+    }
+
+    const auto& stats = job.GetStats();
+    ++stats_.num_compactions;
+    stats_.compactions.Add(stats);
+
+    LOG(INFO) << "Compacted " << stats.num_input_files << " files at level "
+              << compaction->start_level() << " into "
+              << stats.num_output_files << " files at level "
+              << compaction->output_level() << " in "
+              << stats.num_subcompactions << " subcompactions, read: "
+              << stats.bytes_read
+              << ", written: " << stats.bytes_written << ", dropped "
+              << stats.num_dropped_records << " of "
+              << stats.num_input_records << " records in " << stats.micros
+              << "us";
+  } else if (ec != std::errc::operation_canceled) {
+    LOG(ERROR) << "Failed to compact: " << ec.message();
+
+    // The outputs of the job, if any, are not in the version.
+    for (const auto& [level, file] : edit.new_files) {
+      kiwi::DeleteFile(db_path_.Append(TableFileName(file->number)));
+    }
+
+    bg_error_ = ec;
+  }
+
+  --num_running_compactions_;
+  MaybeScheduleCompaction();
+
+  lk_guard.unlock();
+  bg_done_cv_.notify_all();
+  flush_cv_.notify_one();
+}
+
+bool DB::IsLevel0Full() const {
+  return versions_->Current()->GetFiles(0).size() >=
+         static_cast<std::size_t>(
+             std::max(1, options_.level0_stop_writes_trigger));
+}
+
+void DB::InstallReadView() {
+  auto view = std::make_shared<ReadView>();
+  view->mem = mem_;
+
+  for (auto it = imm_.rbegin(); it != imm_.rend(); ++it) {
+    view->imm.push_back(it->mem);
+  }
+
+  view->version = versions_->Current();
+
+  std::lock_guard<std::mutex> lk_guard{read_view_mtx_};
+  read_view_ = std::move(view);
+}
+
+std::shared_ptr<const DB::ReadView> DB::GetReadView() {
+  std::lock_guard<std::mutex> lk_guard{read_view_mtx_};
+
+  return read_view_;
+}
+
+}  // namespace rosekv
@@ -0,0 +1,79 @@
+#include "rosekv/db/memtable.hh"
+
+#include <algorithm>
+
+namespace rosekv {
+
+namespace {
+
+/// Encodes a seek target for `internal_key` into `scratch`, in the layout of
+/// an entry without its value.
+const char* EncodeSeekEntry(std::string_view internal_key,
+                            std::string* scratch) {
+  scratch->clear();
+  PutLengthPrefixed(scratch, internal_key);
+
+  return scratch->data();
+}
+
+}  // namespace
+
+MemTable::MemTable(const DBOptions& options)
+    : arena_{options.arena_block_size, options.memtable_huge_pages},
+      rep_{options.memtable_type == MemTableType::kHash
+               ? NewHashRep(&arena_, options.hash_bucket_count)
+               : NewSkipListRep(&arena_)} {}
+
+void MemTable::Add(SequenceNumber sequence, ValueType type,
+                   std::string_view key, std::string_view value) {
+  auto internal_key_size = key.size() + kInternalKeyTagSize;
+  auto entry_size = VarintLength(internal_key_size) + internal_key_size +
+                    VarintLength(value.size()) + value.size();
+  auto entry = arena_.Allocate(entry_size);
+  auto ptr = EncodeVarint64(entry, internal_key_size);
+
+  ptr = std::copy(key.begin(), key.end(), ptr);
+  kiwi::LittleEndian::PutUint64(reinterpret_cast<uint8_t*>(ptr),
+                                PackSequenceAndType(sequence, type));
+  ptr = EncodeVarint64(ptr + kInternalKeyTagSize, value.size());
+  std::copy(value.begin(), value.end(), ptr);
+
+  rep_->Insert(entry);
+}
+
+LookupResult MemTable::Get(std::string_view key, SequenceNumber sequence,
+                           std::string* value) const {
+  auto entry = rep_->Lookup(key, sequence);
+
+  if (entry == nullptr) {
+    return LookupResult::kNotFound;
+  }
+
+  auto internal_key = DecodeLengthPrefixed(entry);
+
+  if (static_cast<ValueType>(ExtractTag(internal_key) & 0xff) ==
+      ValueType::kDeletion) {
+    return LookupResult::kDeleted;
+  }
+
+  value->assign(
+      DecodeLengthPrefixed(internal_key.data() + internal_key.size()));
+
+  return LookupResult::kFound;
+}
+
+void MemTable::Iterator::Seek(std::string_view target) {
+  iter_->Seek(EncodeSeekEntry(target, &seek_entry_));
+}
+
+std::string_view MemTable::Iterator::key() const {
+  return DecodeLengthPrefixed(iter_->entry());
+}
+
+std::string_view MemTable::Iterator::value() const {
+  auto internal_key = key();
+
+  return DecodeLengthPrefixed(internal_key.data() + internal_key.size());
+}
+
+}  // namespace rosekv
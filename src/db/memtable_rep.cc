@@ -0,0 +1,209 @@
+#include "rosekv/db/memtable_rep.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <vector>
+
+#include "rosekv/db/skiplist.hh"
+
+namespace rosekv {
+
+namespace {
+
+class SkipListRep : public MemTableRep {
+  using Table = SkipList<const char*, MemTableEntryComparator>;
+
+ public:
+  explicit SkipListRep(ConcurrentArena* arena)
+      : table_{MemTableEntryComparator{}, arena} {}
+
+  void Insert(const char* entry) override { table_.Insert(entry); }
+
+  const char* Lookup(std::string_view user_key,
+                     SequenceNumber sequence) const override {
+    std::string target;
+    PutVarint64(&target, user_key.size() + kInternalKeyTagSize);
+    AppendInternalKey(&target, user_key, sequence, kValueTypeForSeek);
+
+    // The first entry at or after the target is the newest visible update of
+    // the key, if it belongs to the key at all.
+    Table::Iterator iter{&table_};
+    iter.Seek(target.data());
+
+    if (!iter.Valid() ||
+        ExtractUserKey(DecodeLengthPrefixed(iter.key())) != user_key) {
+      return nullptr;
+    }
+
+    return iter.key();
+  }
+
+  class Iterator : public MemTableRep::Iterator {
+   public:
+    explicit Iterator(const Table* table) : iter_{table} {}
+
+    bool Valid() const override { return iter_.Valid(); }
+    const char* entry() const override { return iter_.key(); }
+    void Next() override { iter_.Next(); }
+    void Prev() override { iter_.Prev(); }
+    void Seek(const char* target) override { iter_.Seek(target); }
+    void SeekToFirst() override { iter_.SeekToFirst(); }
+    void SeekToLast() override { iter_.SeekToLast(); }
+
+   private:
+    Table::Iterator iter_;
+  };
+
+  std::unique_ptr<MemTableRep::Iterator> NewIterator() const override {
+    return std::make_unique<Iterator>(&table_);
+  }
+
+ private:
+  Table table_;
+};
+
+class HashRep : public MemTableRep {
+  struct Node {
+    const char* entry;
+    Node* next;
+  };
+
+ public:
+  HashRep(ConcurrentArena* arena, std::size_t bucket_count)
+      : arena_{arena}, bucket_count_{std::max<std::size_t>(bucket_count, 1)} {
+    auto mem =
+        arena_->AllocateAligned(sizeof(std::atomic<Node*>) * bucket_count_);
+    buckets_ = reinterpret_cast<std::atomic<Node*>*>(mem);
+
+    for (std::size_t i = 0; i < bucket_count_; ++i) {
+      new (&buckets_[i]) std::atomic<Node*>{nullptr};
+    }
+  }
+
+  void Insert(const char* entry) override {
+    auto node = reinterpret_cast<Node*>(arena_->AllocateAligned(sizeof(Node)));
+    auto& bucket = GetBucket(ExtractUserKey(DecodeLengthPrefixed(entry)));
+
+    node->entry = entry;
+    node->next = bucket.load(std::memory_order_relaxed);
+
+    while (!bucket.compare_exchange_weak(node->next, node,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+    }
+
+    entry_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const char* Lookup(std::string_view user_key,
+                     SequenceNumber sequence) const override {
+    const char* result = nullptr;
+    uint64_t result_tag = 0;
+
+    // Concurrent writers may push their entries out of sequence order, so
+    // the whole chain is checked rather than stopping at the first match.
+    for (auto node = GetBucket(user_key).load(std::memory_order_acquire);
+         node != nullptr; node = node->next) {
+      auto internal_key = DecodeLengthPrefixed(node->entry);
+      auto tag = ExtractTag(internal_key);
+
+      if ((tag >> 8) <= sequence && tag >= result_tag &&
+          ExtractUserKey(internal_key) == user_key) {
+        result = node->entry;
+        result_tag = tag;
+      }
+    }
+
+    return result;
+  }
+
+  /// Iterates over a sorted snapshot of the entries, taken when the
+  /// iterator is first positioned.
+  class Iterator : public MemTableRep::Iterator {
+   public:
+    explicit Iterator(const HashRep* rep) : rep_{rep} {}
+
+    bool Valid() const override { return pos_ < entries_.size(); }
+    const char* entry() const override { return entries_[pos_]; }
+    void Next() override { ++pos_; }
+
+    void Prev() override {
+      pos_ = pos_ == 0 ? entries_.size() : pos_ - 1;
+    }
+
+    void Seek(const char* target) override {
+      EnsureSorted();
+      pos_ = std::lower_bound(entries_.begin(), entries_.end(), target,
+                              [](const char* a, const char* b) {
+                                return MemTableEntryComparator{}(a, b) < 0;
+                              }) -
+             entries_.begin();
+    }
+
+    void SeekToFirst() override {
+      EnsureSorted();
+      pos_ = 0;
+    }
+
+    void SeekToLast() override {
+      EnsureSorted();
+      pos_ = entries_.empty() ? 0 : entries_.size() - 1;
+    }
+
+   private:
+    void EnsureSorted() {
+      if (sorted_) {
+        return;
+      }
+
+      entries_.reserve(rep_->entry_count_.load(std::memory_order_relaxed));
+
+      for (std::size_t i = 0; i < rep_->bucket_count_; ++i) {
+        for (auto node = rep_->buckets_[i].load(std::memory_order_acquire);
+             node != nullptr; node = node->next) {
+          entries_.push_back(node->entry);
+        }
+      }
+
+      std::sort(entries_.begin(), entries_.end(),
+                [](const char* a, const char* b) {
+                  return MemTableEntryComparator{}(a, b) < 0;
+                });
+      sorted_ = true;
+    }
+
+    const HashRep* rep_;
+    std::vector<const char*> entries_;
+    std::size_t pos_ = 0;
+    bool sorted_ = false;
+  };
+
+  std::unique_ptr<MemTableRep::Iterator> NewIterator() const override {
+    return std::make_unique<Iterator>(this);
+  }
+
+ private:
+  std::atomic<Node*>& GetBucket(std::string_view user_key) const {
+    return buckets_[std::hash<std::string_view>{}(user_key) % bucket_count_];
+  }
+
+  ConcurrentArena* arena_;
+  const std::size_t bucket_count_;
+  std::atomic<Node*>* buckets_;
+  std::atomic<std::size_t> entry_count_{0};
+};
+
+}  // namespace
+
+std::unique_ptr<MemTableRep> NewSkipListRep(ConcurrentArena* arena) {
+  return std::make_unique<SkipListRep>(arena);
+}
+
+std::unique_ptr<MemTableRep> NewHashRep(ConcurrentArena* arena,
+                                        std::size_t bucket_count) {
+  return std::make_unique<HashRep>(arena, bucket_count);
+}
+
+}  // namespace rosekv
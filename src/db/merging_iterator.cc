@@ -0,0 +1,72 @@
+#include "rosekv/db/merging_iterator.hh"
+
+#include <algorithm>
+
+#include "rosekv/db/dbformat.hh"
+
+namespace rosekv {
+
+namespace {
+
+/// Orders the heap so that the child with the smallest key is at its front.
+bool HeapGreater(const Table::Iterator* a, const Table::Iterator* b) {
+  return InternalKeyComparator{}(a->key(), b->key()) > 0;
+}
+
+}  // namespace
+
+MergingIterator::MergingIterator(
+    std::vector<std::unique_ptr<Table::Iterator>> children)
+    : children_{std::move(children)} {
+  heap_.reserve(children_.size());
+}
+
+void MergingIterator::SeekToFirst() {
+  for (auto& child : children_) {
+    child->SeekToFirst();
+  }
+
+  BuildHeap();
+}
+
+void MergingIterator::Seek(std::string_view target) {
+  for (auto& child : children_) {
+    child->Seek(target);
+  }
+
+  BuildHeap();
+}
+
+void MergingIterator::Next() {
+  std::pop_heap(heap_.begin(), heap_.end(), HeapGreater);
+
+  auto child = heap_.back();
+  child->Next();
+
+  if (child->Valid()) {
+    std::push_heap(heap_.begin(), heap_.end(), HeapGreater);
+    return;
+  }
+
+  heap_.pop_back();
+
+  if (!status_) {
+    status_ = child->Status();
+  }
+}
+
+void MergingIterator::BuildHeap() {
+  heap_.clear();
+
+  for (auto& child : children_) {
+    if (child->Valid()) {
+      heap_.push_back(child.get());
+    } else if (!status_) {
+      status_ = child->Status();
+    }
+  }
+
+  std::make_heap(heap_.begin(), heap_.end(), HeapGreater);
+}
+
+}  // namespace rosekv
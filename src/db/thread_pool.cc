@@ -0,0 +1,54 @@
+#include "rosekv/db/thread_pool.hh"
+
+#include <algorithm>
+
+namespace rosekv {
+
+ThreadPool::ThreadPool(int num_threads) {
+  for (int i = 0; i < std::max(1, num_threads); ++i) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+    stop_ = true;
+  }
+
+  cv_.notify_all();
+
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+    tasks_.push_back(std::move(task));
+  }
+
+  cv_.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lk_guard{mtx_};
+
+  while (true) {
+    cv_.wait(lk_guard, [this] { return stop_ || !tasks_.empty(); });
+
+    if (tasks_.empty()) {
+      break;
+    }
+
+    auto task = std::move(tasks_.front());
+    tasks_.pop_front();
+
+    lk_guard.unlock();
+    task();
+    lk_guard.lock();
+  }
+}
+
+}  // namespace rosekv
@@ -0,0 +1,598 @@
+#include "rosekv/db/version.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <kiwi/io/file_enumerator.hh>
+#include <kiwi/io/file_util.hh>
+#include <optional>
+#include <vector>
+
+#include "rosekv/db/coding.hh"
+#include "rosekv/db/error_code.hh"
+#include "rosekv/db/filename.hh"
+
+namespace rosekv {
+
+namespace {
+
+/// The tags of the fields of an encoded `VersionEdit`, each followed by its
+/// varint values.
+enum class EditTag : uint64_t {
+  kNextFileNumber = 1,
+  kLastSequence = 2,
+  kMinWALSegmentId = 3,
+  kNextWALSegmentId = 4,
+  /// Followed by the level and the number of the file.
+  kDeletedFile = 5,
+  /// Followed by the level and the number of the file.
+  kNewFile = 6,
+};
+
+void PutField(std::string* dst, EditTag tag, std::optional<uint64_t> value) {
+  if (value.has_value()) {
+    PutVarint64(dst, static_cast<uint64_t>(tag));
+    PutVarint64(dst, *value);
+  }
+}
+
+/// The format of the MANIFEST, whose records are small and rarely written.
+constexpr ManifestSegment::Format kManifestFormat{
+    ManifestSegment::kFormatV2, kDefaultBlockSize, ChecksumType::kCrc32c};
+
+}  // namespace
+
+void VersionEdit::EncodeTo(std::string* dst) const {
+  PutField(dst, EditTag::kNextFileNumber, next_file_number);
+  PutField(dst, EditTag::kLastSequence, last_sequence);
+  PutField(dst, EditTag::kMinWALSegmentId, min_wal_segment_id);
+  PutField(dst, EditTag::kNextWALSegmentId, next_wal_segment_id);
+
+  for (const auto& [level, number] : deleted_files) {
+    PutVarint64(dst, static_cast<uint64_t>(EditTag::kDeletedFile));
+    PutVarint64(dst, level);
+    PutVarint64(dst, number);
+  }
+
+  for (const auto& [level, file] : new_files) {
+    PutVarint64(dst, static_cast<uint64_t>(EditTag::kNewFile));
+    PutVarint64(dst, level);
+    PutVarint64(dst, file->number);
+  }
+}
+
+bool VersionEdit::DecodeFrom(std::string_view src) {
+  *this = {};
+
+  while (!src.empty()) {
+    uint64_t tag, value;
+
+    if (!GetVarint64(&src, &tag) || !GetVarint64(&src, &value)) {
+      return false;
+    }
+
+    switch (static_cast<EditTag>(tag)) {
+      case EditTag::kNextFileNumber:
+        next_file_number = value;
+        break;
+      case EditTag::kLastSequence:
+        last_sequence = value;
+        break;
+      case EditTag::kMinWALSegmentId:
+        min_wal_segment_id = value;
+        break;
+      case EditTag::kNextWALSegmentId:
+        next_wal_segment_id = value;
+        break;
+      case EditTag::kDeletedFile:
+      case EditTag::kNewFile: {
+        uint64_t number;
+
+        if (!GetVarint64(&src, &number)) {
+          return false;
+        }
+
+        if (static_cast<EditTag>(tag) == EditTag::kDeletedFile) {
+          DeleteFile(static_cast<int>(value), number);
+        } else {
+          auto file = std::make_shared<FileMetaData>();
+          file->number = number;
+          AddFile(static_cast<int>(value), std::move(file));
+        }
+
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+std::shared_ptr<FileMetaData> NewFileMetaData(uint64_t number,
+                                              std::shared_ptr<Table> table) {
+  auto file = std::make_shared<FileMetaData>();
+  const auto& props = table->GetProperties();
+
+  file->number = number;
+  file->file_size = table->FileSize();
+  file->smallest = props.smallest_key;
+  file->largest = props.largest_key;
+  file->largest_sequence = props.max_sequence;
+  file->table = std::move(table);
+
+  return file;
+}
+
+std::size_t Version::NumFiles() const {
+  std::size_t count = 0;
+
+  for (const auto& files : files_) {
+    count += files.size();
+  }
+
+  return count;
+}
+
+uint64_t Version::NumLevelBytes(int level) const {
+  uint64_t bytes = 0;
+
+  for (const auto& file : files_[level]) {
+    bytes += file->file_size;
+  }
+
+  return bytes;
+}
+
+LookupResult Version::Get(std::string_view user_key, SequenceNumber sequence,
+                          std::string* value, std::error_code& ec) const {
+  // Files of level 0 may overlap, so each one covering the key is searched,
+  // newest first.
+  for (const auto& file : files_[0]) {
+    if (user_key < ExtractUserKey(file->smallest) ||
+        user_key > ExtractUserKey(file->largest)) {
+      continue;
+    }
+
+    auto result = file->table->Get(user_key, sequence, value, ec);
+
+    if (ec || result != LookupResult::kNotFound) {
+      return result;
+    }
+  }
+
+  std::string target;
+  AppendInternalKey(&target, user_key, sequence, kValueTypeForSeek);
+
+  for (int level = 1; level < NumLevels(); ++level) {
+    const auto& files = files_[level];
+
+    // The first file whose last key is at or after the target is the only
+    // one that may hold it.
+    auto it = std::partition_point(
+        files.begin(), files.end(), [&](const auto& file) {
+          return InternalKeyComparator{}(file->largest, target) < 0;
+        });
+
+    if (it == files.end() || user_key < ExtractUserKey((*it)->smallest)) {
+      continue;
+    }
+
+    auto result = (*it)->table->Get(user_key, sequence, value, ec);
+
+    if (ec || result != LookupResult::kNotFound) {
+      return result;
+    }
+  }
+
+  return LookupResult::kNotFound;
+}
+
+std::vector<std::shared_ptr<FileMetaData>> Version::GetOverlappingFiles(
+    int level, std::string_view smallest_user_key,
+    std::string_view largest_user_key) const {
+  std::vector<std::shared_ptr<FileMetaData>> overlapping;
+
+  for (const auto& file : files_[level]) {
+    if (ExtractUserKey(file->largest) >= smallest_user_key &&
+        ExtractUserKey(file->smallest) <= largest_user_key) {
+      overlapping.push_back(file);
+    }
+  }
+
+  return overlapping;
+}
+
+
+VersionSet::VersionSet(const DBOptions& options, const kiwi::FilePath& db_path)
+    : options_{options},
+      db_path_{db_path},
+      current_{std::make_shared<Version>(std::max(1, options.num_levels))} {}
+
+void VersionSet::Recover(std::error_code& ec) {
+  std::unordered_map<uint64_t, int> levels;
+  bool has_manifest = kiwi::PathExists(db_path_.Append(kCurrentFileName));
+
+  if (has_manifest) {
+    if (ReplayManifest(&levels, ec); ec) {
+      return;
+    }
+  }
+
+  auto version = std::make_shared<Version>(*current_);
+  std::vector<kiwi::FilePath> obsolete_files;
+  kiwi::FileEnumerator file_iter(db_path_, false,
+                                 kiwi::FileEnumerator::kFiles);
+
+  for (auto fp = file_iter.Next(); !fp.empty(); fp = file_iter.Next()) {
+    auto basename = fp.BaseName().value();
+
+    if (auto number = ParseTableFileName(basename)) {
+      next_file_number_ = std::max(next_file_number_, *number + 1);
+
+      if (!has_manifest) {
+        levels.emplace(*number, 0);
+      } else if (!levels.contains(*number)) {
+        // A table written by a flush or compaction that was never installed.
+        obsolete_files.push_back(fp);
+      }
+    } else if (auto number = ParseTempFileName(basename)) {
+      // A flush interrupted by a crash, whose records are still in the WAL.
+      obsolete_files.push_back(fp);
+      next_file_number_ = std::max(next_file_number_, *number + 1);
+    } else if (auto number = ParseManifestFileName(basename)) {
+      // A MANIFEST replaced by a rollover interrupted by a crash.
+      if (*number != manifest_number_) {
+        obsolete_files.push_back(fp);
+      }
+    } else if (basename == std::string(kCurrentFileName) +
+                              std::string(kTempFileExtension)) {
+      obsolete_files.push_back(fp);
+    }
+  }
+
+  for (const auto& [number, level] : levels) {
+    auto path = db_path_.Append(TableFileName(number));
+
+    if (level >= version->NumLevels()) {
+      LOG(ERROR) << "Table: " << path << " is at level " << level
+                 << ", but the database only has " << version->NumLevels()
+                 << " levels";
+      ec = make_error_code(DBError::kCorruption);
+      return;
+    }
+
+    if (!kiwi::PathExists(path)) {
+      LOG(ERROR) << "Missing table: " << path;
+      ec = make_error_code(DBError::kCorruption);
+      return;
+    }
+
+    auto table = std::make_shared<Table>(path, options_.table);
+
+    if ((ec = table->Status())) {
+      LOG(ERROR) << "Failed to open table: " << path;
+      return;
+    }
+
+    auto file = NewFileMetaData(number, std::move(table));
+    last_sequence_ = std::max(last_sequence_, file->largest_sequence);
+    version->files_[level].push_back(std::move(file));
+  }
+
+  for (const auto& fp : obsolete_files) {
+    LOG(INFO) << "Deleting obsolete file: " << fp;
+    kiwi::DeleteFile(fp);
+  }
+
+  SortFiles(version.get());
+
+  // Replaying starts over from a single snapshot on the next open.
+  VersionEdit counters;
+  AddCounters(&counters);
+
+  if (WriteSnapshot(*version, counters, ec); ec) {
+    return;
+  }
+
+  current_ = std::move(version);
+}
+
+void VersionSet::LogAndApply(const VersionEdit& edit, std::error_code& ec) {
+  auto version = std::make_shared<Version>(*current_);
+
+  for (const auto& [level, number] : edit.deleted_files) {
+    auto& files = version->files_[level];
+    auto it = std::find_if(files.begin(), files.end(), [&](const auto& file) {
+      return file->number == number;
+    });
+
+    DCHECK(it != files.end()) << "Deleting missing table: " << number;
+
+    if (it != files.end()) {
+      files.erase(it);
+    }
+  }
+
+  for (const auto& [level, file] : edit.new_files) {
+    version->files_[level].push_back(file);
+  }
+
+  SortFiles(version.get());
+
+  // Each record carries the counters as of its edit, so replaying the
+  // MANIFEST restores them along with the files.
+  auto record = edit;
+  AddCounters(&record);
+
+  if (manifest_ == nullptr ||
+      manifest_->Size() >= options_.max_manifest_file_size) {
+    WriteSnapshot(*version, record, ec);
+  } else {
+    std::string contents;
+    record.EncodeTo(&contents);
+    AppendToManifest(contents, ec);
+  }
+
+  if (ec) {
+    return;
+  }
+
+  ApplyCounters(record);
+  current_ = std::move(version);
+}
+
+void VersionSet::SortFiles(Version* version) {
+  // Level 0 is searched from the newest data down. Compactions may write
+  // files with larger numbers holding older data, so the order follows the
+  // sequence numbers.
+  std::sort(version->files_[0].begin(), version->files_[0].end(),
+            [](const auto& a, const auto& b) {
+              return a->largest_sequence != b->largest_sequence
+                         ? a->largest_sequence > b->largest_sequence
+                         : a->number > b->number;
+            });
+
+  for (int level = 1; level < version->NumLevels(); ++level) {
+    std::sort(version->files_[level].begin(), version->files_[level].end(),
+              [](const auto& a, const auto& b) {
+                return InternalKeyComparator{}(a->smallest, b->smallest) < 0;
+              });
+  }
+}
+
+void VersionSet::AddCounters(VersionEdit* edit) const {
+  auto last_sequence =
+      std::max(last_sequence_, edit->last_sequence.value_or(0));
+
+  for (const auto& [level, file] : edit->new_files) {
+    last_sequence = std::max(last_sequence, file->largest_sequence);
+  }
+
+  edit->next_file_number = next_file_number_;
+  edit->last_sequence = last_sequence;
+
+  if (!edit->min_wal_segment_id.has_value()) {
+    edit->min_wal_segment_id = min_wal_segment_id_;
+  }
+
+  if (!edit->next_wal_segment_id.has_value()) {
+    edit->next_wal_segment_id = next_wal_segment_id_;
+  }
+}
+
+void VersionSet::ApplyCounters(const VersionEdit& edit) {
+  // Numbers are handed out before the edits recording them are applied,
+  // and none of the counters ever moves back.
+  next_file_number_ =
+      std::max(next_file_number_, edit.next_file_number.value_or(0));
+  last_sequence_ = std::max(last_sequence_, edit.last_sequence.value_or(0));
+  min_wal_segment_id_ =
+      std::max(min_wal_segment_id_, edit.min_wal_segment_id.value_or(0));
+  next_wal_segment_id_ =
+      std::max(next_wal_segment_id_, edit.next_wal_segment_id.value_or(0));
+}
+
+void VersionSet::ReplayManifest(std::unordered_map<uint64_t, int>* levels,
+                                std::error_code& ec) {
+  auto current_path = db_path_.Append(kCurrentFileName);
+  kiwi::File current{current_path,
+                     kiwi::File::kFlagOpen | kiwi::File::kFlagRead};
+  auto length = current.GetLength();
+  std::string contents(std::max<int64_t>(length, 0), '\0');
+
+  if (!current.IsValid() || length < 0 ||
+      current.Read(0, contents.data(), contents.size()) != length) {
+    LOG(ERROR) << "Failed to read: " << current_path;
+    ec = make_error_code(DBError::kIOError);
+    return;
+  }
+
+  std::optional<uint64_t> number;
+
+  if (contents.ends_with('\n')) {
+    contents.pop_back();
+    number = ParseManifestFileName(contents);
+  }
+
+  if (!number.has_value()) {
+    LOG(ERROR) << "Corrupted: " << current_path;
+    ec = make_error_code(DBError::kCorruption);
+    return;
+  }
+
+  auto path = db_path_.Append(ManifestFileName(*number));
+
+  if (!kiwi::PathExists(path)) {
+    LOG(ERROR) << "Missing MANIFEST: " << path;
+    ec = make_error_code(DBError::kCorruption);
+    return;
+  }
+
+  ManifestSegment manifest{path, kManifestFormat};
+
+  if (!manifest.IsValid()) {
+    LOG(ERROR) << "Failed to open: " << path << ": "
+               << manifest.GetErrorDetail();
+    ec = make_error_code(DBError::kCorruption);
+    return;
+  }
+
+  auto end = static_cast<ManifestSegment::Offset>(manifest.Size());
+  std::size_t num_edits = 0;
+
+  for (auto offset = manifest.FirstRecordOffset(end); offset < end;) {
+    auto next_offset = manifest.NextRecordOffset(offset);
+
+    // Edits are installed once synced, so only the last one may be torn,
+    // and it was never installed.
+    if (!next_offset.has_value()) {
+      LOG(WARNING) << "Ignoring a torn edit at offset: " << offset
+                   << " of: " << path;
+      break;
+    }
+
+    VersionEdit edit;
+
+    if (!edit.DecodeFrom(manifest.ReadAt(offset))) {
+      LOG(ERROR) << "Corrupted edit at offset: " << offset << " of: " << path;
+      ec = make_error_code(DBError::kCorruption);
+      return;
+    }
+
+    for (const auto& [level, number] : edit.deleted_files) {
+      levels->erase(number);
+    }
+
+    for (const auto& [level, file] : edit.new_files) {
+      (*levels)[file->number] = level;
+    }
+
+    ApplyCounters(edit);
+    offset = *next_offset;
+    ++num_edits;
+  }
+
+  manifest_number_ = *number;
+
+  LOG(INFO) << "Replayed " << num_edits << " edits from: " << path;
+}
+
+void VersionSet::WriteSnapshot(const Version& version,
+                               const VersionEdit& counters,
+                               std::error_code& ec) {
+  VersionEdit snapshot;
+  snapshot.next_file_number = counters.next_file_number;
+  snapshot.last_sequence = counters.last_sequence;
+  snapshot.min_wal_segment_id = counters.min_wal_segment_id;
+  snapshot.next_wal_segment_id = counters.next_wal_segment_id;
+
+  for (int level = 0; level < version.NumLevels(); ++level) {
+    for (const auto& file : version.GetFiles(level)) {
+      snapshot.AddFile(level, file);
+    }
+  }
+
+  std::string record;
+  snapshot.EncodeTo(&record);
+
+  auto number = manifest_number_ + 1;
+  auto path = db_path_.Append(ManifestFileName(number));
+
+  // The CURRENT file never names a MANIFEST with a larger number, so one
+  // found there is left over from an interrupted rollover.
+  kiwi::DeleteFile(path);
+
+  auto manifest = std::make_unique<ManifestSegment>(path, kManifestFormat);
+
+  if (!manifest->IsValid()) {
+    LOG(ERROR) << "Failed to create: " << path;
+    ec = make_error_code(DBError::kIOError);
+    return;
+  }
+
+  manifest->Append(Slice{record.data(), record.size()});
+
+  if (!manifest->Sync()) {
+    LOG(ERROR) << "Failed to write: " << path;
+    ec = make_error_code(DBError::kIOError);
+  } else {
+    SetCurrentFile(number, ec);
+  }
+
+  if (ec) {
+    manifest.reset();
+    kiwi::DeleteFile(path);
+    return;
+  }
+
+  auto previous_number = manifest_number_;
+
+  manifest_ = std::move(manifest);
+  manifest_number_ = number;
+
+  // Until the rename is synced, a crash may leave CURRENT naming the
+  // previous MANIFEST, which is then left for the next open to delete.
+  if (!SyncDirectory(db_path_)) {
+    LOG(ERROR) << "Failed to sync directory: " << db_path_;
+    ec = make_error_code(DBError::kIOError);
+
+    // Whether the snapshot survives a crash is unknown, so the next edit
+    // starts a new one.
+    manifest_.reset();
+    return;
+  }
+
+  if (previous_number != 0) {
+    kiwi::DeleteFile(db_path_.Append(ManifestFileName(previous_number)));
+  }
+
+  LOG(INFO) << "Started MANIFEST: " << path << " with a snapshot of "
+            << version.NumFiles() << " tables";
+}
+
+void VersionSet::AppendToManifest(std::string_view record,
+                                  std::error_code& ec) {
+  manifest_->Append(Slice{record.data(), record.size()});
+
+  if (!manifest_->Sync()) {
+    LOG(ERROR) << "Failed to write: "
+               << db_path_.Append(ManifestFileName(manifest_number_));
+    ec = make_error_code(DBError::kIOError);
+
+    // The MANIFEST may end with a part of the record, so the next edit
+    // starts a new one.
+    manifest_.reset();
+  }
+}
+
+void VersionSet::SetCurrentFile(uint64_t number, std::error_code& ec) {
+  auto contents = ManifestFileName(number) + "\n";
+
+  // Renaming a synced file over the previous one replaces it atomically.
+  auto path = db_path_.Append(kCurrentFileName);
+  auto temp_path = db_path_.Append(std::string(kCurrentFileName) +
+                                   std::string(kTempFileExtension));
+  kiwi::File file{temp_path,
+                  kiwi::File::kFlagCreateAlways | kiwi::File::kFlagWrite};
+  kiwi::File::Error error;
+
+  if (!file.IsValid() ||
+      file.WriteAtCurrentPos(contents.data(), contents.size()) !=
+          static_cast<int>(contents.size()) ||
+      !file.Flush()) {
+    LOG(ERROR) << "Failed to write: " << temp_path;
+    ec = make_error_code(DBError::kIOError);
+    return;
+  }
+
+  file.Close();
+
+  if (!kiwi::ReplaceFile(temp_path, path, &error)) {
+    LOG(ERROR) << "Failed to rename: " << temp_path << " to: " << path;
+    ec = make_error_code(DBError::kIOError);
+  }
+}
+
+}  // namespace rosekv
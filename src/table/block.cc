@@ -0,0 +1,131 @@
+#include "rosekv/table/block.hh"
+
+#include "rosekv/db/coding.hh"
+#include "rosekv/db/dbformat.hh"
+
+namespace rosekv {
+
+int CompareInternalKeys(std::string_view a, std::string_view b) {
+  return InternalKeyComparator{}(a, b);
+}
+
+int CompareBytewise(std::string_view a, std::string_view b) {
+  return a.compare(b);
+}
+
+Block::Block(std::string_view contents) : contents_{contents} {
+  ParseRestarts();
+}
+
+Block::Block(std::unique_ptr<char[]> buf, std::size_t size)
+    : owned_{std::move(buf)}, contents_{owned_.get(), size} {
+  ParseRestarts();
+}
+
+void Block::ParseRestarts() {
+  if (contents_.size() < sizeof(uint32_t)) {
+    return;
+  }
+
+  auto num_restarts =
+      DecodeFixed32(contents_.data() + contents_.size() - sizeof(uint32_t));
+  auto max_restarts = contents_.size() / sizeof(uint32_t) - 1;
+
+  if (num_restarts == 0 || num_restarts > max_restarts) {
+    return;
+  }
+
+  num_restarts_ = num_restarts;
+  restarts_offset_ =
+      contents_.size() - (num_restarts + 1) * sizeof(uint32_t);
+}
+
+Block::Iterator::Iterator(const Block* block, KeyComparator cmp)
+    : data_{block->contents_.data()},
+      cmp_{cmp},
+      restarts_offset_{block->restarts_offset_},
+      num_restarts_{block->num_restarts_},
+      current_{restarts_offset_},
+      next_{restarts_offset_} {}
+
+uint32_t Block::Iterator::GetRestartPoint(uint32_t index) const {
+  return DecodeFixed32(data_ + restarts_offset_ + index * sizeof(uint32_t));
+}
+
+void Block::Iterator::SeekToRestartPoint(uint32_t index) {
+  key_.clear();
+  next_ = num_restarts_ == 0 ? restarts_offset_ : GetRestartPoint(index);
+}
+
+void Block::Iterator::Seek(std::string_view target) {
+  if (num_restarts_ == 0) {
+    current_ = restarts_offset_;
+    return;
+  }
+
+  // Find the last restart point whose key is before `target`. Restart keys
+  // are stored in full, so they are compared without decoding any entry.
+  uint32_t left = 0;
+  uint32_t right = num_restarts_ - 1;
+
+  while (left < right) {
+    auto mid = (left + right + 1) / 2;
+    std::string_view input{data_ + GetRestartPoint(mid),
+                           restarts_offset_ - GetRestartPoint(mid)};
+    uint64_t shared, non_shared, value_size;
+
+    if (!GetVarint64(&input, &shared) || !GetVarint64(&input, &non_shared) ||
+        !GetVarint64(&input, &value_size) || shared != 0 ||
+        input.size() < non_shared) {
+      MarkCorrupted();
+      return;
+    }
+
+    if (cmp_(input.substr(0, non_shared), target) < 0) {
+      left = mid;
+    } else {
+      right = mid - 1;
+    }
+  }
+
+  SeekToRestartPoint(left);
+
+  while (ParseNextEntry()) {
+    if (cmp_(key_, target) >= 0) {
+      return;
+    }
+  }
+}
+
+bool Block::Iterator::ParseNextEntry() {
+  current_ = next_;
+
+  if (current_ >= restarts_offset_) {
+    current_ = restarts_offset_;
+    return false;
+  }
+
+  std::string_view input{data_ + current_, restarts_offset_ - current_};
+  uint64_t shared, non_shared, value_size;
+
+  if (!GetVarint64(&input, &shared) || !GetVarint64(&input, &non_shared) ||
+      !GetVarint64(&input, &value_size) || shared > key_.size() ||
+      input.size() < non_shared + value_size) {
+    MarkCorrupted();
+    return false;
+  }
+
+  key_.resize(shared);
+  key_.append(input.substr(0, non_shared));
+  value_ = input.substr(non_shared, value_size);
+  next_ = value_.data() + value_.size() - data_;
+
+  return true;
+}
+
+void Block::Iterator::MarkCorrupted() {
+  corrupted_ = true;
+  current_ = next_ = restarts_offset_;
+}
+
+}  // namespace rosekv
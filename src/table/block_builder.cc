@@ -0,0 +1,59 @@
+#include "rosekv/table/block_builder.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+#include "rosekv/db/coding.hh"
+
+namespace rosekv {
+
+BlockBuilder::BlockBuilder(int restart_interval)
+    : restart_interval_{std::max(restart_interval, 1)}, restarts_{0} {}
+
+void BlockBuilder::Reset() {
+  buffer_.clear();
+  restarts_.assign(1, 0);
+  counter_ = 0;
+  finished_ = false;
+  last_key_.clear();
+}
+
+void BlockBuilder::Add(std::string_view key, std::string_view value) {
+  DCHECK(!finished_);
+
+  std::size_t shared = 0;
+
+  if (counter_ < restart_interval_) {
+    auto limit = std::min(last_key_.size(), key.size());
+
+    while (shared < limit && last_key_[shared] == key[shared]) {
+      ++shared;
+    }
+  } else {
+    restarts_.push_back(buffer_.size());
+    counter_ = 0;
+  }
+
+  PutVarint64(&buffer_, shared);
+  PutVarint64(&buffer_, key.size() - shared);
+  PutVarint64(&buffer_, value.size());
+  buffer_.append(key.substr(shared));
+  buffer_.append(value);
+
+  last_key_.assign(key);
+  ++counter_;
+}
+
+std::string_view BlockBuilder::Finish() {
+  for (auto restart : restarts_) {
+    PutFixed32(&buffer_, restart);
+  }
+
+  PutFixed32(&buffer_, restarts_.size());
+  finished_ = true;
+
+  return buffer_;
+}
+
+}  // namespace rosekv
@@ -0,0 +1,53 @@
+#include "rosekv/table/format.hh"
+
+#include <kiwi/metrics/crc32.hh>
+
+namespace rosekv {
+
+namespace {
+
+/// The number of bytes of the footer covered by its CRC.
+constexpr std::size_t kFooterCrcOffset = 36;
+
+}  // namespace
+
+void Footer::EncodeTo(std::string* dst) const {
+  auto start = dst->size();
+
+  PutFixed64(dst, index.offset);
+  PutFixed64(dst, index.size);
+  PutFixed64(dst, properties.offset);
+  PutFixed64(dst, properties.size);
+  dst->push_back(static_cast<char>(checksum));
+  dst->push_back(static_cast<char>(version));
+  dst->append(2, '\0');
+
+  auto ptr = reinterpret_cast<const uint8_t*>(dst->data() + start);
+  PutFixed32(dst, kiwi::Crc32(0, kiwi::span<const uint8_t>{
+                                     ptr, kFooterCrcOffset}));
+  PutFixed64(dst, kTableMagic);
+}
+
+bool Footer::DecodeFrom(std::string_view input) {
+  if (input.size() != kEncodedLength ||
+      DecodeFixed64(input.data() + 40) != kTableMagic) {
+    return false;
+  }
+
+  auto ptr = reinterpret_cast<const uint8_t*>(input.data());
+
+  if (DecodeFixed32(input.data() + kFooterCrcOffset) !=
+      kiwi::Crc32(0, kiwi::span<const uint8_t>{ptr, kFooterCrcOffset})) {
+    return false;
+  }
+
+  index = {DecodeFixed64(input.data()), DecodeFixed64(input.data() + 8)};
+  properties = {DecodeFixed64(input.data() + 16),
+                DecodeFixed64(input.data() + 24)};
+  checksum = static_cast<ChecksumType>(input[32]);
+  version = static_cast<uint8_t>(input[33]);
+
+  return checksum <= kMaxChecksumType && version == kTableFormatV1;
+}
+
+}  // namespace rosekv
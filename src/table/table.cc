@@ -0,0 +1,330 @@
+#include "rosekv/table/table.hh"
+
+#include <glog/logging.h>
+#include <sys/mman.h>
+
+#include "rosekv/db/error_code.hh"
+
+namespace rosekv {
+
+Table::Table(const kiwi::FilePath& path, const TableOptions& options)
+    : options_{options},
+      file_{path, kiwi::File::kFlagOpen | kiwi::File::kFlagRead} {
+  if (!file_.IsValid()) {
+    LOG(ERROR) << "Failed to open table: " << path << ", error: "
+               << kiwi::File::ErrorToString(file_.ErrorDetails());
+    status_ = make_error_code(DBError::kIOError);
+    return;
+  }
+
+  auto length = file_.GetLength();
+
+  if (length < static_cast<int64_t>(Footer::kEncodedLength)) {
+    LOG(ERROR) << "Table: " << path << " is too short: " << length;
+    status_ = make_error_code(DBError::kCorruption);
+    return;
+  }
+
+  file_size_ = length;
+
+  if (options_.read_mode == TableReadMode::kMmap) {
+    auto ptr = ::mmap(nullptr, file_size_, PROT_READ, MAP_SHARED,
+                      file_.GetPlatformFile(), 0);
+
+    if (ptr == MAP_FAILED) {
+      PLOG(ERROR) << "Failed to map table: " << path;
+      status_ = make_error_code(DBError::kIOError);
+      return;
+    }
+
+    mapped_ = static_cast<const char*>(ptr);
+  }
+
+  char buf[Footer::kEncodedLength];
+  auto footer_data =
+      Read(file_size_ - Footer::kEncodedLength, Footer::kEncodedLength, buf);
+
+  if (!footer_.DecodeFrom(footer_data)) {
+    LOG(ERROR) << "Corrupted footer of table: " << path;
+    status_ = make_error_code(DBError::kCorruption);
+    return;
+  }
+
+  index_block_ = ReadBlock(footer_.index, true, status_);
+
+  if (status_) {
+    return;
+  }
+
+  auto props_block = ReadBlock(footer_.properties, true, status_);
+
+  if (status_) {
+    return;
+  }
+
+  if (!DecodeProperties(props_block)) {
+    LOG(ERROR) << "Corrupted properties of table: " << path;
+    status_ = make_error_code(DBError::kCorruption);
+  }
+}
+
+Table::~Table() {
+  if (mapped_ != nullptr) {
+    ::munmap(const_cast<char*>(mapped_), file_size_);
+  }
+}
+
+std::string_view Table::Read(uint64_t offset, std::size_t n,
+                             char* scratch) const {
+  if (offset + n > file_size_) {
+    return {};
+  }
+
+  if (mapped_ != nullptr) {
+    return {mapped_ + offset, n};
+  }
+
+  if (file_.Read(offset, scratch, n) != static_cast<int>(n)) {
+    return {};
+  }
+
+  return {scratch, n};
+}
+
+Block Table::ReadBlock(const BlockHandle& handle, bool verify,
+                       std::error_code& ec) const {
+  auto n = handle.size + kBlockTrailerSize;
+  std::unique_ptr<char[]> buf;
+
+  if (mapped_ == nullptr) {
+    buf = std::make_unique_for_overwrite<char[]>(n);
+  }
+
+  auto data = Read(handle.offset, n, buf.get());
+
+  if (data.size() != n) {
+    LOG(ERROR) << "Failed to read the table block at: " << handle.offset;
+    ec = make_error_code(DBError::kIOError);
+    return {};
+  }
+
+  auto contents = data.substr(0, handle.size);
+
+  if (verify) {
+    DynamicChecksum checksum{footer_.checksum};
+    checksum.Update(kiwi::span<const uint8_t>{
+        reinterpret_cast<const uint8_t*>(contents.data()), contents.size()});
+
+    if (checksum.Digest() != DecodeFixed32(data.data() + handle.size)) {
+      LOG(ERROR) << "Checksum mismatch of the table block at: "
+                 << handle.offset;
+      ec = make_error_code(DBError::kCorruption);
+      return {};
+    }
+  }
+
+  Block block = buf ? Block{std::move(buf), handle.size} : Block{contents};
+
+  if (!block.IsValid()) {
+    LOG(ERROR) << "Malformed table block at: " << handle.offset;
+    ec = make_error_code(DBError::kCorruption);
+    return {};
+  }
+
+  return block;
+}
+
+bool Table::DecodeProperties(const Block& block) {
+  auto iter = block.NewIterator(CompareBytewise);
+
+  for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+    auto name = iter.key();
+    auto value = iter.value();
+    uint64_t* field = nullptr;
+
+    if (name == kPropSmallestKey) {
+      props_.smallest_key.assign(value);
+    } else if (name == kPropLargestKey) {
+      props_.largest_key.assign(value);
+    } else if (name == kPropDataSize) {
+      field = &props_.data_size;
+    } else if (name == kPropIndexSize) {
+      field = &props_.index_size;
+    } else if (name == kPropMaxSequence) {
+      field = &props_.max_sequence;
+    } else if (name == kPropNumDataBlocks) {
+      field = &props_.num_data_blocks;
+    } else if (name == kPropNumEntries) {
+      field = &props_.num_entries;
+    } else if (name == kPropRawKeySize) {
+      field = &props_.raw_key_size;
+    } else if (name == kPropRawValueSize) {
+      field = &props_.raw_value_size;
+    }
+
+    // Unknown properties are skipped, for newer writers to add some.
+    if (field != nullptr && !GetVarint64(&value, field)) {
+      return false;
+    }
+  }
+
+  return !iter.IsCorrupted();
+}
+
+uint64_t Table::ApproximateOffsetOf(std::string_view key) const {
+  auto index_iter = index_block_.NewIterator(CompareInternalKeys);
+  index_iter.Seek(key);
+
+  if (index_iter.Valid()) {
+    BlockHandle handle;
+    auto encoded_handle = index_iter.value();
+
+    if (handle.DecodeFrom(&encoded_handle)) {
+      return handle.offset;
+    }
+  }
+
+  // The index block follows the last data block.
+  return footer_.index.offset;
+}
+
+LookupResult Table::Get(std::string_view user_key, SequenceNumber sequence,
+                        std::string* value, std::error_code& ec) const {
+  std::string target;
+  AppendInternalKey(&target, user_key, sequence, kValueTypeForSeek);
+
+  // The first block whose last key is at or after the target holds the
+  // first entry at or after it, if any block does.
+  auto index_iter = index_block_.NewIterator(CompareInternalKeys);
+  index_iter.Seek(target);
+
+  if (!index_iter.Valid()) {
+    if (index_iter.IsCorrupted()) {
+      ec = make_error_code(DBError::kCorruption);
+    }
+
+    return LookupResult::kNotFound;
+  }
+
+  BlockHandle handle;
+  auto encoded_handle = index_iter.value();
+
+  if (!handle.DecodeFrom(&encoded_handle)) {
+    ec = make_error_code(DBError::kCorruption);
+    return LookupResult::kNotFound;
+  }
+
+  auto block = ReadBlock(handle, options_.verify_checksums, ec);
+
+  if (ec) {
+    return LookupResult::kNotFound;
+  }
+
+  auto iter = block.NewIterator(CompareInternalKeys);
+  iter.Seek(target);
+
+  ParsedInternalKey parsed;
+
+  if (!iter.Valid()) {
+    if (iter.IsCorrupted()) {
+      ec = make_error_code(DBError::kCorruption);
+    }
+
+    return LookupResult::kNotFound;
+  }
+
+  if (!ParseInternalKey(iter.key(), &parsed)) {
+    ec = make_error_code(DBError::kCorruption);
+    return LookupResult::kNotFound;
+  }
+
+  if (parsed.user_key != user_key) {
+    return LookupResult::kNotFound;
+  }
+
+  if (parsed.type == ValueType::kDeletion) {
+    return LookupResult::kDeleted;
+  }
+
+  value->assign(iter.value());
+
+  return LookupResult::kFound;
+}
+
+Table::Iterator::Iterator(const Table* table)
+    : table_{table},
+      index_iter_{table->index_block_.NewIterator(CompareInternalKeys)} {}
+
+void Table::Iterator::SeekToFirst() {
+  index_iter_.SeekToFirst();
+  InitDataBlock();
+
+  if (data_iter_ != nullptr) {
+    data_iter_->SeekToFirst();
+  }
+
+  SkipEmptyDataBlocks();
+}
+
+void Table::Iterator::Seek(std::string_view target) {
+  index_iter_.Seek(target);
+  InitDataBlock();
+
+  if (data_iter_ != nullptr) {
+    data_iter_->Seek(target);
+  }
+
+  SkipEmptyDataBlocks();
+}
+
+void Table::Iterator::Next() {
+  data_iter_->Next();
+  SkipEmptyDataBlocks();
+}
+
+void Table::Iterator::InitDataBlock() {
+  data_iter_.reset();
+
+  if (!index_iter_.Valid()) {
+    if (index_iter_.IsCorrupted()) {
+      status_ = make_error_code(DBError::kCorruption);
+    }
+
+    return;
+  }
+
+  BlockHandle handle;
+  auto encoded_handle = index_iter_.value();
+
+  if (!handle.DecodeFrom(&encoded_handle)) {
+    status_ = make_error_code(DBError::kCorruption);
+    return;
+  }
+
+  data_block_ =
+      table_->ReadBlock(handle, table_->options_.verify_checksums, status_);
+
+  if (!status_) {
+    data_iter_ = std::make_unique<Block::Iterator>(
+        data_block_.NewIterator(CompareInternalKeys));
+  }
+}
+
+void Table::Iterator::SkipEmptyDataBlocks() {
+  while (data_iter_ != nullptr && !data_iter_->Valid()) {
+    if (data_iter_->IsCorrupted()) {
+      status_ = make_error_code(DBError::kCorruption);
+      data_iter_.reset();
+      return;
+    }
+
+    index_iter_.Next();
+    InitDataBlock();
+
+    if (data_iter_ != nullptr) {
+      data_iter_->SeekToFirst();
+    }
+  }
+}
+
+}  // namespace rosekv
@@ -0,0 +1,153 @@
+#include "rosekv/table/table_builder.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+#include "rosekv/db/dbformat.hh"
+#include "rosekv/db/error_code.hh"
+
+namespace rosekv {
+
+TableBuilder::TableBuilder(const TableOptions& options,
+                           const kiwi::FilePath& path)
+    : options_{options},
+      file_{path, kiwi::File::kFlagCreateAlways | kiwi::File::kFlagWrite},
+      data_block_{options.block_restart_interval},
+      // Index lookups binary search every entry.
+      index_block_{1} {
+  if (!file_.IsValid()) {
+    LOG(ERROR) << "Failed to create table: " << path << ", error: "
+               << kiwi::File::ErrorToString(file_.ErrorDetails());
+    status_ = make_error_code(DBError::kIOError);
+  }
+}
+
+void TableBuilder::Add(std::string_view key, std::string_view value) {
+  DCHECK(!finished_);
+  DCHECK(props_.num_entries == 0 || InternalKeyComparator{}(last_key_, key) < 0)
+      << "Keys must be added in increasing order";
+
+  if (status_) {
+    return;
+  }
+
+  if (props_.num_entries == 0) {
+    props_.smallest_key.assign(key);
+  }
+
+  data_block_.Add(key, value);
+  last_key_.assign(key);
+  ++props_.num_entries;
+  props_.raw_key_size += key.size();
+  props_.raw_value_size += value.size();
+  props_.max_sequence = std::max(props_.max_sequence, ExtractTag(key) >> 8);
+
+  if (data_block_.CurrentSizeEstimate() >=
+      static_cast<std::size_t>(options_.block_size)) {
+    FlushDataBlock();
+  }
+}
+
+void TableBuilder::FlushDataBlock() {
+  if (data_block_.empty()) {
+    return;
+  }
+
+  auto handle = WriteBlock(data_block_.Finish());
+  data_block_.Reset();
+
+  // The last key of a block is the smallest key at or after everything in
+  // it, so a lookup goes to the first block whose index key is not less
+  // than its target.
+  std::string encoded_handle;
+  handle.EncodeTo(&encoded_handle);
+  index_block_.Add(last_key_, encoded_handle);
+
+  ++props_.num_data_blocks;
+  props_.data_size += handle.size + kBlockTrailerSize;
+}
+
+BlockHandle TableBuilder::WriteBlock(std::string_view contents) {
+  BlockHandle handle{offset_, contents.size()};
+
+  DynamicChecksum checksum{options_.checksum};
+  checksum.Update(kiwi::span<const uint8_t>{
+      reinterpret_cast<const uint8_t*>(contents.data()), contents.size()});
+
+  std::string trailer;
+  PutFixed32(&trailer, checksum.Digest());
+
+  for (auto data : {contents, std::string_view{trailer}}) {
+    if (status_) {
+      break;
+    }
+
+    if (file_.WriteAtCurrentPos(data.data(), data.size()) !=
+        static_cast<int>(data.size())) {
+      LOG(ERROR) << "Failed to write a table block at: " << offset_;
+      status_ = make_error_code(DBError::kIOError);
+    }
+
+    offset_ += data.size();
+  }
+
+  return handle;
+}
+
+std::string TableBuilder::EncodeProperties() const {
+  auto varint = [](uint64_t value) {
+    std::string encoded;
+    PutVarint64(&encoded, value);
+
+    return encoded;
+  };
+
+  // Block entries must be sorted, and so are the property names.
+  BlockBuilder block{1};
+  block.Add(kPropDataSize, varint(props_.data_size));
+  block.Add(kPropIndexSize, varint(props_.index_size));
+  block.Add(kPropLargestKey, props_.largest_key);
+  block.Add(kPropMaxSequence, varint(props_.max_sequence));
+  block.Add(kPropNumDataBlocks, varint(props_.num_data_blocks));
+  block.Add(kPropNumEntries, varint(props_.num_entries));
+  block.Add(kPropRawKeySize, varint(props_.raw_key_size));
+  block.Add(kPropRawValueSize, varint(props_.raw_value_size));
+  block.Add(kPropSmallestKey, props_.smallest_key);
+
+  return std::string(block.Finish());
+}
+
+void TableBuilder::Finish(std::error_code& ec) {
+  DCHECK(!finished_);
+
+  FlushDataBlock();
+  props_.largest_key = last_key_;
+
+  Footer footer;
+  footer.checksum = options_.checksum;
+  footer.index = WriteBlock(index_block_.Finish());
+  props_.index_size = footer.index.size + kBlockTrailerSize;
+  footer.properties = WriteBlock(EncodeProperties());
+
+  std::string encoded_footer;
+  footer.EncodeTo(&encoded_footer);
+
+  if (!status_) {
+    if (file_.WriteAtCurrentPos(encoded_footer.data(),
+                                encoded_footer.size()) !=
+            static_cast<int>(encoded_footer.size()) ||
+        !file_.Flush()) {
+      LOG(ERROR) << "Failed to write the table footer";
+      status_ = make_error_code(DBError::kIOError);
+    }
+
+    offset_ += encoded_footer.size();
+  }
+
+  file_.Close();
+  finished_ = true;
+  ec = status_;
+}
+
+}  // namespace rosekv
@@ -0,0 +1,388 @@
+#include "rosekv/wal/replication.hh"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <kiwi/io/file_enumerator.hh>
+#include <kiwi/io/file_util.hh>
+#include <kiwi/util/byte_order.hh>
+
+#include "rosekv/wal/error_code.hh"
+#include "rosekv/wal/segment_catalog.hh"
+#include "rosekv/wal/wal.hh"
+
+namespace rosekv {
+
+namespace {
+
+constexpr std::size_t kFrameHeaderSize = 16;
+constexpr std::size_t kAckSize = 8;
+
+/// How long the sender waits for new writes before rechecking whether it
+/// has been stopped.
+constexpr std::chrono::milliseconds kPollInterval{100};
+
+/// \return The number of bytes read, which is less than `len` only if the
+///         peer closed the connection, or -1 on error.
+ssize_t ReadFully(int fd, void* buf, std::size_t len) {
+  auto ptr = static_cast<char*>(buf);
+  std::size_t total = 0;
+
+  while (total < len) {
+    auto n = ::recv(fd, ptr + total, len - total, 0);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return n < 0 ? -1 : total;
+    }
+
+    total += n;
+  }
+
+  return total;
+}
+
+bool WriteFully(int fd, const void* buf, std::size_t len) {
+  auto ptr = static_cast<const char*>(buf);
+
+  while (len > 0) {
+    auto n = ::send(fd, ptr, len, MSG_NOSIGNAL);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return false;
+    }
+
+    ptr += n;
+    len -= n;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+ReplicationSender::ReplicationSender(WAL* wal, int fd,
+                                     std::size_t max_inflight_blocks)
+    : wal_{wal},
+      fd_{fd},
+      max_inflight_blocks_{std::max<std::size_t>(max_inflight_blocks, 1)} {}
+
+ReplicationSender::~ReplicationSender() {
+  Stop();
+  ::close(fd_);
+}
+
+void ReplicationSender::Start(std::error_code& ec) {
+  uint8_t ack[kAckSize];
+
+  // The follower starts by telling us how much of the log it already has.
+  if (ReadFully(fd_, ack, sizeof(ack)) != kAckSize) {
+    ec = rosekv::make_error_code(WALError::kIOError);
+    return;
+  }
+
+  auto from_lsn = LSN::FromValue(kiwi::LittleEndian::Uint64(ack));
+
+  if (!from_lsn.IsValid()) {
+    from_lsn = wal_->GetBeginLSN();
+  }
+
+  acked_lsn_ = from_lsn;
+  send_thread_ = std::thread{&ReplicationSender::SendLoop, this, from_lsn};
+  ack_thread_ = std::thread{&ReplicationSender::AckLoop, this};
+}
+
+void ReplicationSender::Stop() {
+  {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+    stopped_ = true;
+  }
+
+  cv_.notify_all();
+
+  // Unblocks the ack thread waiting on the socket.
+  ::shutdown(fd_, SHUT_RDWR);
+
+  if (send_thread_.joinable()) {
+    send_thread_.join();
+  }
+
+  if (ack_thread_.joinable()) {
+    ack_thread_.join();
+  }
+}
+
+LSN ReplicationSender::GetAckedLSN() {
+  std::lock_guard<std::mutex> lk_guard{mtx_};
+
+  return acked_lsn_;
+}
+
+bool ReplicationSender::WaitForAck(LSN lsn, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lk_guard{mtx_};
+
+  return cv_.wait_for(lk_guard, timeout,
+                      [&] { return lsn <= acked_lsn_ || stopped_; }) &&
+         lsn <= acked_lsn_;
+}
+
+std::error_code ReplicationSender::Status() {
+  std::lock_guard<std::mutex> lk_guard{mtx_};
+
+  return status_;
+}
+
+void ReplicationSender::SendLoop(LSN from_lsn) {
+  std::vector<char> frame;
+  LSN lsn = from_lsn;
+  SegmentId block_size_id = 0;
+  int64_t block_size = 0;
+
+  while (true) {
+    {
+      // Pipelining: keep sending until too many frames are unacknowledged.
+      std::unique_lock<std::mutex> lk_guard{mtx_};
+      cv_.wait(lk_guard, [this] {
+        return stopped_ || inflight_.size() < max_inflight_blocks_;
+      });
+
+      if (stopped_) {
+        return;
+      }
+    }
+
+    std::error_code ec;
+
+    // Segments keep the block size they were created with.
+    if (lsn.GetSegmentId() != block_size_id) {
+      block_size = wal_->GetBlockSize(lsn.GetSegmentId(), ec);
+
+      if (ec) {
+        Fail(ec);
+        return;
+      }
+
+      block_size_id = lsn.GetSegmentId();
+      frame.resize(kFrameHeaderSize + block_size);
+    }
+
+    // Never let a frame cross a block boundary.
+    auto offset = lsn.GetOffset();
+    auto len = block_size - offset % block_size;
+    auto data = frame.data() + kFrameHeaderSize;
+    auto nbytes = wal_->ReadRaw(lsn, kiwi::span(data, len), ec);
+
+    if (ec) {
+      Fail(ec);
+      return;
+    }
+
+    if (nbytes == 0) {
+      // A segment older than the active one is sealed and will not grow.
+      if (lsn.GetSegmentId() < wal_->GetEndLSN().GetSegmentId()) {
+        lsn = {lsn.GetSegmentId() + 1, 0};
+      } else {
+        wal_->WaitForWrite(lsn, kPollInterval);
+      }
+
+      continue;
+    }
+
+    auto header = reinterpret_cast<uint8_t*>(frame.data());
+    kiwi::LittleEndian::PutUint64(header, lsn.GetSegmentId());
+    kiwi::LittleEndian::PutUint32(header + 8, offset);
+    kiwi::LittleEndian::PutUint32(header + 12, nbytes);
+
+    lsn = {lsn.GetSegmentId(), offset + nbytes};
+
+    {
+      std::lock_guard<std::mutex> lk_guard{mtx_};
+      inflight_.push_back(lsn);
+    }
+
+    if (!WriteFully(fd_, frame.data(), kFrameHeaderSize + nbytes)) {
+      Fail(rosekv::make_error_code(WALError::kIOError));
+      return;
+    }
+  }
+}
+
+void ReplicationSender::AckLoop() {
+  uint8_t ack[kAckSize];
+
+  while (ReadFully(fd_, ack, sizeof(ack)) == kAckSize) {
+    auto lsn = LSN::FromValue(kiwi::LittleEndian::Uint64(ack));
+
+    {
+      std::lock_guard<std::mutex> lk_guard{mtx_};
+      acked_lsn_ = std::max(acked_lsn_, lsn);
+
+      while (!inflight_.empty() && inflight_.front() <= acked_lsn_) {
+        inflight_.pop_front();
+      }
+    }
+
+    cv_.notify_all();
+  }
+
+  Fail(rosekv::make_error_code(WALError::kIOError));
+}
+
+void ReplicationSender::Fail(std::error_code ec) {
+  {
+    std::lock_guard<std::mutex> lk_guard{mtx_};
+
+    // Errors caused by `Stop()` shutting the socket down are not failures.
+    if (stopped_) {
+      return;
+    }
+
+    status_ = ec;
+    stopped_ = true;
+  }
+
+  LOG(ERROR) << "Replication stopped: " << ec.message();
+  cv_.notify_all();
+  ::shutdown(fd_, SHUT_RDWR);
+}
+
+ReplicationReceiver::ReplicationReceiver(std::string wal_dir, int fd)
+    : wal_dir_{std::move(wal_dir)}, fd_{fd} {
+  auto path = kiwi::FilePath::FromASCII(wal_dir_);
+  kiwi::File::Error error;
+
+  if (!kiwi::CreateDirectoryAndGetError(path, &error)) {
+    LOG(ERROR) << "Failed to create directory: " << path;
+    return;
+  }
+
+  // Resume after the newest segment we already have.
+  kiwi::FileEnumerator file_iter(path, false, kiwi::FileEnumerator::kFiles);
+  SegmentId last_id = 0;
+
+  for (auto fp = file_iter.Next(); !fp.empty(); fp = file_iter.Next()) {
+    auto id = SegmentCatalog::ParseSegmentFileName(fp.BaseName().value());
+    last_id = std::max(last_id, id.value_or(0));
+  }
+
+  if (last_id != 0 && OpenSegment(last_id)) {
+    durable_lsn_ = LSN(last_id, segment_->Size());
+  }
+}
+
+ReplicationReceiver::~ReplicationReceiver() { ::close(fd_); }
+
+void ReplicationReceiver::Run(std::error_code& ec) {
+  if (!SendAck()) {
+    ec = rosekv::make_error_code(WALError::kIOError);
+    return;
+  }
+
+  while (true) {
+    uint8_t header[kFrameHeaderSize];
+    auto n = ReadFully(fd_, header, sizeof(header));
+
+    // The leader closed the connection.
+    if (n == 0) {
+      return;
+    }
+
+    if (n != kFrameHeaderSize) {
+      ec = rosekv::make_error_code(WALError::kIOError);
+      return;
+    }
+
+    SegmentId id = kiwi::LittleEndian::Uint64(header);
+    Segment::Offset offset = kiwi::LittleEndian::Uint32(header + 8);
+    std::size_t len = kiwi::LittleEndian::Uint32(header + 12);
+
+    // A new segment starts at its beginning and directly follows ours.
+    if (segment_ == nullptr || id != segment_id_) {
+      if (offset != 0 || (segment_ != nullptr && id != segment_id_ + 1)) {
+        ec = rosekv::make_error_code(WALError::kReplicationProtocol);
+        return;
+      }
+
+      if (!OpenSegment(id)) {
+        ec = rosekv::make_error_code(WALError::kIOError);
+        return;
+      }
+    }
+
+    if (offset != static_cast<Segment::Offset>(segment_->Size())) {
+      ec = rosekv::make_error_code(WALError::kReplicationProtocol);
+      return;
+    }
+
+    // A frame never crosses a block boundary of the segment. The block size
+    // is only known once the segment header, sent first, is stored.
+    auto max_len = offset == 0
+                       ? Segment::kMaxV2BlockSize
+                       : segment_->BlockSize() - offset % segment_->BlockSize();
+
+    if (len == 0 || static_cast<int64_t>(len) > max_len) {
+      ec = rosekv::make_error_code(WALError::kReplicationProtocol);
+      return;
+    }
+
+    if (buffer_.size() < len) {
+      buffer_.resize(len);
+    }
+
+    if (ReadFully(fd_, buffer_.data(), len) != static_cast<ssize_t>(len)) {
+      ec = rosekv::make_error_code(WALError::kIOError);
+      return;
+    }
+
+    if (!segment_->AppendRaw(kiwi::span(buffer_.data(), len)) ||
+        !segment_->Sync()) {
+      ec = rosekv::make_error_code(WALError::kIOError);
+      return;
+    }
+
+    durable_lsn_ = LSN(id, offset + len);
+
+    if (!SendAck()) {
+      ec = rosekv::make_error_code(WALError::kIOError);
+      return;
+    }
+  }
+}
+
+bool ReplicationReceiver::OpenSegment(SegmentId id) {
+  auto path = kiwi::FilePath::FromASCII(wal_dir_).Append(
+      SegmentCatalog::SegmentFileName(id));
+
+  if (segment_ != nullptr) {
+    segment_->Close();
+  }
+
+  segment_ = std::make_unique<Segment>(path);
+  segment_id_ = id;
+
+  if (!segment_->IsValid()) {
+    LOG(ERROR) << "Failed to open segment: " << path << ": "
+               << segment_->GetErrorDetail();
+
+    return false;
+  }
+
+  return true;
+}
+
+bool ReplicationReceiver::SendAck() {
+  uint8_t ack[kAckSize];
+  kiwi::LittleEndian::PutUint64(ack, durable_lsn_.load().Value());
+
+  return WriteFully(fd_, ack, sizeof(ack));
+}
+
+}  // namespace rosekv
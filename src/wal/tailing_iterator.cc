@@ -0,0 +1,96 @@
+#include "rosekv/wal/tailing_iterator.hh"
+
+#include <algorithm>
+
+#include "rosekv/wal/wal.hh"
+
+namespace rosekv {
+
+TailingIterator::TailingIterator(WAL* wal, LSN from_lsn)
+    : wal_{wal}, next_lsn_{from_lsn} {
+  std::lock_guard<std::mutex> lk_guard{wal_->tail_mtx_};
+  ++wal_->num_subscribers_;
+}
+
+TailingIterator::~TailingIterator() {
+  std::lock_guard<std::mutex> lk_guard{wal_->tail_mtx_};
+
+  // Stop buffering records once nobody is listening anymore.
+  if (--wal_->num_subscribers_ == 0) {
+    wal_->tail_records_.clear();
+    wal_->tail_bytes_ = 0;
+  }
+}
+
+bool TailingIterator::Next(std::error_code& ec) { return Next(nullptr, ec); }
+
+bool TailingIterator::Next(std::chrono::milliseconds timeout,
+                           std::error_code& ec) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  return Next(&deadline, ec);
+}
+
+bool TailingIterator::Next(
+    const std::chrono::steady_clock::time_point* deadline,
+    std::error_code& ec) {
+  {
+    std::unique_lock<std::mutex> lk_guard{wal_->tail_mtx_};
+    auto ready = [this] {
+      return wal_->closing_ || next_lsn_ < wal_->end_lsn_;
+    };
+
+    if (deadline == nullptr) {
+      wal_->tail_cv_.wait(lk_guard, ready);
+    } else if (!wal_->tail_cv_.wait_until(lk_guard, *deadline, ready)) {
+      return false;
+    }
+
+    if (wal_->closing_) {
+      return false;
+    }
+
+    // The tail holds every record written since it was last empty, so if it
+    // starts at or before the expected LSN, the next record is in memory.
+    const auto& tail = wal_->tail_records_;
+
+    if (!tail.empty() && tail.front().lsn <= next_lsn_) {
+      auto it = std::lower_bound(
+          tail.begin(), tail.end(), next_lsn_,
+          [](const auto& record, LSN lsn) { return record.lsn < lsn; });
+
+      if (it != tail.end()) {
+        lsn_ = it->lsn;
+        next_lsn_ = it->next_lsn;
+        data_ = it->data;
+
+        return true;
+      }
+    }
+  }
+
+  // We have fallen behind the in-memory tail, so read from the segments.
+  LSN lsn;
+  LSN next_lsn;
+  auto data = wal_->ReadRecord(next_lsn_, &lsn, &next_lsn, ec);
+
+  // The previous record was the last one starting in its segment. Segments
+  // in the middle of a large record hold no record start at all.
+  for (auto id = next_lsn_.GetSegmentId();
+       ec == make_error_code(WALError::kInvalidOffset);) {
+    ec.clear();
+    data = wal_->ReadRecord({++id, 0}, &lsn, &next_lsn, ec);
+  }
+
+  if (ec) {
+    return false;
+  }
+
+  lsn_ = lsn;
+  next_lsn_ = next_lsn;
+  data_ = std::make_shared<const std::string>(std::move(data));
+
+  return true;
+}
+
+}  // namespace rosekv
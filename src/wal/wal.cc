@@ -1,11 +1,45 @@
 #include "rosekv/wal/wal.hh"
 
+#include <algorithm>
 #include <kiwi/io/file_enumerator.hh>
 #include <kiwi/io/file_util.hh>
 
 namespace rosekv {
 
-WAL::WAL(const Options& options) : options_{options} {
+WAL::WAL(const Options& options)
+    : options_{options}, segment_cache_{options.max_open_segments} {
+  reclaim_thread_ = std::thread{&WAL::ReclaimSegments, this};
+
+  // An LSN only has room for 32-bit offsets within a segment.
+  if (options_.max_segment_sz > LSN::kMaxOffset) {
+    LOG(WARNING) << "max_segment_sz: " << options_.max_segment_sz
+                 << " exceeds the LSN offset range, clamp it to: "
+                 << LSN::kMaxOffset;
+    options_.max_segment_sz = LSN::kMaxOffset;
+  }
+
+  // A fresh segment must have room for its header and a chunk.
+  if (options_.max_segment_sz < Segment::kMinBlockSize) {
+    LOG(WARNING) << "max_segment_sz: " << options_.max_segment_sz
+                 << " is too small, raise it to: " << Segment::kMinBlockSize;
+    options_.max_segment_sz = Segment::kMinBlockSize;
+  }
+
+  if (options_.block_size < Segment::kMinBlockSize ||
+      options_.block_size > Segment::kMaxV2BlockSize) {
+    auto block_size = std::clamp(options_.block_size, Segment::kMinBlockSize,
+                                 Segment::kMaxV2BlockSize);
+    LOG(WARNING) << "block_size: " << options_.block_size
+                 << " is out of range, clamp it to: " << block_size;
+    options_.block_size = block_size;
+  }
+
+  if (options_.checksum > kMaxChecksumType) {
+    LOG(WARNING) << "checksum: " << static_cast<int>(options_.checksum)
+                 << " is unknown, fall back to CRC32";
+    options_.checksum = ChecksumType::kCrc32;
+  }
+
   auto path = kiwi::FilePath::FromASCII(options.wal_dir);
 
   if (kiwi::CreateDirectoryAndGetError(path, &error_)) {
@@ -13,60 +47,501 @@ WAL::WAL(const Options& options) : options_{options} {
   }
 
   if (error_ != kiwi::File::kFileOk) {
+    status_ = rosekv::make_error_code(WALError::kIOError);
     return;
   }
 
   // We only traverse the files and skip directories.
   kiwi::FileEnumerator file_iter(path, false, kiwi::FileEnumerator::kFiles);
 
-  // Load all the segments from the disk.
+  // Catalog all the segments on the disk without opening them. Sealed
+  // segments are opened lazily on their first read.
   for (auto fp = file_iter.Next(); !fp.empty(); fp = file_iter.Next()) {
-    auto ext = fp.Extension();
+    auto basename = fp.BaseName().value();
 
-    if (ext == kDefSegFileExtension) {
-      segments_.emplace(fp.BaseName(), std::make_unique<Segment>(fp));
+    if (auto id = SegmentCatalog::ParseSegmentFileName(basename)) {
+      segments_.Add(*id, fp);
     } else {
-      LOG(INFO) << "File: " << fp << " with unsupported extension: " << ext;
+      LOG(INFO) << "File: " << fp << " is not a segment file, skip it.";
     }
   }
+
+  if (!segments_.Seal()) {
+    status_ = rosekv::make_error_code(WALError::kNonContiguousSegments);
+    return;
+  }
+
+  if (segments_.Empty()) {
+    next_segment_id_ = std::max<SegmentId>(options_.first_segment_id, 1);
+    NewSegment();
+  } else {
+    // Only the active segment is opened eagerly since it takes the writes.
+    next_segment_id_ = segments_.LastId() + 1;
+    active_segment_ = std::make_shared<Segment>(
+        segments_.Find(segments_.LastId())->path, GetSegmentFormat());
+  }
+
+  end_lsn_ = LSN(segments_.LastId(), active_segment_->Size());
+}
+
+WAL::~WAL() {
+  {
+    std::lock_guard<std::mutex> lk_guard{tail_mtx_};
+    closing_ = true;
+  }
+
+  tail_cv_.notify_all();
+
+  {
+    std::lock_guard<std::mutex> lk_guard{reclaim_mtx_};
+    stop_reclaim_thread_ = true;
+  }
+
+  reclaim_cv_.notify_one();
+  reclaim_thread_.join();
 }
 
 void WAL::Sync() {}
 
-void WAL::Write(Slice data, std::error_code& ec) {
+LSN WAL::Write(Slice data, std::error_code& ec) {
+  return WriteV(kiwi::span<const Slice>(&data, 1), ec);
+}
+
+LSN WAL::WriteV(kiwi::span<const Slice> slices, std::error_code& ec) {
   std::lock_guard<std::shared_mutex> lk_guard{wal_rw_mtx_};
 
-  if (data.size() > options_.max_segment_sz - Segment::kChunkHeaderSize) {
-    ec = rosekv::make_error_code(WALError::kTooLargeData);
-    return;
+  if (status_) {
+    ec = status_;
+    return {};
   }
 
+  std::size_t size = 0;
+
+  for (const auto& slice : slices) {
+    size += slice.size();
+  }
+
+  // Whatever does not fit in the active segment continues in new segments,
+  // so neither the record size is capped nor segment tails are wasted.
+  std::vector<Slice> rest{slices.begin(), slices.end()};
   auto seg = GetActiveSegment();
-  auto req_space = Segment::ComputeRequiredSpace(data);
+  LSN lsn;
+
+  while (true) {
+    std::size_t nbytes = 0;
+    auto offset = seg->AppendPartial(rest, lsn.IsValid(),
+                                     options_.max_segment_sz - seg->Size(),
+                                     &nbytes);
+
+    if (offset && !lsn.IsValid()) {
+      lsn = {segments_.LastId(), *offset};
+    }
+
+    // Drop the bytes appended from the front of the slices.
+    auto it = rest.begin();
+
+    for (; it != rest.end() && nbytes >= it->size(); ++it) {
+      nbytes -= it->size();
+    }
+
+    rest.erase(rest.begin(), it);
+
+    if (!rest.empty()) {
+      rest.front() = rest.front().subspan(nbytes);
+    } else if (offset) {
+      break;
+    }
 
-  if (req_space > options_.max_segment_sz - seg->Size()) {
     seg = NewSegment();
   }
 
-  seg->Append(data);
-  UpdateIOStat(data.size());
+  UpdateIOStat(size);
 
   if (NeedSync()) {
     seg->Sync();
   }
+
+  AppendToTail(lsn, slices);
+
+  return lsn;
+}
+
+std::string WAL::Read(LSN lsn, std::error_code& ec) {
+  return ReadRecord(lsn, nullptr, nullptr, ec);
+}
+
+std::unique_ptr<TailingIterator> WAL::Subscribe(LSN from_lsn) {
+  if (!from_lsn.IsValid()) {
+    from_lsn = GetBeginLSN();
+  }
+
+  return std::make_unique<TailingIterator>(this, from_lsn);
+}
+
+std::string WAL::ReadRecord(LSN lsn, LSN* record_lsn, LSN* next_lsn,
+                            std::error_code& ec) {
+  std::shared_ptr<Segment> seg;
+  Segment::Offset size = 0;
+
+  {
+    std::shared_lock<std::shared_mutex> lk_guard{wal_rw_mtx_};
+    seg = GetSegmentLocked(lsn, ec);
+
+    if (seg == nullptr) {
+      return {};
+    }
+
+    size = seg->Size();
+  }
+
+  // The handle keeps the file open even if the cache evicts it meanwhile, so
+  // the read itself happens outside the lock. A segment may start with the
+  // end of a record continued from the previous one, which is skipped.
+  auto offset = lsn.GetOffset() == 0
+                    ? seg->FirstRecordOffset(size)
+                    : seg->GetAlignedReadOffset(lsn.GetOffset());
+
+  if (offset >= size) {
+    ec = rosekv::make_error_code(WALError::kInvalidOffset);
+    return {};
+  }
+
+  if (record_lsn != nullptr) {
+    *record_lsn = {lsn.GetSegmentId(), offset};
+  }
+
+  std::string data;
+  Segment::Offset next_offset = 0;
+  auto id = lsn.GetSegmentId();
+
+  // Follow records continuing across segments.
+  while (true) {
+    auto result = seg->ReadPartialAt(offset, size, &data, &next_offset);
+
+    if (result == Segment::ReadResult::kEnded) {
+      break;
+    }
+
+    if (result == Segment::ReadResult::kCorrupted) {
+      ec = rosekv::make_error_code(WALError::kCorruptedRecord);
+      return {};
+    }
+
+    std::shared_lock<std::shared_mutex> lk_guard{wal_rw_mtx_};
+    seg = GetSegmentLocked({++id, 0}, ec);
+
+    if (seg == nullptr) {
+      return {};
+    }
+
+    size = seg->Size();
+    offset = 0;
+  }
+
+  if (next_lsn != nullptr) {
+    *next_lsn = {id, next_offset};
+  }
+
+  return data;
 }
 
-Segment* WAL::GetActiveSegment() const {
-  auto it = segments_.rbegin();
+int64_t WAL::ReadRaw(LSN lsn, kiwi::span<char> buf, std::error_code& ec) {
+  std::shared_ptr<Segment> seg;
+  Segment::Offset size = 0;
+
+  {
+    std::shared_lock<std::shared_mutex> lk_guard{wal_rw_mtx_};
+    seg = GetSegmentLocked(lsn, ec);
+
+    if (seg == nullptr) {
+      return 0;
+    }
+
+    size = seg->Size();
+  }
 
-  return it->second.get();
+  // Never hand out bytes past the last complete record of the segment.
+  auto len = std::min<int64_t>(buf.size(), size - lsn.GetOffset());
+
+  if (len <= 0) {
+    return 0;
+  }
+
+  auto nbytes = seg->ReadRaw(lsn.GetOffset(), buf.first(len));
+
+  if (nbytes != len) {
+    ec = rosekv::make_error_code(WALError::kIOError);
+    return 0;
+  }
+
+  return nbytes;
+}
+
+int64_t WAL::GetBlockSize(SegmentId id, std::error_code& ec) {
+  std::shared_lock<std::shared_mutex> lk_guard{wal_rw_mtx_};
+  auto seg = GetSegmentLocked({id, 0}, ec);
+
+  return seg == nullptr ? 0 : seg->BlockSize();
+}
+
+LSN WAL::GetBeginLSN() {
+  std::shared_lock<std::shared_mutex> lk_guard{wal_rw_mtx_};
+
+  return segments_.Empty() ? LSN{} : LSN{segments_.FirstId(), 0};
+}
+
+LSN WAL::GetEndLSN() {
+  std::lock_guard<std::mutex> lk_guard{tail_mtx_};
+
+  return end_lsn_;
+}
+
+bool WAL::WaitForWrite(LSN lsn, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lk_guard{tail_mtx_};
+
+  tail_cv_.wait_for(lk_guard, timeout,
+                    [&] { return closing_ || lsn < end_lsn_; });
+
+  return !closing_ && lsn < end_lsn_;
+}
+
+void WAL::AppendToTail(LSN lsn, kiwi::span<const Slice> slices) {
+  {
+    std::lock_guard<std::mutex> lk_guard{tail_mtx_};
+
+    LSN next_lsn(segments_.LastId(), GetActiveSegment()->Size());
+    end_lsn_ = next_lsn;
+
+    // Records are only buffered while someone is subscribed.
+    if (num_subscribers_ != 0) {
+      std::string data;
+
+      for (const auto& slice : slices) {
+        data.append(slice.data(), slice.size());
+      }
+
+      auto record = std::make_shared<const std::string>(std::move(data));
+      tail_bytes_ += record->size();
+      tail_records_.push_back({lsn, next_lsn, std::move(record)});
+
+      while (tail_bytes_ > options_.tail_buffer_size &&
+             tail_records_.size() > 1) {
+        tail_bytes_ -= tail_records_.front().data->size();
+        tail_records_.pop_front();
+      }
+    }
+  }
+
+  tail_cv_.notify_all();
+}
+
+std::size_t WAL::TruncateBefore(LSN lsn) {
+  std::vector<ObsoleteSegment> obsolete;
+
+  {
+    std::lock_guard<std::shared_mutex> lk_guard{wal_rw_mtx_};
+
+    if (segments_.Empty()) {
+      return 0;
+    }
+
+    // The active segment takes the writes and is never dropped.
+    auto end = std::min(lsn.GetSegmentId(), segments_.LastId());
+
+    while (segments_.FirstId() < end) {
+      auto entry = segments_.PopFront();
+      auto segment = segment_cache_.Erase(entry.id);
+      obsolete.push_back({std::move(entry.path), std::move(segment)});
+    }
+  }
+
+  if (obsolete.empty()) {
+    return 0;
+  }
+
+  auto count = obsolete.size();
+
+  {
+    std::lock_guard<std::mutex> lk_guard{reclaim_mtx_};
+
+    for (auto& seg : obsolete) {
+      obsolete_segments_.push_back(std::move(seg));
+    }
+  }
+
+  reclaim_cv_.notify_one();
+
+  return count;
+}
+
+LSN WAL::SwitchSegment(std::error_code& ec) {
+  std::lock_guard<std::shared_mutex> lk_guard{wal_rw_mtx_};
+
+  if (status_) {
+    ec = status_;
+    return {};
+  }
+
+  NewSegment();
+
+  return {segments_.LastId(), 0};
+}
+
+void WAL::TruncateAfter(LSN lsn, std::error_code& ec) {
+  std::lock_guard<std::shared_mutex> lk_guard{wal_rw_mtx_};
+
+  auto seg = GetSegmentLocked(lsn, ec);
+
+  if (seg == nullptr) {
+    return;
+  }
+
+  bool continued = false;
+  auto end = seg->NextRecordOffset(lsn.GetOffset(), &continued);
+  auto id = lsn.GetSegmentId();
+
+  // The record may end in a later segment, which is where to cut.
+  while (end && continued) {
+    seg = GetSegmentLocked({++id, 0}, ec);
+
+    if (seg == nullptr) {
+      return;
+    }
+
+    end = seg->ContinuationEnd(&continued);
+  }
+
+  if (!end) {
+    ec = rosekv::make_error_code(WALError::kInvalidOffset);
+    return;
+  }
+
+  CutLocked(id, std::move(seg), *end, ec);
+}
+
+void WAL::TruncateFrom(LSN lsn, std::error_code& ec) {
+  std::lock_guard<std::shared_mutex> lk_guard{wal_rw_mtx_};
+
+  auto seg = GetSegmentLocked(lsn, ec);
+
+  if (seg == nullptr) {
+    return;
+  }
+
+  if (lsn.GetOffset() > static_cast<Segment::Offset>(seg->Size())) {
+    ec = rosekv::make_error_code(WALError::kInvalidOffset);
+    return;
+  }
+
+  CutLocked(lsn.GetSegmentId(), std::move(seg), lsn.GetOffset(), ec);
+}
+
+void WAL::CutLocked(SegmentId id, std::shared_ptr<Segment> seg,
+                    Segment::Offset end, std::error_code& ec) {
+  // Later segments are deleted synchronously, newest first: their ids are
+  // handed out again right away, so they cannot wait for the reclaim thread.
+  while (segments_.LastId() > id) {
+    auto last = segments_.PopBack();
+    segment_cache_.Erase(last.id);
+
+    if (!kiwi::DeleteFile(last.path)) {
+      LOG(ERROR) << "Failed to delete truncated segment: " << last.path;
+      ec = rosekv::make_error_code(WALError::kIOError);
+      status_ = ec;
+      return;
+    }
+  }
+
+  segment_cache_.Erase(id);
+
+  // Cached handles of sealed segments are read-only, while the cut segment
+  // takes the writes again.
+  if (seg->IsReadOnly()) {
+    seg = std::make_shared<Segment>(segments_.Find(id)->path,
+                                    GetSegmentFormat());
+
+    if (!seg->IsValid()) {
+      LOG(ERROR) << "Failed to reopen segment: " << id << ": "
+                 << seg->GetErrorDetail();
+      ec = rosekv::make_error_code(WALError::kIOError);
+      status_ = ec;
+      return;
+    }
+  }
+
+  active_segment_ = std::move(seg);
+  next_segment_id_ = id + 1;
+
+  {
+    std::lock_guard<std::mutex> lk_guard{tail_mtx_};
+
+    end_lsn_ = {id, end};
+
+    while (!tail_records_.empty() && tail_records_.back().lsn >= end_lsn_) {
+      tail_bytes_ -= tail_records_.back().data->size();
+      tail_records_.pop_back();
+    }
+  }
+
+  if (!active_segment_->Truncate(end)) {
+    LOG(ERROR) << "Failed to truncate segment: " << id << ": "
+               << active_segment_->GetErrorDetail();
+    ec = rosekv::make_error_code(WALError::kIOError);
+    status_ = ec;
+  }
+}
+
+std::shared_ptr<Segment> WAL::GetSegmentLocked(LSN lsn, std::error_code& ec) {
+  auto entry = segments_.Find(lsn);
+
+  if (entry == nullptr) {
+    ec = rosekv::make_error_code(WALError::kSegmentNotFound);
+    return nullptr;
+  }
+
+  if (entry->id == segments_.LastId()) {
+    if (active_segment_ == nullptr || !active_segment_->IsValid()) {
+      ec = rosekv::make_error_code(WALError::kIOError);
+      return nullptr;
+    }
+
+    return active_segment_;
+  }
+
+  auto seg = segment_cache_.Get(entry->id, entry->path);
+
+  if (seg == nullptr) {
+    ec = rosekv::make_error_code(WALError::kIOError);
+  }
+
+  return seg;
+}
+
+Segment* WAL::GetActiveSegment() const { return active_segment_.get(); }
+
+Segment::Format WAL::GetSegmentFormat() const {
+  return {Segment::kFormatV2, options_.block_size, options_.checksum};
 }
 
 Segment* WAL::NewSegment() {
   kiwi::FilePath dir = kiwi::FilePath::FromASCII(options_.wal_dir);
-  auto basename = std::to_string(++next_segment_id_) + kDefSegFileExtension;
-  auto path = dir.Append(basename);
-  segments_.emplace(std::move(basename), std::make_unique<Segment>(path));
+  auto id = next_segment_id_++;
+
+  // An LSN only has room for 32-bit segment ids, and a larger one would wrap
+  // around to the LSNs of older records.
+  CHECK_LE(id, LSN::kMaxSegmentId) << "Out of WAL segment ids";
+
+  auto path = dir.Append(SegmentCatalog::SegmentFileName(id));
+
+  // Seal the previous active segment and hand its handle over to the cache,
+  // so reads that follow the rollover do not need to reopen it.
+  if (active_segment_ != nullptr) {
+    active_segment_->Sync();
+    segment_cache_.Put(segments_.LastId(), std::move(active_segment_));
+  }
+
+  segments_.PushBack(id, path);
+  active_segment_ = std::make_shared<Segment>(path, GetSegmentFormat());
 
   return GetActiveSegment();
 }
@@ -104,4 +579,35 @@ void WAL::StartSyncThread() {
   }
 }
 
+void WAL::ReclaimSegments() {
+  while (true) {
+    std::vector<ObsoleteSegment> obsolete;
+
+    {
+      std::unique_lock<std::mutex> lk_guard{reclaim_mtx_};
+      reclaim_cv_.wait(lk_guard, [this] {
+        return stop_reclaim_thread_ || !obsolete_segments_.empty();
+      });
+
+      if (obsolete_segments_.empty()) {
+        break;
+      }
+
+      obsolete.swap(obsolete_segments_);
+    }
+
+    // Segments are deleted oldest first, so a crash in between leaves the ids
+    // on disk contiguous.
+    for (auto& seg : obsolete) {
+      seg.segment.reset();
+
+      if (!kiwi::DeleteFile(seg.path)) {
+        LOG(ERROR) << "Failed to delete obsolete segment: " << seg.path;
+      } else if (options_.verbose_logging) {
+        LOG(INFO) << "Deleted obsolete segment: " << seg.path;
+      }
+    }
+  }
+}
+
 }  // namespace rosekv
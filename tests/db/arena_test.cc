@@ -0,0 +1,99 @@
+#include "rosekv/db/arena.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace rosekv;
+
+TEST(Arena, Empty) {
+  Arena arena;
+
+  EXPECT_EQ(0u, arena.MemoryUsage());
+}
+
+TEST(Arena, AllocationsKeepTheirContents) {
+  constexpr std::size_t kBlockSize = 4096;
+  Arena arena{kBlockSize};
+  std::vector<std::pair<std::size_t, char*>> allocated;
+  std::mt19937 rng{301};
+  std::size_t bytes = 0;
+
+  for (int i = 0; i < 10000; ++i) {
+    // Mostly small allocations, with the occasional one larger than a block.
+    auto size = i % 997 == 0 ? 6000 : rng() % 100 + 1;
+    auto ptr = i % 2 == 0 ? arena.Allocate(size) : arena.AllocateAligned(size);
+
+    if (i % 2 == 1) {
+      EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(ptr) % Arena::kAlignUnit);
+    }
+
+    std::memset(ptr, i % 256, size);
+    allocated.emplace_back(size, ptr);
+    bytes += size;
+
+    EXPECT_GE(arena.MemoryUsage(), bytes);
+    // Waste is bounded by a fraction of each block.
+    EXPECT_LE(arena.MemoryUsage(), bytes * 1.3 + kBlockSize);
+  }
+
+  for (std::size_t i = 0; i < allocated.size(); ++i) {
+    auto [size, ptr] = allocated[i];
+
+    for (std::size_t j = 0; j < size; ++j) {
+      ASSERT_EQ(static_cast<char>(i % 256), ptr[j]) << " allocation: " << i;
+    }
+  }
+}
+
+TEST(Arena, HugePagesFallBackToRegularPages) {
+  // Succeeds whether or not the system has huge pages reserved.
+  Arena arena{4 * 1024 * 1024, true};
+  auto ptr = arena.Allocate(100);
+
+  std::memset(ptr, 1, 100);
+  EXPECT_GE(arena.MemoryUsage(), 4u * 1024 * 1024);
+}
+
+TEST(ConcurrentArena, ConcurrentAllocationsDoNotOverlap) {
+  constexpr int kNumThreads = 8;
+  constexpr int kAllocsPerThread = 20000;
+  ConcurrentArena arena{64 * 1024};
+  std::vector<std::vector<std::pair<std::size_t, char*>>> allocated(
+      kNumThreads);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+
+      for (int i = 0; i < kAllocsPerThread; ++i) {
+        auto size = i % 1000 == 0 ? 20000 : rng() % 64 + 1;
+        auto ptr = i % 2 == 0 ? arena.Allocate(size)
+                              : arena.AllocateAligned(size);
+
+        std::memset(ptr, t, size);
+        allocated[t].emplace_back(size, ptr);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Any overlap would have let another thread overwrite the pattern.
+  for (int t = 0; t < kNumThreads; ++t) {
+    for (auto [size, ptr] : allocated[t]) {
+      for (std::size_t j = 0; j < size; ++j) {
+        ASSERT_EQ(static_cast<char>(t), ptr[j]);
+      }
+    }
+  }
+
+  EXPECT_GT(arena.MemoryUsage(), 0u);
+}
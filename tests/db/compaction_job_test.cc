@@ -0,0 +1,186 @@
+#include "rosekv/db/compaction_job.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <kiwi/io/file_util.hh>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <mutex>
+#include <string>
+
+#include "rosekv/db/filename.hh"
+
+using namespace rosekv;
+
+namespace {
+
+std::string UserKey(int i) {
+  char key[32];
+  std::snprintf(key, sizeof(key), "user-key-%08d", i);
+
+  return key;
+}
+
+}  // namespace
+
+class CompactionJobTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+
+    options_.num_levels = 3;
+    options_.table.block_size = 1024;
+    options_.target_file_size = 16 * 1024;
+  }
+
+  /// Writes table `number` holding every `step`-th key in [`begin`, `end`)
+  /// at sequence number `sequence`, deleting the keys divisible by
+  /// `delete_every` if it is not 0.
+  std::shared_ptr<FileMetaData> AddTable(uint64_t number, int begin, int end,
+                                         int step, SequenceNumber sequence,
+                                         int delete_every = 0) {
+    auto path = db_path_.Append(TableFileName(number));
+    std::error_code ec;
+
+    {
+      TableBuilder builder{options_.table, path};
+
+      for (int i = begin; i < end; i += step) {
+        auto type = delete_every != 0 && i % delete_every == 0
+                        ? ValueType::kDeletion
+                        : ValueType::kValue;
+        std::string key;
+        AppendInternalKey(&key, UserKey(i), sequence, type);
+        builder.Add(key, type == ValueType::kValue
+                             ? std::to_string(sequence) + std::string(50, 'v')
+                             : "");
+      }
+
+      builder.Finish(ec);
+      EXPECT_FALSE(ec);
+    }
+
+    auto table = std::make_shared<Table>(path, options_.table);
+    EXPECT_FALSE(table->Status());
+
+    return NewFileMetaData(number, std::move(table));
+  }
+
+  /// Compacts the files of level 0 and the overlapping files of level 1 into
+  /// level 1.
+  void Compact(int num_threads, CompactionStats* stats) {
+    auto version = versions_->Current();
+    std::vector<CompactionInputs> inputs{{0, version->GetFiles(0)},
+                                         {1, version->GetFiles(1)}};
+    Compaction compaction{version, std::move(inputs), 1, 1,
+                          options_.target_file_size};
+    ThreadPool pool{num_threads};
+    std::atomic<bool> shutting_down{false};
+    std::mutex mtx;
+    CompactionJob job{options_, db_path_, &compaction,
+                      [&] {
+                        std::lock_guard<std::mutex> lk_guard{mtx};
+                        return versions_->NewFileNumber();
+                      },
+                      &shutting_down, &pool};
+    std::error_code ec;
+
+    job.Run(ec);
+    ASSERT_FALSE(ec) << ec.message();
+
+    VersionEdit edit;
+    job.AddToEdit(&edit);
+    versions_->LogAndApply(edit, ec);
+    ASSERT_FALSE(ec) << ec.message();
+
+    *stats = job.GetStats();
+  }
+
+  kiwi::ScopedTempDir temp_dir_;
+  kiwi::FilePath db_path_;
+  DBOptions options_;
+  std::unique_ptr<VersionSet> versions_;
+};
+
+TEST_F(CompactionJobTest, SplitsIntoSubcompactions) {
+  for (int max_subcompactions : {1, 4}) {
+    SCOPED_TRACE(max_subcompactions);
+    db_path_ = temp_dir_.GetPath().Append(std::to_string(max_subcompactions));
+    kiwi::File::Error error;
+    ASSERT_TRUE(kiwi::CreateDirectoryAndGetError(db_path_, &error));
+    options_.max_subcompactions = max_subcompactions;
+    versions_ = std::make_unique<VersionSet>(options_, db_path_);
+
+    std::error_code ec;
+    versions_->Recover(ec);
+    ASSERT_FALSE(ec);
+
+    // Two files of level 0 overwrite and delete keys spread over the files
+    // of level 1, and level 2 holds some of the deleted keys.
+    VersionEdit edit;
+    edit.AddFile(0, AddTable(versions_->NewFileNumber(), 0, 4000, 3, 4, 9));
+    edit.AddFile(0, AddTable(versions_->NewFileNumber(), 0, 4000, 2, 3));
+
+    for (int begin = 0; begin < 4000; begin += 1000) {
+      edit.AddFile(1, AddTable(versions_->NewFileNumber(), begin,
+                               begin + 1000, 1, 2));
+    }
+
+    edit.AddFile(2, AddTable(versions_->NewFileNumber(), 0, 100, 1, 1));
+    versions_->LogAndApply(edit, ec);
+    ASSERT_FALSE(ec);
+
+    CompactionStats stats;
+    Compact(4, &stats);
+
+    if (max_subcompactions == 1) {
+      EXPECT_EQ(1u, stats.num_subcompactions);
+    } else {
+      EXPECT_GT(stats.num_subcompactions, 1u);
+      EXPECT_LE(stats.num_subcompactions, 4u);
+    }
+
+    EXPECT_EQ(6u, stats.num_input_files);
+    EXPECT_EQ(4000u + 1334 + 2000, stats.num_input_records);
+
+    // The outputs form a single sorted run.
+    auto version = versions_->Current();
+    const auto& files = version->GetFiles(1);
+    ASSERT_EQ(stats.num_output_files, files.size());
+    EXPECT_EQ(0u, version->GetFiles(0).size());
+
+    for (std::size_t i = 1; i < files.size(); ++i) {
+      EXPECT_LT(ExtractUserKey(files[i - 1]->largest),
+                ExtractUserKey(files[i]->smallest));
+    }
+
+    for (int i = 0; i < 4000; ++i) {
+      std::string value;
+      auto result = version->Get(UserKey(i), kMaxSequenceNumber, &value, ec);
+      ASSERT_FALSE(ec);
+
+      if (i % 9 == 0) {
+        EXPECT_NE(LookupResult::kFound, result) << i;
+      } else {
+        ASSERT_EQ(LookupResult::kFound, result) << i;
+        auto sequence = i % 3 == 0 ? 4 : i % 2 == 0 ? 3 : 2;
+        EXPECT_EQ(std::to_string(sequence), value.substr(0, 1)) << i;
+      }
+    }
+
+    // Deletions are only kept over the keys of level 2.
+    uint64_t num_deletions = 0;
+
+    for (const auto& file : files) {
+      auto iter = file->table->NewIterator();
+
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        ParsedInternalKey ikey;
+        ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+        num_deletions += ikey.type == ValueType::kDeletion;
+      }
+    }
+
+    EXPECT_EQ(12u, num_deletions);
+  }
+}
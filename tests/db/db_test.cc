@@ -0,0 +1,587 @@
+#include "rosekv/db/db.hh"
+
+#include <gtest/gtest.h>
+
+#include <kiwi/io/file.hh>
+#include <kiwi/io/file_enumerator.hh>
+#include <kiwi/io/file_util.hh>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rosekv/db/filename.hh"
+#include "rosekv/wal/segment_catalog.hh"
+
+using namespace rosekv;
+
+static int CountFiles(const kiwi::FilePath& dir, std::string_view extension) {
+  int count = 0;
+  kiwi::FileEnumerator file_iter(dir, false, kiwi::FileEnumerator::kFiles);
+
+  for (auto fp = file_iter.Next(); !fp.empty(); fp = file_iter.Next()) {
+    count += fp.Extension() == extension;
+  }
+
+  return count;
+}
+
+class DBTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+
+    options_.db_dir = temp_dir_.GetPath().Append("db").value();
+  }
+
+  kiwi::FilePath WALPath() const {
+    return temp_dir_.GetPath().Append("db").Append("wal");
+  }
+
+  /// \return The LSNs of the records in the WAL of the closed DB.
+  std::vector<LSN> ListWALRecords() const {
+    auto wal_options = options_.wal;
+    wal_options.wal_dir = WALPath().value();
+    WAL wal{wal_options};
+    auto iter = wal.Subscribe();
+    std::error_code ec;
+    std::vector<LSN> lsns;
+
+    while (iter->Next(std::chrono::milliseconds(0), ec)) {
+      lsns.push_back(iter->GetLSN());
+    }
+
+    return lsns;
+  }
+
+  kiwi::File OpenSegment(SegmentId id) const {
+    return kiwi::File{
+        WALPath().Append(SegmentCatalog::SegmentFileName(id)),
+        kiwi::File::kFlagOpen | kiwi::File::kFlagRead |
+            kiwi::File::kFlagWrite};
+  }
+
+  kiwi::ScopedTempDir temp_dir_;
+  DBOptions options_;
+};
+
+TEST_F(DBTest, PutGetDelete) {
+  DB db{options_};
+  std::error_code ec;
+
+  ASSERT_FALSE(db.Status());
+
+  EXPECT_EQ(std::nullopt, db.Get("key", ec));
+
+  db.Put("key", "v1", ec);
+  ASSERT_FALSE(ec);
+  EXPECT_EQ("v1", db.Get("key", ec));
+
+  db.Put("key", "v2", ec);
+  ASSERT_FALSE(ec);
+  EXPECT_EQ("v2", db.Get("key", ec));
+
+  db.Delete("key", ec);
+  ASSERT_FALSE(ec);
+  EXPECT_EQ(std::nullopt, db.Get("key", ec));
+  EXPECT_FALSE(ec);
+}
+
+TEST_F(DBTest, RecoversFromWAL) {
+  std::error_code ec;
+
+  {
+    DB db{options_};
+
+    for (int i = 0; i < 1000; ++i) {
+      db.Put("key" + std::to_string(i), std::string(i, 'v'), ec);
+      ASSERT_FALSE(ec);
+    }
+
+    db.Delete("key7", ec);
+    db.Put("key8", "updated", ec);
+    ASSERT_FALSE(ec);
+  }
+
+  DB db{options_};
+  ASSERT_FALSE(db.Status());
+
+  EXPECT_EQ(std::nullopt, db.Get("key7", ec));
+  EXPECT_EQ("updated", db.Get("key8", ec));
+  EXPECT_EQ(std::string(999, 'v'), db.Get("key999", ec));
+
+  // New writes get sequence numbers after the recovered ones.
+  db.Put("key8", "again", ec);
+  EXPECT_EQ("again", db.Get("key8", ec));
+}
+
+TEST_F(DBTest, RecoveryReportsCorruptedRecords) {
+  std::error_code ec;
+
+  {
+    DB db{options_};
+
+    db.Put("key", "value", ec);
+    ASSERT_FALSE(ec);
+  }
+
+  // Append a record too short to hold the tag of an update.
+  {
+    auto wal_options = options_.wal;
+    wal_options.wal_dir =
+        temp_dir_.GetPath().Append("db").Append("wal").value();
+    WAL wal{wal_options};
+    std::string_view record = "bad";
+
+    wal.Write(kiwi::span(record), ec);
+    ASSERT_FALSE(ec);
+  }
+
+  DB db{options_};
+  ASSERT_TRUE(db.Status());
+  EXPECT_EQ(make_error_code(DBError::kCorruption), db.Status());
+}
+
+TEST_F(DBTest, RecoveryStopsAtTornWALTail) {
+  std::error_code ec;
+
+  {
+    DB db{options_};
+
+    for (int i = 0; i < 100; ++i) {
+      db.Put("key" + std::to_string(i), std::string(100, 'v'), ec);
+      ASSERT_FALSE(ec);
+    }
+  }
+
+  auto lsns = ListWALRecords();
+  ASSERT_EQ(100, lsns.size());
+
+  // Tear the last record as a crash in the middle of its append would.
+  {
+    auto file = OpenSegment(lsns.back().GetSegmentId());
+    ASSERT_TRUE(file.SetLength(file.GetLength() - 3));
+  }
+
+  {
+    DB db{options_};
+    ASSERT_FALSE(db.Status()) << db.Status().message();
+
+    EXPECT_EQ(std::string(100, 'v'), db.Get("key0", ec));
+    EXPECT_EQ(std::string(100, 'v'), db.Get("key98", ec));
+    EXPECT_EQ(std::nullopt, db.Get("key99", ec));
+
+    // New records go where the torn one started.
+    db.Put("key99", "again", ec);
+    ASSERT_FALSE(ec);
+  }
+
+  EXPECT_EQ(lsns, ListWALRecords());
+
+  DB db{options_};
+  ASSERT_FALSE(db.Status()) << db.Status().message();
+
+  EXPECT_EQ(std::string(100, 'v'), db.Get("key98", ec));
+  EXPECT_EQ("again", db.Get("key99", ec));
+}
+
+TEST_F(DBTest, RecoveryStopsAtCorruptedWALRecord) {
+  std::error_code ec;
+
+  {
+    DB db{options_};
+
+    for (int i = 0; i < 100; ++i) {
+      db.Put("key" + std::to_string(i), std::string(100, 'v'), ec);
+      ASSERT_FALSE(ec);
+    }
+  }
+
+  auto lsns = ListWALRecords();
+  ASSERT_EQ(100, lsns.size());
+
+  // Flip a bit in the payload of a record in the middle of the log.
+  {
+    auto file = OpenSegment(lsns[50].GetSegmentId());
+    auto offset = lsns[50].GetOffset() + 20;
+    char byte;
+    ASSERT_EQ(1, file.Read(offset, &byte, 1));
+    byte ^= 0x40;
+    ASSERT_EQ(1, file.Write(offset, &byte, 1));
+  }
+
+  {
+    DB db{options_};
+    ASSERT_FALSE(db.Status()) << db.Status().message();
+
+    // Replay stops at the corrupted record and drops everything after it.
+    EXPECT_EQ(std::string(100, 'v'), db.Get("key49", ec));
+    EXPECT_EQ(std::nullopt, db.Get("key50", ec));
+    EXPECT_EQ(std::nullopt, db.Get("key99", ec));
+
+    db.Put("key50", "again", ec);
+    ASSERT_FALSE(ec);
+  }
+
+  EXPECT_EQ(std::vector<LSN>(lsns.begin(), lsns.begin() + 51),
+            ListWALRecords());
+
+  DB db{options_};
+  ASSERT_FALSE(db.Status()) << db.Status().message();
+
+  EXPECT_EQ(std::string(100, 'v'), db.Get("key49", ec));
+  EXPECT_EQ("again", db.Get("key50", ec));
+  EXPECT_EQ(std::nullopt, db.Get("key51", ec));
+}
+
+TEST_F(DBTest, ConcurrentWriters) {
+  constexpr int kNumWriters = 4;
+  constexpr int kKeysPerWriter = 500;
+
+  {
+    DB db{options_};
+    std::vector<std::thread> writers;
+
+    for (int w = 0; w < kNumWriters; ++w) {
+      writers.emplace_back([&db, w] {
+        std::error_code ec;
+
+        for (int i = 0; i < kKeysPerWriter; ++i) {
+          auto key = std::to_string(w) + "-" + std::to_string(i);
+          db.Put(key, key, ec);
+          ASSERT_FALSE(ec);
+        }
+      });
+    }
+
+    for (auto& writer : writers) {
+      writer.join();
+    }
+  }
+
+  DB db{options_};
+  std::error_code ec;
+
+  for (int w = 0; w < kNumWriters; ++w) {
+    for (int i = 0; i < kKeysPerWriter; ++i) {
+      auto key = std::to_string(w) + "-" + std::to_string(i);
+      EXPECT_EQ(key, db.Get(key, ec));
+    }
+  }
+}
+
+TEST_F(DBTest, HashMemTable) {
+  options_.memtable_type = MemTableType::kHash;
+  options_.hash_bucket_count = 64;
+  std::error_code ec;
+
+  {
+    DB db{options_};
+
+    for (int i = 0; i < 1000; ++i) {
+      db.Put("key" + std::to_string(i % 100), std::to_string(i), ec);
+      ASSERT_FALSE(ec);
+    }
+
+    db.Delete("key42", ec);
+    ASSERT_FALSE(ec);
+    EXPECT_EQ("999", db.Get("key99", ec));
+    EXPECT_EQ(std::nullopt, db.Get("key42", ec));
+  }
+
+  DB db{options_};
+
+  EXPECT_EQ("999", db.Get("key99", ec));
+  EXPECT_EQ("900", db.Get("key0", ec));
+  EXPECT_EQ(std::nullopt, db.Get("key42", ec));
+}
+
+TEST_F(DBTest, FlushesFullMemTables) {
+  constexpr int kNumWriters = 4;
+  constexpr int kKeysPerWriter = 2000;
+
+  options_.write_buffer_size = 64 * 1024;
+  options_.arena_block_size = 64 * 1024;
+  options_.table.block_size = 1024;
+  // Keeps every table in level 0.
+  options_.level0_file_num_compaction_trigger = 1000;
+  options_.level0_stop_writes_trigger = 1000;
+
+  auto value_of = [](const std::string& key) {
+    return key + std::string(100, 'v');
+  };
+
+  std::error_code ec;
+
+  {
+    DB db{options_};
+    std::vector<std::thread> writers;
+
+    for (int w = 0; w < kNumWriters; ++w) {
+      writers.emplace_back([&, w] {
+        std::error_code ec;
+
+        for (int i = 0; i < kKeysPerWriter; ++i) {
+          auto key = std::to_string(w) + "-" + std::to_string(i);
+          db.Put(key, value_of(key), ec);
+          ASSERT_FALSE(ec);
+        }
+      });
+    }
+
+    for (auto& writer : writers) {
+      writer.join();
+    }
+
+    // Updates shadow the values flushed so far.
+    db.Put("0-1", "updated", ec);
+    db.Delete("0-2", ec);
+    ASSERT_FALSE(ec);
+
+    EXPECT_GT(db.NumTableFiles(), 1u);
+    EXPECT_EQ("updated", db.Get("0-1", ec));
+
+    db.Flush(ec);
+    ASSERT_FALSE(ec) << ec.message();
+    EXPECT_EQ(0u, db.NumImmutableMemTables());
+
+    // Only the segment created by the last switch is left.
+    EXPECT_EQ(1, CountFiles(temp_dir_.GetPath().Append("db").Append("wal"),
+                            kDefSegFileExtension));
+
+    for (int w = 0; w < kNumWriters; ++w) {
+      for (int i = 3; i < kKeysPerWriter; ++i) {
+        auto key = std::to_string(w) + "-" + std::to_string(i);
+        ASSERT_EQ(value_of(key), db.Get(key, ec)) << key;
+      }
+    }
+
+    EXPECT_EQ("updated", db.Get("0-1", ec));
+    EXPECT_EQ(std::nullopt, db.Get("0-2", ec));
+    EXPECT_FALSE(ec);
+  }
+
+  // The tables are reopened, and nothing is replayed from the WAL.
+  DB db{options_};
+  ASSERT_FALSE(db.Status());
+  EXPECT_EQ(CountFiles(temp_dir_.GetPath().Append("db"), kTableFileExtension),
+            db.NumTableFiles());
+
+  EXPECT_EQ(value_of("3-1999"), db.Get("3-1999", ec));
+  EXPECT_EQ("updated", db.Get("0-1", ec));
+  EXPECT_EQ(std::nullopt, db.Get("0-2", ec));
+  EXPECT_FALSE(ec);
+}
+
+TEST_F(DBTest, RecoversOnTopOfTables) {
+  std::error_code ec;
+
+  {
+    DB db{options_};
+
+    for (int i = 0; i < 100; ++i) {
+      db.Put("key" + std::to_string(i), "flushed", ec);
+    }
+
+    db.Flush(ec);
+    ASSERT_FALSE(ec) << ec.message();
+
+    // These only live in the WAL.
+    db.Put("key1", "logged", ec);
+    db.Delete("key2", ec);
+    ASSERT_FALSE(ec);
+  }
+
+  {
+    DB db{options_};
+    ASSERT_FALSE(db.Status());
+    EXPECT_EQ(1u, db.NumTableFiles());
+
+    EXPECT_EQ("flushed", db.Get("key0", ec));
+    EXPECT_EQ("logged", db.Get("key1", ec));
+    EXPECT_EQ(std::nullopt, db.Get("key2", ec));
+
+    db.Flush(ec);
+    ASSERT_FALSE(ec) << ec.message();
+
+    // Sequence numbers continue after the flushed ones.
+    db.Put("key3", "newest", ec);
+    db.Flush(ec);
+    ASSERT_FALSE(ec) << ec.message();
+  }
+
+  DB db{options_};
+  EXPECT_EQ(3u, db.NumTableFiles());
+  EXPECT_EQ("logged", db.Get("key1", ec));
+  EXPECT_EQ(std::nullopt, db.Get("key2", ec));
+  EXPECT_EQ("newest", db.Get("key3", ec));
+}
+
+TEST_F(DBTest, WALSegmentIdsOutliveTheWALDirectory) {
+  options_.wal.block_size = 1024;
+  options_.wal.max_segment_sz = 4096;
+  auto wal_path = temp_dir_.GetPath().Append("db").Append("wal");
+  std::error_code ec;
+
+  {
+    DB db{options_};
+
+    // Each flush moves the oldest segment still needed forward.
+    for (int i = 0; i < 8; ++i) {
+      db.Put("flushed" + std::to_string(i), "v", ec);
+      db.Flush(ec);
+      ASSERT_FALSE(ec) << ec.message();
+    }
+  }
+
+  kiwi::FileEnumerator file_iter(wal_path, false,
+                                 kiwi::FileEnumerator::kFiles);
+
+  for (auto fp = file_iter.Next(); !fp.empty(); fp = file_iter.Next()) {
+    ASSERT_TRUE(kiwi::DeleteFile(fp));
+  }
+
+  // The records span segments whose ids would be taken for flushed ones if
+  // the WAL started over from 1.
+  {
+    DB db{options_};
+    ASSERT_FALSE(db.Status());
+
+    for (int i = 0; i < 32; ++i) {
+      db.Put("logged" + std::to_string(i), std::string(2000, 'v'), ec);
+      ASSERT_FALSE(ec);
+    }
+
+    EXPECT_GT(CountFiles(wal_path, kDefSegFileExtension), 9);
+  }
+
+  DB db{options_};
+  ASSERT_FALSE(db.Status());
+
+  for (int i = 0; i < 32; ++i) {
+    EXPECT_EQ(std::string(2000, 'v'), db.Get("logged" + std::to_string(i), ec))
+        << i;
+  }
+
+  EXPECT_EQ("v", db.Get("flushed0", ec));
+  EXPECT_FALSE(ec);
+}
+
+class DBCompactionTest : public DBTest {
+ protected:
+  static constexpr int kNumKeys = 20000;
+
+  void SetUp() override {
+    DBTest::SetUp();
+
+    options_.write_buffer_size = 32 * 1024;
+    options_.arena_block_size = 32 * 1024;
+    options_.table.block_size = 1024;
+    options_.level0_file_num_compaction_trigger = 2;
+    options_.max_bytes_for_level_base = 128 * 1024;
+    options_.max_bytes_for_level_multiplier = 4;
+    options_.target_file_size = 32 * 1024;
+    options_.max_background_compactions = 2;
+  }
+
+  static std::string KeyOf(int i) {
+    return std::to_string(i * 7919 % kNumKeys);
+  }
+
+  static std::string ValueOf(int i, int round) {
+    return std::to_string(i) + "-" + std::to_string(round) +
+           std::string(50, 'v');
+  }
+
+  /// Writes every key twice, then deletes a tenth of them, so that
+  /// compactions have shadowed versions and deletions to drop. Checks the
+  /// contents once compactions are done and again after reopening.
+  ///
+  /// \param stats Receives the statistics of the database before reopening.
+  void FillAndCompact(DBStats* stats) {
+    std::error_code ec;
+
+    {
+      DB db{options_};
+
+      for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < kNumKeys; ++i) {
+          db.Put(KeyOf(i), ValueOf(i, round), ec);
+          ASSERT_FALSE(ec);
+        }
+      }
+
+      for (int i = 0; i < kNumKeys; i += 10) {
+        db.Delete(KeyOf(i), ec);
+        ASSERT_FALSE(ec);
+      }
+
+      db.Flush(ec);
+      ASSERT_FALSE(ec) << ec.message();
+      db.WaitForCompactions(ec);
+      ASSERT_FALSE(ec) << ec.message();
+
+      EXPECT_EQ(CountFiles(kiwi::FilePath::FromASCII(options_.db_dir),
+                           kTableFileExtension),
+                db.NumTableFiles());
+      ExpectContents(&db);
+      *stats = db.GetStats();
+    }
+
+    DB db{options_};
+    ASSERT_FALSE(db.Status());
+    ExpectContents(&db);
+  }
+
+  void ExpectContents(DB* db) {
+    std::error_code ec;
+
+    for (int i = 0; i < kNumKeys; ++i) {
+      auto expected =
+          i % 10 == 0 ? std::nullopt : std::optional{ValueOf(i, 1)};
+      ASSERT_EQ(expected, db->Get(KeyOf(i), ec)) << i;
+    }
+
+    EXPECT_FALSE(ec);
+  }
+};
+
+TEST_F(DBCompactionTest, CompactsLevels) {
+  DBStats stats;
+  FillAndCompact(&stats);
+
+  EXPECT_GT(stats.num_compactions, 0u);
+  EXPECT_GT(stats.compactions.num_dropped_records, 0u);
+  // Some compactions are large enough to be split.
+  EXPECT_GT(stats.compactions.num_subcompactions, stats.num_compactions);
+  EXPECT_LT(stats.num_sorted_runs,
+            static_cast<std::size_t>(options_.num_levels));
+
+  DB db{options_};
+  EXPECT_LT(db.NumFilesAtLevel(0),
+            static_cast<std::size_t>(
+                options_.level0_file_num_compaction_trigger));
+  EXPECT_GT(db.NumFilesAtLevel(2), 0u);
+}
+
+TEST_F(DBCompactionTest, TieredCompactionWritesLess) {
+  // Runs one compaction at a time, so that the comparison does not depend
+  // on how concurrent compactions interleave.
+  options_.max_background_compactions = 1;
+
+  DBStats leveled;
+  FillAndCompact(&leveled);
+
+  options_.db_dir = temp_dir_.GetPath().Append("tiered").value();
+  options_.compaction_style = CompactionStyle::kTiered;
+  options_.level0_file_num_compaction_trigger = 4;
+
+  DBStats tiered;
+  FillAndCompact(&tiered);
+
+  EXPECT_GT(tiered.num_compactions, 0u);
+  EXPECT_LT(tiered.WriteAmplification(), leveled.WriteAmplification());
+  EXPECT_LT(tiered.num_sorted_runs,
+            static_cast<std::size_t>(
+                options_.level0_file_num_compaction_trigger));
+}
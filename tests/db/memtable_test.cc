@@ -0,0 +1,106 @@
+#include "rosekv/db/memtable.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rosekv;
+
+class MemTableTest : public testing::TestWithParam<MemTableType> {
+ protected:
+  MemTableTest() {
+    options_.memtable_type = GetParam();
+    options_.hash_bucket_count = 1024;
+  }
+
+  DBOptions options_;
+};
+
+INSTANTIATE_TEST_SUITE_P(Types, MemTableTest,
+                         testing::Values(MemTableType::kSkipList,
+                                         MemTableType::kHash));
+
+TEST_P(MemTableTest, GetReturnsNewestVisibleUpdate) {
+  MemTable mem{options_};
+  std::string value;
+
+  mem.Add(1, ValueType::kValue, "key", "v1");
+  mem.Add(2, ValueType::kValue, "key", "v2");
+  mem.Add(3, ValueType::kDeletion, "key", "");
+  mem.Add(4, ValueType::kValue, "other", "v4");
+
+  EXPECT_EQ(LookupResult::kDeleted, mem.Get("key", kMaxSequenceNumber, &value));
+  EXPECT_EQ(LookupResult::kFound, mem.Get("key", 2, &value));
+  EXPECT_EQ("v2", value);
+  EXPECT_EQ(LookupResult::kFound, mem.Get("key", 1, &value));
+  EXPECT_EQ("v1", value);
+  EXPECT_EQ(LookupResult::kNotFound, mem.Get("other", 3, &value));
+  EXPECT_EQ(LookupResult::kNotFound,
+            mem.Get("ke", kMaxSequenceNumber, &value));
+  EXPECT_EQ(LookupResult::kNotFound,
+            mem.Get("keys", kMaxSequenceNumber, &value));
+  EXPECT_GT(mem.ApproximateMemoryUsage(), 0u);
+}
+
+TEST_P(MemTableTest, IteratesInInternalKeyOrder) {
+  MemTable mem{options_};
+
+  mem.Add(1, ValueType::kValue, "b", "b1");
+  mem.Add(2, ValueType::kValue, "a", "a2");
+  mem.Add(3, ValueType::kValue, "b", "b3");
+
+  MemTable::Iterator iter{&mem};
+  std::vector<std::pair<std::string, std::string>> entries;
+
+  for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+    ParsedInternalKey parsed;
+    ASSERT_TRUE(ParseInternalKey(iter.key(), &parsed));
+    entries.emplace_back(std::string(parsed.user_key) + "@" +
+                             std::to_string(parsed.sequence),
+                         iter.value());
+  }
+
+  std::vector<std::pair<std::string, std::string>> expected = {
+      {"a@2", "a2"}, {"b@3", "b3"}, {"b@1", "b1"}};
+  EXPECT_EQ(expected, entries);
+
+  std::string target;
+  AppendInternalKey(&target, "b", 2, kValueTypeForSeek);
+  iter.Seek(target);
+  ASSERT_TRUE(iter.Valid());
+  EXPECT_EQ("b1", iter.value());
+  iter.Prev();
+  ASSERT_TRUE(iter.Valid());
+  EXPECT_EQ("b3", iter.value());
+}
+
+TEST_P(MemTableTest, ConcurrentAdds) {
+  constexpr int kNumWriters = 4;
+  constexpr int kKeysPerWriter = 5000;
+  MemTable mem{options_};
+  std::vector<std::thread> writers;
+
+  for (int w = 0; w < kNumWriters; ++w) {
+    writers.emplace_back([&mem, w] {
+      for (int i = 0; i < kKeysPerWriter; ++i) {
+        auto sequence = static_cast<SequenceNumber>(i * kNumWriters + w + 1);
+        mem.Add(sequence, ValueType::kValue, "key" + std::to_string(i),
+                std::to_string(sequence));
+      }
+    });
+  }
+
+  for (auto& writer : writers) {
+    writer.join();
+  }
+
+  std::string value;
+
+  for (int i = 0; i < kKeysPerWriter; ++i) {
+    ASSERT_EQ(LookupResult::kFound,
+              mem.Get("key" + std::to_string(i), kMaxSequenceNumber, &value));
+    EXPECT_EQ(std::to_string((i + 1) * kNumWriters), value);
+  }
+}
@@ -0,0 +1,124 @@
+#include "rosekv/db/merging_iterator.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <string>
+#include <vector>
+
+#include "rosekv/db/dbformat.hh"
+#include "rosekv/table/table_builder.hh"
+
+using namespace rosekv;
+
+namespace {
+
+std::string UserKey(int i) {
+  char key[32];
+  std::snprintf(key, sizeof(key), "user-key-%08d", i);
+
+  return key;
+}
+
+std::string InternalKey(const std::string& user_key, SequenceNumber sequence) {
+  std::string key;
+  AppendInternalKey(&key, user_key, sequence, ValueType::kValue);
+
+  return key;
+}
+
+}  // namespace
+
+class MergingIteratorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+
+    options_.block_size = 256;
+  }
+
+  /// Writes a table holding the keys `i` in [`begin`, `end`) with `i %
+  /// step == 0`, each at sequence number `sequence`.
+  void AddTable(int begin, int end, int step, SequenceNumber sequence) {
+    auto path = temp_dir_.GetPath().Append(std::to_string(tables_.size()));
+    std::error_code ec;
+
+    {
+      TableBuilder builder{options_, path};
+
+      for (int i = begin; i < end; ++i) {
+        if (i % step == 0) {
+          builder.Add(InternalKey(UserKey(i), sequence),
+                      std::to_string(sequence));
+        }
+      }
+
+      builder.Finish(ec);
+      ASSERT_FALSE(ec);
+    }
+
+    tables_.push_back(std::make_unique<Table>(path, options_));
+    ASSERT_FALSE(tables_.back()->Status());
+  }
+
+  std::unique_ptr<MergingIterator> NewIterator() {
+    std::vector<std::unique_ptr<Table::Iterator>> children;
+
+    for (const auto& table : tables_) {
+      children.push_back(table->NewIterator());
+    }
+
+    return std::make_unique<MergingIterator>(std::move(children));
+  }
+
+  kiwi::ScopedTempDir temp_dir_;
+  TableOptions options_;
+  std::vector<std::unique_ptr<Table>> tables_;
+};
+
+TEST_F(MergingIteratorTest, MergesInInternalKeyOrder) {
+  AddTable(0, 1000, 2, 1);
+  AddTable(0, 1000, 3, 2);
+  AddTable(500, 1500, 1, 3);
+  AddTable(0, 0, 1, 4);
+
+  auto iter = NewIterator();
+  std::string last_key;
+  int count = 0;
+
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (count > 0) {
+      ASSERT_LT(InternalKeyComparator{}(last_key, iter->key()), 0);
+    }
+
+    last_key.assign(iter->key());
+    ++count;
+  }
+
+  EXPECT_FALSE(iter->Status());
+  EXPECT_EQ(500 + 334 + 1000, count);
+
+  // Versions of a key come newest first.
+  iter->Seek(InternalKey(UserKey(600), kMaxSequenceNumber));
+  ASSERT_TRUE(iter->Valid());
+  EXPECT_EQ(InternalKey(UserKey(600), 3), iter->key());
+  EXPECT_EQ("3", iter->value());
+  iter->Next();
+  EXPECT_EQ(InternalKey(UserKey(600), 2), iter->key());
+  iter->Next();
+  EXPECT_EQ(InternalKey(UserKey(600), 1), iter->key());
+  iter->Next();
+  EXPECT_EQ(InternalKey(UserKey(601), 3), iter->key());
+
+  iter->Seek(InternalKey(UserKey(1500), kMaxSequenceNumber));
+  EXPECT_FALSE(iter->Valid());
+}
+
+TEST_F(MergingIteratorTest, NoChildren) {
+  auto iter = NewIterator();
+
+  iter->SeekToFirst();
+  EXPECT_FALSE(iter->Valid());
+  EXPECT_FALSE(iter->Status());
+}
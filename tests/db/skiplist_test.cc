@@ -0,0 +1,144 @@
+#include "rosekv/db/skiplist.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace rosekv;
+
+namespace {
+
+struct IntComparator {
+  int operator()(uint64_t a, uint64_t b) const {
+    return a < b ? -1 : a > b ? 1 : 0;
+  }
+};
+
+using IntSkipList = SkipList<uint64_t, IntComparator>;
+
+}  // namespace
+
+TEST(SkipList, Empty) {
+  ConcurrentArena arena;
+  IntSkipList list{IntComparator{}, &arena};
+  IntSkipList::Iterator iter{&list};
+
+  EXPECT_FALSE(list.Contains(10));
+
+  iter.SeekToFirst();
+  EXPECT_FALSE(iter.Valid());
+  iter.Seek(100);
+  EXPECT_FALSE(iter.Valid());
+  iter.SeekToLast();
+  EXPECT_FALSE(iter.Valid());
+}
+
+TEST(SkipList, InsertAndLookup) {
+  constexpr int kNumKeys = 2000;
+  std::mt19937_64 rng{301};
+  std::set<uint64_t> keys;
+  ConcurrentArena arena;
+  IntSkipList list{IntComparator{}, &arena};
+
+  for (int i = 0; i < kNumKeys; ++i) {
+    auto key = rng() % 5000;
+
+    if (keys.insert(key).second) {
+      list.Insert(key);
+    }
+  }
+
+  for (uint64_t key = 0; key < 5000; ++key) {
+    EXPECT_EQ(keys.count(key) == 1, list.Contains(key)) << " key: " << key;
+  }
+
+  IntSkipList::Iterator iter{&list};
+
+  // Forward and backward iteration visit the keys in order.
+  iter.SeekToFirst();
+
+  for (auto key : keys) {
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(key, iter.key());
+    iter.Next();
+  }
+
+  EXPECT_FALSE(iter.Valid());
+
+  iter.SeekToLast();
+
+  for (auto it = keys.rbegin(); it != keys.rend(); ++it) {
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(*it, iter.key());
+    iter.Prev();
+  }
+
+  EXPECT_FALSE(iter.Valid());
+
+  for (uint64_t key = 0; key < 5000; key += 7) {
+    iter.Seek(key);
+    auto expected = keys.lower_bound(key);
+
+    if (expected == keys.end()) {
+      EXPECT_FALSE(iter.Valid());
+    } else {
+      ASSERT_TRUE(iter.Valid());
+      EXPECT_EQ(*expected, iter.key());
+    }
+  }
+}
+
+TEST(SkipList, ConcurrentInsertsAndReads) {
+  constexpr int kNumWriters = 4;
+  constexpr uint64_t kKeysPerWriter = 20000;
+  ConcurrentArena arena;
+  IntSkipList list{IntComparator{}, &arena};
+  std::atomic<bool> done{false};
+
+  // Readers check the keys they see are always sorted while writers race.
+  std::thread reader([&] {
+    while (!done.load()) {
+      IntSkipList::Iterator iter{&list};
+      uint64_t prev = 0;
+      bool first = true;
+
+      for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+        ASSERT_TRUE(first || prev < iter.key());
+        prev = iter.key();
+        first = false;
+      }
+    }
+  });
+
+  std::vector<std::thread> writers;
+
+  for (int w = 0; w < kNumWriters; ++w) {
+    writers.emplace_back([&list, w] {
+      // Interleave the writers' keys so that they contend on the same nodes.
+      for (uint64_t i = 0; i < kKeysPerWriter; ++i) {
+        list.Insert(i * kNumWriters + w);
+      }
+    });
+  }
+
+  for (auto& writer : writers) {
+    writer.join();
+  }
+
+  done = true;
+  reader.join();
+
+  IntSkipList::Iterator iter{&list};
+  uint64_t expected = 0;
+
+  for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+    ASSERT_EQ(expected++, iter.key());
+  }
+
+  EXPECT_EQ(kNumWriters * kKeysPerWriter, expected);
+}
@@ -0,0 +1,469 @@
+#include "rosekv/db/version.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <kiwi/io/file_enumerator.hh>
+#include <kiwi/io/file_util.hh>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <limits>
+#include <string>
+
+#include "rosekv/db/compaction_picker.hh"
+#include "rosekv/db/error_code.hh"
+#include "rosekv/db/filename.hh"
+#include "rosekv/table/table_builder.hh"
+
+using namespace rosekv;
+
+namespace {
+
+std::string UserKey(int i) {
+  char key[32];
+  std::snprintf(key, sizeof(key), "user-key-%08d", i);
+
+  return key;
+}
+
+}  // namespace
+
+class VersionTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    db_path_ = temp_dir_.GetPath();
+
+    options_.num_levels = 4;
+    options_.level0_file_num_compaction_trigger = 2;
+    options_.max_bytes_for_level_base = 1;
+  }
+
+  /// Writes table `number` holding the keys in [`begin`, `end`), each at
+  /// sequence number `sequence` with the value `value`.
+  std::shared_ptr<FileMetaData> AddTable(uint64_t number, int begin, int end,
+                                         SequenceNumber sequence,
+                                         const std::string& value) {
+    auto path = db_path_.Append(TableFileName(number));
+    std::error_code ec;
+
+    {
+      TableBuilder builder{options_.table, path};
+
+      for (int i = begin; i < end; ++i) {
+        std::string key;
+        AppendInternalKey(&key, UserKey(i), sequence, ValueType::kValue);
+        builder.Add(key, value);
+      }
+
+      builder.Finish(ec);
+      EXPECT_FALSE(ec);
+    }
+
+    auto table = std::make_shared<Table>(path, options_.table);
+    EXPECT_FALSE(table->Status());
+
+    return NewFileMetaData(number, std::move(table));
+  }
+
+  kiwi::ScopedTempDir temp_dir_;
+  kiwi::FilePath db_path_;
+  DBOptions options_;
+};
+
+TEST_F(VersionTest, GetSearchesLevelsNewestFirst) {
+  VersionSet versions{options_, db_path_};
+  std::error_code ec;
+
+  versions.Recover(ec);
+  ASSERT_FALSE(ec);
+
+  VersionEdit edit;
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 50, 30, "l0-old"));
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 40, 60, 40, "l0-new"));
+  edit.AddFile(1, AddTable(versions.NewFileNumber(), 0, 100, 20, "l1-a"));
+  edit.AddFile(1, AddTable(versions.NewFileNumber(), 100, 200, 20, "l1-b"));
+  edit.AddFile(2, AddTable(versions.NewFileNumber(), 0, 300, 10, "l2"));
+
+  versions.LogAndApply(edit, ec);
+  ASSERT_FALSE(ec);
+
+  auto version = versions.Current();
+  EXPECT_EQ(5u, version->NumFiles());
+  EXPECT_EQ(40u, version->GetFiles(0).front()->largest_sequence);
+  EXPECT_EQ(40u, versions.LastSequence());
+
+  auto get = [&](int i) {
+    std::string value;
+    auto result = version->Get(UserKey(i), kMaxSequenceNumber, &value, ec);
+    EXPECT_FALSE(ec);
+
+    return result == LookupResult::kFound ? value : "";
+  };
+
+  EXPECT_EQ("l0-old", get(0));
+  EXPECT_EQ("l0-new", get(45));
+  EXPECT_EQ("l1-a", get(70));
+  EXPECT_EQ("l1-b", get(100));
+  EXPECT_EQ("l2", get(250));
+  EXPECT_EQ("", get(300));
+
+  EXPECT_EQ(1u,
+            version->GetOverlappingFiles(1, UserKey(99), UserKey(99)).size());
+  EXPECT_EQ(2u, version->GetOverlappingFiles(1, UserKey(99), UserKey(100))
+                    .size());
+}
+
+TEST_F(VersionTest, RecoversLevels) {
+  std::error_code ec;
+
+  {
+    VersionSet versions{options_, db_path_};
+    versions.Recover(ec);
+    ASSERT_FALSE(ec);
+
+    VersionEdit edit;
+    edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 10, 2, "a"));
+    edit.AddFile(2, AddTable(versions.NewFileNumber(), 0, 10, 1, "b"));
+    versions.LogAndApply(edit, ec);
+    ASSERT_FALSE(ec);
+
+    // Compacts the level 0 file into level 1.
+    edit = {};
+    edit.DeleteFile(0, 1);
+    edit.AddFile(1, AddTable(versions.NewFileNumber(), 0, 10, 2, "a"));
+    versions.LogAndApply(edit, ec);
+    ASSERT_FALSE(ec);
+    kiwi::DeleteFile(db_path_.Append(TableFileName(1)));
+
+    // An output never installed, and an interrupted flush.
+    AddTable(versions.NewFileNumber(), 0, 10, 3, "c");
+    AddTable(versions.NewFileNumber(), 0, 10, 3, "d");
+    ASSERT_TRUE(kiwi::ReplaceFile(db_path_.Append(TableFileName(5)),
+                                  db_path_.Append(TempFileName(5)), nullptr));
+  }
+
+  VersionSet versions{options_, db_path_};
+  versions.Recover(ec);
+  ASSERT_FALSE(ec);
+
+  auto version = versions.Current();
+  EXPECT_EQ(0u, version->GetFiles(0).size());
+  ASSERT_EQ(1u, version->GetFiles(1).size());
+  EXPECT_EQ(3u, version->GetFiles(1).front()->number);
+  ASSERT_EQ(1u, version->GetFiles(2).size());
+  EXPECT_EQ(2u, version->GetFiles(2).front()->number);
+
+  EXPECT_FALSE(kiwi::PathExists(db_path_.Append(TableFileName(4))));
+  EXPECT_FALSE(kiwi::PathExists(db_path_.Append(TempFileName(5))));
+  EXPECT_EQ(6u, versions.NewFileNumber());
+}
+
+TEST_F(VersionTest, MissingTableIsCorruption) {
+  std::error_code ec;
+
+  {
+    VersionSet versions{options_, db_path_};
+    versions.Recover(ec);
+
+    VersionEdit edit;
+    edit.AddFile(1, AddTable(versions.NewFileNumber(), 0, 10, 1, "a"));
+    versions.LogAndApply(edit, ec);
+    ASSERT_FALSE(ec);
+  }
+
+  kiwi::DeleteFile(db_path_.Append(TableFileName(1)));
+
+  VersionSet versions{options_, db_path_};
+  versions.Recover(ec);
+  EXPECT_EQ(DBError::kCorruption, ec);
+}
+
+TEST_F(VersionTest, WithoutManifestTablesGoToLevel0) {
+  AddTable(7, 0, 10, 1, "a");
+  AddTable(8, 5, 15, 2, "b");
+
+  VersionSet versions{options_, db_path_};
+  std::error_code ec;
+  versions.Recover(ec);
+  ASSERT_FALSE(ec);
+
+  EXPECT_EQ(2u, versions.Current()->GetFiles(0).size());
+  EXPECT_EQ(8u, versions.Current()->GetFiles(0).front()->number);
+  EXPECT_EQ(2u, versions.LastSequence());
+  EXPECT_TRUE(kiwi::PathExists(db_path_.Append(kCurrentFileName)));
+  EXPECT_TRUE(kiwi::PathExists(db_path_.Append(ManifestFileName(1))));
+  EXPECT_EQ(9u, versions.NewFileNumber());
+}
+
+TEST_F(VersionTest, VersionEditRoundTrips) {
+  VersionEdit edit;
+  auto file = std::make_shared<FileMetaData>();
+  file->number = 12;
+  edit.AddFile(3, file);
+  edit.DeleteFile(1, 7);
+  edit.next_file_number = 13;
+  edit.min_wal_segment_id = 4;
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+
+  VersionEdit decoded;
+  ASSERT_TRUE(decoded.DecodeFrom(encoded));
+  ASSERT_EQ(1u, decoded.new_files.size());
+  EXPECT_EQ(3, decoded.new_files[0].first);
+  EXPECT_EQ(12u, decoded.new_files[0].second->number);
+  EXPECT_EQ(edit.deleted_files, decoded.deleted_files);
+  EXPECT_EQ(13u, decoded.next_file_number);
+  EXPECT_FALSE(decoded.last_sequence.has_value());
+  EXPECT_EQ(4u, decoded.min_wal_segment_id);
+  EXPECT_FALSE(decoded.next_wal_segment_id.has_value());
+
+  EXPECT_FALSE(decoded.DecodeFrom(encoded.substr(0, encoded.size() - 1)));
+  EXPECT_FALSE(decoded.DecodeFrom("\x63\x01"));
+}
+
+TEST_F(VersionTest, RecoversCountersAndIgnoresTornEdit) {
+  std::error_code ec;
+  int64_t manifest_size;
+
+  {
+    VersionSet versions{options_, db_path_};
+    versions.Recover(ec);
+    ASSERT_FALSE(ec);
+
+    VersionEdit edit;
+    edit.AddFile(1, AddTable(versions.NewFileNumber(), 0, 10, 5, "a"));
+    edit.last_sequence = 100;
+    edit.min_wal_segment_id = 3;
+    edit.next_wal_segment_id = 7;
+    versions.LogAndApply(edit, ec);
+    ASSERT_FALSE(ec);
+
+    kiwi::File manifest{
+        db_path_.Append(ManifestFileName(versions.ManifestNumber())),
+        kiwi::File::kFlagOpen | kiwi::File::kFlagRead};
+    manifest_size = manifest.GetLength();
+
+    // The last edit is cut short by a crash.
+    edit = {};
+    edit.DeleteFile(1, 1);
+    edit.AddFile(2, AddTable(versions.NewFileNumber(), 0, 10, 6, "b"));
+    versions.LogAndApply(edit, ec);
+    ASSERT_FALSE(ec);
+  }
+
+  {
+    kiwi::File manifest{db_path_.Append(ManifestFileName(1)),
+                        kiwi::File::kFlagOpen | kiwi::File::kFlagWrite};
+    ASSERT_TRUE(manifest.SetLength(manifest_size + 3));
+  }
+
+  VersionSet versions{options_, db_path_};
+  versions.Recover(ec);
+  ASSERT_FALSE(ec);
+
+  // Sequence numbers never go back, even if the table holding the largest
+  // one is gone.
+  EXPECT_EQ(100u, versions.LastSequence());
+  EXPECT_EQ(3u, versions.MinWALSegmentId());
+  EXPECT_EQ(7u, versions.NextWALSegmentId());
+
+  auto version = versions.Current();
+  ASSERT_EQ(1u, version->GetFiles(1).size());
+  EXPECT_EQ(1u, version->GetFiles(1).front()->number);
+  EXPECT_EQ(0u, version->GetFiles(2).size());
+  EXPECT_FALSE(kiwi::PathExists(db_path_.Append(TableFileName(2))));
+  EXPECT_EQ(3u, versions.NewFileNumber());
+
+  // The replayed MANIFEST is replaced by a snapshot.
+  EXPECT_EQ(2u, versions.ManifestNumber());
+  EXPECT_FALSE(kiwi::PathExists(db_path_.Append(ManifestFileName(1))));
+}
+
+TEST_F(VersionTest, ManifestRollsOverToSnapshot) {
+  options_.max_manifest_file_size = 256;
+  std::error_code ec;
+
+  {
+    VersionSet versions{options_, db_path_};
+    versions.Recover(ec);
+    ASSERT_FALSE(ec);
+
+    VersionEdit edit;
+    edit.AddFile(1, AddTable(versions.NewFileNumber(), 0, 10, 1, "a"));
+    edit.AddFile(1, AddTable(versions.NewFileNumber(), 10, 20, 2, "b"));
+    versions.LogAndApply(edit, ec);
+    ASSERT_FALSE(ec);
+
+    // Moves the files back and forth between levels 1 and 2.
+    for (int i = 0; i < 100; ++i) {
+      auto version = versions.Current();
+      int from = version->GetFiles(1).empty() ? 2 : 1;
+      edit = {};
+
+      for (const auto& file : version->GetFiles(from)) {
+        edit.DeleteFile(from, file->number);
+        edit.AddFile(3 - from, file);
+      }
+
+      versions.LogAndApply(edit, ec);
+      ASSERT_FALSE(ec);
+    }
+
+    EXPECT_GT(versions.ManifestNumber(), 2u);
+  }
+
+  // Only the active MANIFEST is left, and it stays small.
+  int num_manifests = 0;
+  kiwi::FileEnumerator file_iter(db_path_, false,
+                                 kiwi::FileEnumerator::kFiles);
+
+  for (auto fp = file_iter.Next(); !fp.empty(); fp = file_iter.Next()) {
+    if (ParseManifestFileName(fp.BaseName().value())) {
+      ++num_manifests;
+      EXPECT_LT(kiwi::File(fp, kiwi::File::kFlagOpen | kiwi::File::kFlagRead)
+                    .GetLength(),
+                2 * options_.max_manifest_file_size);
+    }
+  }
+
+  EXPECT_EQ(1, num_manifests);
+
+  VersionSet versions{options_, db_path_};
+  versions.Recover(ec);
+  ASSERT_FALSE(ec);
+
+  // An even number of moves leaves the files at level 1.
+  EXPECT_EQ(2u, versions.Current()->GetFiles(1).size());
+  EXPECT_EQ(0u, versions.Current()->GetFiles(2).size());
+  EXPECT_EQ(2u, versions.LastSequence());
+}
+
+TEST_F(VersionTest, LeveledPickerCompactsLevel0IntoOverlappingFiles) {
+  VersionSet versions{options_, db_path_};
+  std::error_code ec;
+  versions.Recover(ec);
+
+  VersionEdit edit;
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 10, 3, "a"));
+  edit.AddFile(1, AddTable(versions.NewFileNumber(), 0, 5, 1, "b"));
+  edit.AddFile(1, AddTable(versions.NewFileNumber(), 20, 30, 1, "c"));
+  versions.LogAndApply(edit, ec);
+  ASSERT_FALSE(ec);
+
+  auto picker = NewLeveledCompactionPicker(options_);
+
+  // Level 1 is over its target, and level 0 is under its trigger.
+  auto compaction = picker->PickCompaction(versions.Current());
+  ASSERT_NE(nullptr, compaction);
+  EXPECT_EQ(1, compaction->start_level());
+  EXPECT_EQ(2, compaction->output_level());
+  EXPECT_TRUE(compaction->inputs().front().files.front()->being_compacted);
+
+  // The other file of level 1 is still idle, and is picked next.
+  auto next = picker->PickCompaction(versions.Current());
+  ASSERT_NE(nullptr, next);
+  EXPECT_NE(compaction->inputs().front().files.front(),
+            next->inputs().front().files.front());
+  EXPECT_EQ(nullptr, picker->PickCompaction(versions.Current()));
+
+  compaction->MarkFilesBeingCompacted(false);
+  next->MarkFilesBeingCompacted(false);
+
+  edit = {};
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 3, 4, 4, "d"));
+  versions.LogAndApply(edit, ec);
+  ASSERT_FALSE(ec);
+
+  // Two level 0 files reach the trigger, and their range overlaps the first
+  // file of level 1 only.
+  options_.max_bytes_for_level_base = 1 << 30;
+  picker = NewLeveledCompactionPicker(options_);
+  compaction = picker->PickCompaction(versions.Current());
+  ASSERT_NE(nullptr, compaction);
+  EXPECT_EQ(0, compaction->start_level());
+  EXPECT_EQ(1, compaction->output_level());
+  EXPECT_EQ(3u, compaction->NumInputFiles());
+  ASSERT_EQ(1u, compaction->inputs()[1].files.size());
+  EXPECT_EQ(2u, compaction->inputs()[1].files.front()->number);
+  EXPECT_TRUE(compaction->IsBaseLevelForKey(UserKey(0)));
+
+  // Level 0 is busy until the compaction completes.
+  EXPECT_EQ(nullptr, picker->PickCompaction(versions.Current()));
+}
+
+TEST_F(VersionTest, TieredPickerMergesRunsOfSimilarSizes) {
+  VersionSet versions{options_, db_path_};
+  std::error_code ec;
+  versions.Recover(ec);
+
+  VersionEdit edit;
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 100, 4, "a"));
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 100, 3, "b"));
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 50, 150, 2, "c"));
+  edit.AddFile(3, AddTable(versions.NewFileNumber(), 0, 5000, 1, "d"));
+  versions.LogAndApply(edit, ec);
+  ASSERT_FALSE(ec);
+
+  auto picker = NewTieredCompactionPicker(options_);
+
+  // The files of level 0 have similar sizes, while level 3 is much larger.
+  auto compaction = picker->PickCompaction(versions.Current());
+  ASSERT_NE(nullptr, compaction);
+  ASSERT_EQ(1u, compaction->inputs().size());
+  EXPECT_EQ(0, compaction->start_level());
+  EXPECT_EQ(3u, compaction->NumInputFiles());
+  EXPECT_EQ(2, compaction->output_level());
+  EXPECT_FALSE(compaction->IsBaseLevelForKey(UserKey(0)));
+
+  // Only level 3 is left idle.
+  EXPECT_EQ(nullptr, picker->PickCompaction(versions.Current()));
+}
+
+TEST_F(VersionTest, TieredPickerKeepsOlderRunsOfLevel0) {
+  VersionSet versions{options_, db_path_};
+  std::error_code ec;
+  versions.Recover(ec);
+
+  VersionEdit edit;
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 100, 3, "a"));
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 100, 2, "b"));
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 100, 5000, 1, "c"));
+  versions.LogAndApply(edit, ec);
+  ASSERT_FALSE(ec);
+
+  auto picker = NewTieredCompactionPicker(options_);
+  auto compaction = picker->PickCompaction(versions.Current());
+  ASSERT_NE(nullptr, compaction);
+  EXPECT_EQ(2u, compaction->NumInputFiles());
+
+  // The output stays in level 0 above the oldest file, as a single file,
+  // and deletions of keys the oldest file holds are kept.
+  EXPECT_EQ(0, compaction->output_level());
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(),
+            compaction->max_output_file_size());
+  EXPECT_TRUE(compaction->IsBaseLevelForKey(UserKey(50)));
+  EXPECT_FALSE(compaction->IsBaseLevelForKey(UserKey(150)));
+}
+
+TEST_F(VersionTest, TieredPickerBoundsSizeAmplification) {
+  VersionSet versions{options_, db_path_};
+  std::error_code ec;
+  versions.Recover(ec);
+
+  VersionEdit edit;
+  edit.AddFile(0, AddTable(versions.NewFileNumber(), 0, 4000, 3, "a"));
+  edit.AddFile(1, AddTable(versions.NewFileNumber(), 0, 100, 2, "b"));
+  edit.AddFile(2, AddTable(versions.NewFileNumber(), 0, 1000, 1, "c"));
+  versions.LogAndApply(edit, ec);
+  ASSERT_FALSE(ec);
+
+  // The newer runs are more than twice as large as the oldest one, so all
+  // of them are merged into the last level.
+  auto compaction = NewTieredCompactionPicker(options_)->PickCompaction(
+      versions.Current());
+  ASSERT_NE(nullptr, compaction);
+  EXPECT_EQ(3u, compaction->NumInputFiles());
+  EXPECT_EQ(3u, compaction->inputs().size());
+  EXPECT_EQ(2, compaction->output_level());
+}
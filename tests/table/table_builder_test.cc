@@ -0,0 +1,188 @@
+#include "rosekv/table/table_builder.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rosekv/db/dbformat.hh"
+
+using namespace rosekv;
+
+namespace {
+
+using Entries = std::vector<std::pair<std::string, std::string>>;
+
+std::string ReadFile(const kiwi::FilePath& path) {
+  kiwi::File file{path, kiwi::File::kFlagOpen | kiwi::File::kFlagRead};
+  std::string contents(file.GetLength(), '\0');
+  file.Read(0, contents.data(), contents.size());
+
+  return contents;
+}
+
+/// Checks the trailer of the block at `handle` and returns its contents.
+std::string_view GetBlock(std::string_view file, const BlockHandle& handle,
+                          ChecksumType type) {
+  auto contents = file.substr(handle.offset, handle.size);
+  DynamicChecksum checksum{type};
+  checksum.Update(kiwi::span<const uint8_t>{
+      reinterpret_cast<const uint8_t*>(contents.data()), contents.size()});
+
+  EXPECT_EQ(checksum.Digest(),
+            DecodeFixed32(file.data() + handle.offset + handle.size));
+
+  return contents;
+}
+
+/// Decodes every entry of a block into `entries`, following the key deltas.
+void DecodeBlock(std::string_view block, Entries* entries) {
+  auto num_restarts = DecodeFixed32(block.data() + block.size() - 4);
+  std::string_view input =
+      block.substr(0, block.size() - (num_restarts + 1) * 4);
+  std::string key;
+
+  while (!input.empty()) {
+    uint64_t shared = 0;
+    uint64_t non_shared = 0;
+    uint64_t value_size = 0;
+    ASSERT_TRUE(GetVarint64(&input, &shared) &&
+                GetVarint64(&input, &non_shared) &&
+                GetVarint64(&input, &value_size));
+
+    key.resize(shared);
+    key.append(input.substr(0, non_shared));
+    input.remove_prefix(non_shared);
+    entries->emplace_back(key, input.substr(0, value_size));
+    input.remove_prefix(value_size);
+  }
+}
+
+std::string InternalKey(const std::string& user_key, SequenceNumber sequence) {
+  std::string key;
+  AppendInternalKey(&key, user_key, sequence, ValueType::kValue);
+
+  return key;
+}
+
+}  // namespace
+
+class TableBuilderTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().Append("000001.sst");
+  }
+
+  kiwi::ScopedTempDir temp_dir_;
+  kiwi::FilePath path_;
+};
+
+TEST_F(TableBuilderTest, WritesBlocksIndexAndProperties) {
+  TableOptions options;
+  options.block_size = 1024;
+  options.checksum = ChecksumType::kXXH64;
+
+  Entries expected;
+  TableBuilder builder{options, path_};
+
+  for (int i = 0; i < 5000; ++i) {
+    char user_key[32];
+    std::snprintf(user_key, sizeof(user_key), "user-key-%08d", i);
+    expected.emplace_back(InternalKey(user_key, i + 1),
+                          "value-" + std::to_string(i));
+    builder.Add(expected.back().first, expected.back().second);
+  }
+
+  std::error_code ec;
+  builder.Finish(ec);
+  ASSERT_FALSE(ec);
+
+  auto file = ReadFile(path_);
+  ASSERT_EQ(builder.FileSize(), file.size());
+
+  Footer footer;
+  ASSERT_TRUE(footer.DecodeFrom(
+      std::string_view{file}.substr(file.size() - Footer::kEncodedLength)));
+  EXPECT_EQ(ChecksumType::kXXH64, footer.checksum);
+
+  // Walk every data block through the index.
+  Entries entries;
+  Entries index;
+  ASSERT_NO_FATAL_FAILURE(
+      DecodeBlock(GetBlock(file, footer.index, footer.checksum), &index));
+
+  for (const auto& [last_key, encoded_handle] : index) {
+    std::string_view input = encoded_handle;
+    BlockHandle handle;
+    ASSERT_TRUE(handle.DecodeFrom(&input));
+
+    Entries block;
+    ASSERT_NO_FATAL_FAILURE(
+        DecodeBlock(GetBlock(file, handle, footer.checksum), &block));
+    ASSERT_FALSE(block.empty());
+    EXPECT_EQ(last_key, block.back().first);
+    EXPECT_LE(handle.size, 2 * static_cast<uint64_t>(options.block_size));
+    entries.insert(entries.end(), block.begin(), block.end());
+  }
+
+  EXPECT_EQ(expected, entries);
+
+  const auto& props = builder.GetProperties();
+  Entries properties;
+  ASSERT_NO_FATAL_FAILURE(DecodeBlock(
+      GetBlock(file, footer.properties, footer.checksum), &properties));
+
+  EXPECT_EQ(5000u, props.num_entries);
+  EXPECT_EQ(index.size(), props.num_data_blocks);
+  EXPECT_EQ(expected.front().first, props.smallest_key);
+  EXPECT_EQ(expected.back().first, props.largest_key);
+  EXPECT_EQ(5000u, props.max_sequence);
+  ASSERT_EQ(9u, properties.size());
+  EXPECT_EQ(kPropLargestKey, properties[2].first);
+  EXPECT_EQ(props.largest_key, properties[2].second);
+
+  // Shared prefixes are only stored once per restart interval.
+  EXPECT_LT(props.data_size, props.raw_key_size + props.raw_value_size);
+}
+
+TEST_F(TableBuilderTest, EmptyTable) {
+  TableBuilder builder{TableOptions{}, path_};
+  std::error_code ec;
+
+  builder.Finish(ec);
+  ASSERT_FALSE(ec);
+
+  auto file = ReadFile(path_);
+  Footer footer;
+
+  ASSERT_TRUE(footer.DecodeFrom(
+      std::string_view{file}.substr(file.size() - Footer::kEncodedLength)));
+
+  Entries index;
+  ASSERT_NO_FATAL_FAILURE(
+      DecodeBlock(GetBlock(file, footer.index, footer.checksum), &index));
+  EXPECT_TRUE(index.empty());
+}
+
+TEST(Footer, RejectsCorruption) {
+  Footer footer;
+  footer.index = {100, 20};
+  footer.properties = {124, 50};
+  footer.checksum = ChecksumType::kCrc32c;
+
+  std::string encoded;
+  footer.EncodeTo(&encoded);
+  ASSERT_EQ(Footer::kEncodedLength, encoded.size());
+
+  Footer decoded;
+  ASSERT_TRUE(decoded.DecodeFrom(encoded));
+  EXPECT_EQ(124u, decoded.properties.offset);
+  EXPECT_EQ(50u, decoded.properties.size);
+
+  encoded[3] ^= 1;
+  EXPECT_FALSE(decoded.DecodeFrom(encoded));
+}
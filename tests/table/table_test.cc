@@ -0,0 +1,235 @@
+#include "rosekv/table/table.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <string>
+
+#include "rosekv/db/dbformat.hh"
+#include "rosekv/db/error_code.hh"
+#include "rosekv/table/table_builder.hh"
+
+using namespace rosekv;
+
+namespace {
+
+std::string UserKey(int i) {
+  char key[32];
+  std::snprintf(key, sizeof(key), "user-key-%08d", i);
+
+  return key;
+}
+
+std::string InternalKey(const std::string& user_key, SequenceNumber sequence,
+                        ValueType type = ValueType::kValue) {
+  std::string key;
+  AppendInternalKey(&key, user_key, sequence, type);
+
+  return key;
+}
+
+}  // namespace
+
+class TableTest : public testing::TestWithParam<TableReadMode> {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.GetPath().Append("000001.sst");
+
+    options_.block_size = 1024;
+    options_.read_mode = GetParam();
+  }
+
+  /// Writes the even keys below `2 * n`, each with two versions: a value at
+  /// sequence `2 * i + 2` over a value at `2 * i + 1`. Every key divisible
+  /// by 10 is deleted in its newer version.
+  void BuildTable(int n) {
+    TableBuilder builder{options_, path_};
+
+    for (int i = 0; i < 2 * n; i += 2) {
+      auto user_key = UserKey(i);
+
+      if (i % 10 == 0) {
+        builder.Add(InternalKey(user_key, i + 2, ValueType::kDeletion), "");
+      } else {
+        builder.Add(InternalKey(user_key, i + 2), "new-" + std::to_string(i));
+      }
+
+      builder.Add(InternalKey(user_key, i + 1), "old-" + std::to_string(i));
+    }
+
+    std::error_code ec;
+    builder.Finish(ec);
+    ASSERT_FALSE(ec);
+  }
+
+  kiwi::ScopedTempDir temp_dir_;
+  kiwi::FilePath path_;
+  TableOptions options_;
+};
+
+TEST_P(TableTest, Get) {
+  BuildTable(2000);
+
+  Table table{path_, options_};
+  ASSERT_FALSE(table.Status());
+  EXPECT_EQ(4000u, table.GetProperties().num_entries);
+  EXPECT_EQ(4000u, table.GetProperties().max_sequence);
+  EXPECT_GT(table.GetProperties().num_data_blocks, 1u);
+
+  std::error_code ec;
+  std::string value;
+
+  for (int i = 0; i < 4000; ++i) {
+    auto user_key = UserKey(i);
+    auto result = table.Get(user_key, kMaxSequenceNumber, &value, ec);
+    ASSERT_FALSE(ec);
+
+    if (i % 2 != 0) {
+      EXPECT_EQ(LookupResult::kNotFound, result) << user_key;
+    } else if (i % 10 == 0) {
+      EXPECT_EQ(LookupResult::kDeleted, result) << user_key;
+    } else {
+      ASSERT_EQ(LookupResult::kFound, result) << user_key;
+      EXPECT_EQ("new-" + std::to_string(i), value);
+    }
+  }
+
+  // Reading at an older sequence number sees the older version.
+  for (int i = 0; i < 4000; i += 2) {
+    ASSERT_EQ(LookupResult::kFound, table.Get(UserKey(i), i + 1, &value, ec));
+    EXPECT_EQ("old-" + std::to_string(i), value);
+    EXPECT_EQ(LookupResult::kNotFound, table.Get(UserKey(i), i, &value, ec));
+  }
+
+  EXPECT_EQ(LookupResult::kNotFound,
+            table.Get("user-key-99999999", kMaxSequenceNumber, &value, ec));
+  EXPECT_EQ(LookupResult::kNotFound,
+            table.Get("a", kMaxSequenceNumber, &value, ec));
+  EXPECT_FALSE(ec);
+}
+
+TEST_P(TableTest, Iterator) {
+  BuildTable(1000);
+
+  Table table{path_, options_};
+  ASSERT_FALSE(table.Status());
+
+  auto iter = table.NewIterator();
+  std::string last_key;
+  int count = 0;
+
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (count > 0) {
+      EXPECT_LT(InternalKeyComparator{}(last_key, iter->key()), 0);
+    }
+
+    last_key.assign(iter->key());
+    ++count;
+  }
+
+  EXPECT_FALSE(iter->Status());
+  EXPECT_EQ(2000, count);
+  EXPECT_EQ(table.GetProperties().largest_key, last_key);
+
+  // Seeking to an absent key lands on the next one.
+  iter->Seek(InternalKey(UserKey(501), kMaxSequenceNumber));
+  ASSERT_TRUE(iter->Valid());
+  EXPECT_EQ(InternalKey(UserKey(502), 504), iter->key());
+  EXPECT_EQ("new-502", iter->value());
+
+  iter->Seek(InternalKey(UserKey(2000), kMaxSequenceNumber));
+  EXPECT_FALSE(iter->Valid());
+  EXPECT_FALSE(iter->Status());
+}
+
+TEST_P(TableTest, ApproximateOffsetOf) {
+  BuildTable(2000);
+
+  Table table{path_, options_};
+  ASSERT_FALSE(table.Status());
+
+  auto data_size = table.GetProperties().data_size;
+  auto offset_of = [&](int i) {
+    return table.ApproximateOffsetOf(
+        InternalKey(UserKey(i), kMaxSequenceNumber));
+  };
+
+  EXPECT_EQ(0u, table.ApproximateOffsetOf(InternalKey("a", 1)));
+  EXPECT_EQ(0u, offset_of(0));
+
+  // The offsets grow with the keys, in steps of about a block.
+  EXPECT_LT(offset_of(1000), offset_of(3000));
+  EXPECT_NEAR(data_size / 2.0, offset_of(2000), options_.block_size * 2);
+  EXPECT_LE(offset_of(3998), data_size);
+  EXPECT_GE(offset_of(4000), data_size);
+}
+
+TEST_P(TableTest, EmptyTable) {
+  BuildTable(0);
+
+  Table table{path_, options_};
+  ASSERT_FALSE(table.Status());
+
+  std::error_code ec;
+  std::string value;
+  EXPECT_EQ(LookupResult::kNotFound,
+            table.Get("key", kMaxSequenceNumber, &value, ec));
+  EXPECT_FALSE(ec);
+
+  auto iter = table.NewIterator();
+  iter->SeekToFirst();
+  EXPECT_FALSE(iter->Valid());
+}
+
+TEST_P(TableTest, DetectsCorruptedDataBlock) {
+  BuildTable(1000);
+
+  {
+    // Flip a byte in the middle of the first data block.
+    kiwi::File file{path_, kiwi::File::kFlagOpen | kiwi::File::kFlagRead |
+                               kiwi::File::kFlagWrite};
+    char byte;
+    ASSERT_EQ(1, file.Read(100, &byte, 1));
+    byte ^= 0x40;
+    ASSERT_EQ(1, file.Write(100, &byte, 1));
+  }
+
+  Table table{path_, options_};
+  ASSERT_FALSE(table.Status());
+
+  std::error_code ec;
+  std::string value;
+  table.Get(UserKey(0), kMaxSequenceNumber, &value, ec);
+  EXPECT_EQ(DBError::kCorruption, ec);
+
+  // Keys of other blocks are still readable.
+  ec.clear();
+  EXPECT_EQ(LookupResult::kFound,
+            table.Get(UserKey(1998), kMaxSequenceNumber, &value, ec));
+  EXPECT_FALSE(ec);
+
+  auto iter = table.NewIterator();
+  iter->SeekToFirst();
+  EXPECT_FALSE(iter->Valid());
+  EXPECT_EQ(DBError::kCorruption, iter->Status());
+}
+
+TEST_P(TableTest, DetectsCorruptedFooter) {
+  BuildTable(10);
+
+  {
+    kiwi::File file{path_, kiwi::File::kFlagOpen | kiwi::File::kFlagRead |
+                               kiwi::File::kFlagWrite};
+    char byte = 0;
+    ASSERT_EQ(1, file.Write(file.GetLength() - 1, &byte, 1));
+  }
+
+  Table table{path_, options_};
+  EXPECT_EQ(DBError::kCorruption, table.Status());
+}
+
+INSTANTIATE_TEST_SUITE_P(ReadModes, TableTest,
+                         testing::Values(TableReadMode::kPread,
+                                         TableReadMode::kMmap));
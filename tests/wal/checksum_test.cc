@@ -0,0 +1,114 @@
+#include "rosekv/wal/checksum.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+using namespace rosekv;
+
+namespace {
+
+template <typename Checksum>
+uint32_t Digest(std::string_view data) {
+  Checksum checksum;
+  checksum.Update(kiwi::span<const uint8_t>{
+      reinterpret_cast<const uint8_t*>(data.data()), data.size()});
+
+  return checksum.Digest();
+}
+
+std::vector<uint8_t> Iota(std::size_t n) {
+  std::vector<uint8_t> data(n);
+  std::iota(data.begin(), data.end(), 0);
+
+  return data;
+}
+
+}  // namespace
+
+TEST(Checksum, KnownValues) {
+  EXPECT_EQ(0u, Digest<Crc32Checksum>(""));
+  EXPECT_EQ(0xcbf43926u, Digest<Crc32Checksum>("123456789"));
+
+  EXPECT_EQ(0u, Digest<Crc32cChecksum>(""));
+  EXPECT_EQ(0xe3069283u, Digest<Crc32cChecksum>("123456789"));
+
+  // The low 32 bits of XXH64 with seed 0.
+  EXPECT_EQ(0x51d8e999u, Digest<XXH64Checksum>(""));
+  EXPECT_EQ(0xad770999u, Digest<XXH64Checksum>("abc"));
+  EXPECT_EQ(0x40e6ae83u, Digest<XXH64Checksum>("123456789"));
+
+  // Covers the 32-byte stripes, with the bytes 0 to 255 repeated.
+  auto data = Iota(1024);
+  XXH64Checksum xxh64;
+  xxh64.Update(data);
+  EXPECT_EQ(0x8fe4df57u, xxh64.Digest());
+}
+
+// Both CRC32C kernels are tested whatever the CPU dispatches to, the
+// hardware one only where the CPU supports it.
+TEST(Checksum, Crc32cKernels) {
+  std::string_view check = "123456789";
+  auto ptr = reinterpret_cast<const uint8_t*>(check.data());
+  EXPECT_EQ(0xe3069283u,
+            ~detail::Crc32cSoftware(~0u, ptr, ptr + check.size()));
+
+#if defined(__x86_64__)
+  if (!detail::HasSse42()) {
+    GTEST_SKIP() << "SSE4.2 is not supported";
+  }
+
+  EXPECT_EQ(0xe3069283u, ~detail::Crc32cSse42(~0u, ptr, ptr + check.size()));
+
+  // Covers the 8-byte loop and the byte tail of the hardware kernel.
+  auto data = Iota(1000);
+
+  for (std::size_t len : {1, 7, 8, 9, 63, 64, 1000}) {
+    auto end = data.data() + len;
+
+    EXPECT_EQ(detail::Crc32cSoftware(~0u, data.data(), end),
+              detail::Crc32cSse42(~0u, data.data(), end))
+        << " with length: " << len;
+  }
+#endif
+}
+
+template <typename T>
+class ChecksumTest : public testing::Test {};
+
+using ChecksumTypes =
+    testing::Types<Crc32Checksum, Crc32cChecksum, XXH64Checksum>;
+TYPED_TEST_SUITE(ChecksumTest, ChecksumTypes);
+
+TYPED_TEST(ChecksumTest, UpdatesInPiecesMatchSingleUpdate) {
+  auto data = Iota(1000);
+  kiwi::span<const uint8_t> all{data.data(), data.size()};
+
+  TypeParam whole;
+  whole.Update(all);
+
+  for (std::size_t step : {1, 3, 7, 31, 32, 33, 100, 999}) {
+    TypeParam pieces;
+
+    for (std::size_t i = 0; i < data.size(); i += step) {
+      pieces.Update(all.subspan(i, std::min(step, data.size() - i)));
+    }
+
+    EXPECT_EQ(whole.Digest(), pieces.Digest()) << " with step: " << step;
+  }
+}
+
+TYPED_TEST(ChecksumTest, DynamicMatchesPolicy) {
+  auto data = Iota(1000);
+
+  TypeParam policy;
+  policy.Update(data);
+
+  DynamicChecksum dynamic{TypeParam::kType};
+  dynamic.Update(data);
+
+  EXPECT_EQ(policy.Digest(), dynamic.Digest());
+}
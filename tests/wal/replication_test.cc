@@ -0,0 +1,115 @@
+#include "rosekv/wal/replication.hh"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+
+#include <functional>
+#include <kiwi/containers/span.hh>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rosekv/wal/wal.hh"
+
+using namespace rosekv;
+
+class ReplicationTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(leader_dir_.CreateUniqueTempDir());
+    ASSERT_TRUE(follower_dir_.CreateUniqueTempDir());
+
+    options_.wal_dir = leader_dir_.GetPath().value();
+    options_.max_segment_sz = 4 * options_.block_size;
+    follower_wal_dir_ = follower_dir_.GetPath().value();
+  }
+
+  /// Streams the leader's log to the follower until the follower has
+  /// acknowledged everything written by `write`.
+  void Replicate(WAL& wal, const std::function<void()>& write) {
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+    ReplicationReceiver receiver{follower_wal_dir_, fds[1]};
+    std::error_code receiver_ec;
+    std::thread follower{[&] { receiver.Run(receiver_ec); }};
+
+    {
+      ReplicationSender sender{&wal, fds[0], 4};
+      std::error_code ec;
+
+      sender.Start(ec);
+      ASSERT_FALSE(ec) << ec.message();
+
+      write();
+
+      EXPECT_TRUE(
+          sender.WaitForAck(wal.GetEndLSN(), std::chrono::seconds(10)));
+      EXPECT_FALSE(sender.Status()) << sender.Status().message();
+      EXPECT_EQ(wal.GetEndLSN(), receiver.GetDurableLSN());
+    }
+
+    follower.join();
+    EXPECT_FALSE(receiver_ec) << receiver_ec.message();
+  }
+
+  /// Writes records of several sizes across segments, replicates them over
+  /// two connections and reads them back from the follower.
+  void MirrorLeader() {
+    std::vector<std::pair<LSN, std::string>> records;
+
+    WAL wal{options_};
+    auto write = [&](int from, int to) {
+      for (int i = from; i < to; ++i) {
+        auto data = i % 8 == 0
+                        ? std::string(options_.block_size, 'a' + i % 26)
+                        : "record-" + std::to_string(i);
+        std::error_code ec;
+        auto lsn =
+            wal.Write(kiwi::span(static_cast<std::string_view>(data)), ec);
+        ASSERT_FALSE(ec) << ec.message();
+        records.emplace_back(lsn, std::move(data));
+      }
+    };
+
+    // Sealed segments written before the follower connects are shipped too.
+    write(0, 32);
+    Replicate(wal, [&] { write(32, 128); });
+
+    // A reconnecting follower resumes from its durable position.
+    Replicate(wal, [&] { write(128, 160); });
+
+    Options follower_options = options_;
+    follower_options.wal_dir = follower_wal_dir_;
+    WAL follower{follower_options};
+
+    for (const auto& [lsn, data] : records) {
+      std::error_code ec;
+      EXPECT_EQ(data, follower.Read(lsn, ec)) << "at LSN: " << lsn;
+      EXPECT_FALSE(ec) << ec.message();
+    }
+  }
+
+  kiwi::ScopedTempDir leader_dir_;
+  kiwi::ScopedTempDir follower_dir_;
+  std::string follower_wal_dir_;
+  Options options_;
+};
+
+TEST_F(ReplicationTest, FollowerMirrorsLeader) { MirrorLeader(); }
+
+// Frames are cut at the blocks of the segment, whatever their size.
+TEST_F(ReplicationTest, NonDefaultBlockSizes) {
+  for (int64_t block_size : {4 * 1024, 128 * 1024}) {
+    SCOPED_TRACE(block_size);
+    options_.block_size = block_size;
+    options_.max_segment_sz = 4 * block_size;
+    options_.wal_dir =
+        leader_dir_.GetPath().Append(std::to_string(block_size)).value();
+    follower_wal_dir_ =
+        follower_dir_.GetPath().Append(std::to_string(block_size)).value();
+
+    MirrorLeader();
+  }
+}
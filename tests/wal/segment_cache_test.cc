@@ -0,0 +1,77 @@
+#include "rosekv/wal/segment_cache.hh"
+
+#include <gtest/gtest.h>
+
+#include <kiwi/containers/span.hh>
+#include <kiwi/io/file_util.hh>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <kiwi/io/scoped_temp_file.hh>
+#include <vector>
+
+using namespace rosekv;
+
+TEST(SegmentCache, OpensLazilyAndEvictsLeastRecentlyUsed) {
+  constexpr int kNumSegments = 4;
+  constexpr std::string_view kTestData = "hello";
+
+  std::vector<kiwi::ScopedTempFile> temp_files(kNumSegments);
+
+  for (auto& temp_file : temp_files) {
+    ASSERT_TRUE(temp_file.Create());
+
+    Segment segment{temp_file.Path()};
+    segment.Append(kiwi::span(kTestData));
+    segment.Close();
+  }
+
+  SegmentCache cache{2};
+
+  EXPECT_EQ(0, cache.Size());
+
+  auto first = cache.Get(0, temp_files[0].Path());
+  ASSERT_NE(nullptr, first);
+  EXPECT_EQ(kTestData, first->ReadAt(0));
+
+  // A hit returns the very same handle.
+  EXPECT_EQ(first, cache.Get(0, temp_files[0].Path()));
+
+  ASSERT_NE(nullptr, cache.Get(1, temp_files[1].Path()));
+
+  // Touch 0 so that 1 becomes the least recently used entry.
+  cache.Get(0, temp_files[0].Path());
+  ASSERT_NE(nullptr, cache.Get(2, temp_files[2].Path()));
+
+  EXPECT_EQ(2, cache.Size());
+  EXPECT_EQ(first, cache.Get(0, temp_files[0].Path()));
+
+  // An evicted handle stays usable by whoever still holds it.
+  auto third = cache.Get(2, temp_files[2].Path());
+  cache.Get(3, temp_files[3].Path());
+  cache.Erase(2);
+
+  EXPECT_EQ(kTestData, third->ReadAt(0));
+  EXPECT_LE(cache.Size(), cache.Capacity());
+}
+
+TEST(SegmentCache, OpensSealedSegmentsReadOnly) {
+  constexpr std::string_view kTestData = "hello";
+
+  kiwi::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  auto path = temp_dir.GetPath().Append("000001.seg");
+  SegmentCache cache{2};
+
+  // A read of a missing segment does not create it.
+  EXPECT_EQ(nullptr, cache.Get(1, path));
+  EXPECT_FALSE(kiwi::PathExists(path));
+
+  {
+    Segment segment{path};
+    segment.Append(kiwi::span(kTestData));
+  }
+
+  auto segment = cache.Get(1, path);
+  ASSERT_NE(nullptr, segment);
+  EXPECT_TRUE(segment->IsReadOnly());
+  EXPECT_EQ(kTestData, segment->ReadAt(0));
+}
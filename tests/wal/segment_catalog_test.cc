@@ -0,0 +1,56 @@
+#include "rosekv/wal/segment_catalog.hh"
+
+#include <gtest/gtest.h>
+
+using namespace rosekv;
+
+TEST(SegmentCatalog, FileNameRoundTrip) {
+  EXPECT_EQ("00000000000000000009.seg", SegmentCatalog::SegmentFileName(9));
+  EXPECT_EQ("00000000000000000010.seg", SegmentCatalog::SegmentFileName(10));
+
+  // Zero-padded names sort numerically as strings too.
+  EXPECT_LT(SegmentCatalog::SegmentFileName(9),
+            SegmentCatalog::SegmentFileName(10));
+
+  for (SegmentId id : {SegmentId{0}, SegmentId{42}, UINT64_MAX}) {
+    EXPECT_EQ(id, SegmentCatalog::ParseSegmentFileName(
+                      SegmentCatalog::SegmentFileName(id)));
+  }
+
+  EXPECT_EQ(9, SegmentCatalog::ParseSegmentFileName("9.seg"));
+  EXPECT_FALSE(SegmentCatalog::ParseSegmentFileName(".seg"));
+  EXPECT_FALSE(SegmentCatalog::ParseSegmentFileName("9a.seg"));
+  EXPECT_FALSE(SegmentCatalog::ParseSegmentFileName("9.log"));
+}
+
+TEST(SegmentCatalog, OrdersByNumericId) {
+  SegmentCatalog catalog;
+
+  for (SegmentId id : {10, 8, 9, 11}) {
+    catalog.Add(id, kiwi::FilePath::FromASCII(std::to_string(id) + ".seg"));
+  }
+
+  ASSERT_TRUE(catalog.Seal());
+  EXPECT_EQ(4, catalog.Size());
+  EXPECT_EQ(8, catalog.FirstId());
+  EXPECT_EQ(11, catalog.LastId());
+
+  auto entry = catalog.Find(LSN{10, 128});
+  ASSERT_NE(nullptr, entry);
+  EXPECT_EQ(10, entry->id);
+  EXPECT_EQ(nullptr, catalog.Find(7));
+  EXPECT_EQ(nullptr, catalog.Find(12));
+
+  catalog.PushBack(12, kiwi::FilePath::FromASCII("12.seg"));
+  EXPECT_EQ(12, catalog.LastId());
+}
+
+TEST(SegmentCatalog, RejectsMissingSegments) {
+  SegmentCatalog catalog;
+
+  catalog.Add(1, kiwi::FilePath::FromASCII("1.seg"));
+  catalog.Add(3, kiwi::FilePath::FromASCII("3.seg"));
+
+  EXPECT_FALSE(catalog.Seal());
+  EXPECT_TRUE(catalog.Empty());
+}
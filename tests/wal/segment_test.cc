@@ -2,6 +2,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <iostream>
 #include <kiwi/containers/span.hh>
 #include <kiwi/io/file.hh>
@@ -126,4 +127,464 @@ TEST(Segment, WriteRandomData) {
     EXPECT_EQ(read_back, record.data)
         << " at iteration: " << record.i << ": offset: " << record.offset;
   }
-}
\ No newline at end of file
+}
+
+TEST(Segment, TruncateAfterRecord) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  Segment segment{temp_file.Path()};
+
+  std::string large(Segment::kMaxBlockSize * 2, 'L');
+  auto first = segment.Append(kiwi::span(std::string_view{"first"}));
+  auto second =
+      segment.Append(kiwi::span(static_cast<std::string_view>(large)));
+  auto third = segment.Append(kiwi::span(std::string_view{"third"}));
+
+  EXPECT_EQ(second, segment.NextRecordOffset(first));
+  EXPECT_EQ(third, segment.NextRecordOffset(second));
+  EXPECT_EQ(segment.Size(), segment.NextRecordOffset(third));
+
+  // The continuation chunks of a multi-chunk record do not start a record.
+  EXPECT_FALSE(segment.NextRecordOffset(Segment::kMaxBlockSize));
+  EXPECT_FALSE(segment.NextRecordOffset(segment.Size()));
+
+  // Drop everything after the first record and append from there.
+  ASSERT_TRUE(segment.Truncate(*segment.NextRecordOffset(first)));
+  EXPECT_EQ(second, segment.Size());
+
+  auto replaced = segment.Append(kiwi::span(std::string_view{"replaced"}));
+
+  EXPECT_EQ(second, replaced);
+  EXPECT_EQ("first", segment.ReadAt(first));
+  EXPECT_EQ("replaced", segment.ReadAt(replaced));
+
+  // Reopening resumes from the truncated size.
+  segment.Close();
+  Segment reopened{temp_file.Path()};
+
+  EXPECT_EQ(*reopened.NextRecordOffset(replaced), reopened.Size());
+}
+
+TEST(Segment, ReadBatch) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  Segment segment{temp_file.Path()};
+
+  struct Record {
+    std::string data;
+    Segment::Offset offset;
+  };
+
+  constexpr int kNum = 2000;
+  std::vector<Record> records;
+
+  for (int i = 0; i < kNum; ++i) {
+    // Sprinkle in records spanning several blocks.
+    auto s = i % 100 == 0 ? std::string(Segment::kMaxBlockSize * 2 + i, 'B')
+                          : GenerateRandomString(512);
+    auto offset = segment.Append(kiwi::span(static_cast<std::string_view>(s)));
+    records.push_back({std::move(s), offset});
+  }
+
+  // Request a shuffled subset, including a duplicate.
+  std::mt19937 rng{7};
+  std::vector<std::size_t> picks;
+
+  for (int i = 0; i < kNum; i += 3) {
+    picks.push_back(i);
+  }
+
+  picks.push_back(picks.front());
+  std::shuffle(picks.begin(), picks.end(), rng);
+
+  std::vector<Segment::Offset> offsets;
+
+  for (auto pick : picks) {
+    offsets.push_back(records[pick].offset);
+  }
+
+  auto read_back = segment.ReadBatch(offsets);
+
+  ASSERT_EQ(picks.size(), read_back.size());
+
+  for (std::size_t i = 0; i < picks.size(); ++i) {
+    EXPECT_EQ(records[picks[i]].data, read_back[i])
+        << " at offset: " << offsets[i];
+  }
+
+  EXPECT_TRUE(segment.ReadBatch({}).empty());
+}
+
+TEST(Segment, ReadIntoCallerBuffers) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  Segment segment{temp_file.Path()};
+
+  const std::string small = "small";
+  const std::string large(Segment::kMaxBlockSize * 3 + 17, 'X');
+  auto small_offset =
+      segment.Append(kiwi::span(static_cast<std::string_view>(small)));
+  auto large_offset =
+      segment.Append(kiwi::span(static_cast<std::string_view>(large)));
+
+  std::vector<char> buf(small.size());
+  Segment::Offset next_offset = 0;
+
+  EXPECT_EQ(small.size(),
+            segment.ReadAt(small_offset, kiwi::span(buf), &next_offset));
+  EXPECT_EQ(small, std::string(buf.begin(), buf.end()));
+  EXPECT_EQ(large_offset, next_offset);
+
+  // A buffer that is too small reports the size it needs.
+  EXPECT_EQ(large.size(), segment.ReadAt(large_offset, kiwi::span(buf)));
+
+  buf.resize(large.size());
+  EXPECT_EQ(large.size(), segment.ReadAt(large_offset, kiwi::span(buf)));
+  EXPECT_EQ(large, std::string(buf.begin(), buf.end()));
+
+  auto io_buf = segment.ReadIOBufAt(large_offset, &next_offset);
+  std::string chained;
+  auto fragment = io_buf.get();
+
+  do {
+    chained.append(reinterpret_cast<const char*>(fragment->Data()),
+                   fragment->Length());
+    fragment = fragment->Next();
+  } while (fragment != nullptr && fragment != io_buf.get());
+
+  EXPECT_EQ(large.size(), io_buf->ComputeChainDataLength());
+  EXPECT_EQ(large, chained);
+  EXPECT_EQ(segment.Size(), next_offset);
+}
+
+TEST(Segment, AppendVMatchesAppend) {
+  kiwi::ScopedTempFile vec_file;
+  kiwi::ScopedTempFile flat_file;
+  ASSERT_TRUE(vec_file.Create());
+  ASSERT_TRUE(flat_file.Create());
+
+  Segment vec_segment{vec_file.Path()};
+  Segment flat_segment{flat_file.Path()};
+
+  const std::string header = "hdr";
+  const std::string key = "key-0001";
+  const std::string value(Segment::kMaxBlockSize * 2 + 5, 'V');
+
+  for (int i = 0; i < 3; ++i) {
+    const Slice slices[] = {
+        kiwi::span(static_cast<std::string_view>(header)),
+        kiwi::span(static_cast<std::string_view>(key)),
+        kiwi::span(static_cast<std::string_view>(value)),
+        Slice{},
+    };
+    const auto flat = header + key + value;
+
+    auto offset = vec_segment.AppendV(slices);
+    EXPECT_EQ(offset, flat_segment.Append(
+                          kiwi::span(static_cast<std::string_view>(flat))));
+    EXPECT_EQ(flat, vec_segment.ReadAt(offset));
+  }
+
+  // An empty record still takes up a chunk.
+  auto offset = vec_segment.AppendV({});
+  EXPECT_EQ(offset, flat_segment.Append(Slice{}));
+  EXPECT_EQ("", vec_segment.ReadAt(offset));
+
+  // Chunk boundaries, and so CRCs, do not depend on how the record is split.
+  ASSERT_EQ(flat_segment.Size(), vec_segment.Size());
+
+  std::vector<char> vec_bytes(vec_segment.Size());
+  std::vector<char> flat_bytes(flat_segment.Size());
+  vec_segment.ReadRaw(0, kiwi::span(vec_bytes));
+  flat_segment.ReadRaw(0, kiwi::span(flat_bytes));
+  EXPECT_EQ(flat_bytes, vec_bytes);
+}
+
+TEST(Segment, ReadsV1AndWritesV2) {
+  kiwi::ScopedTempFile v1_file;
+  kiwi::ScopedTempFile v2_file;
+  ASSERT_TRUE(v1_file.Create());
+  ASSERT_TRUE(v2_file.Create());
+
+  const std::string small = "hello";
+  const std::string large(Segment::kMaxBlockSize * 2, 'L');
+  std::vector<Segment::Offset> offsets;
+
+  {
+    Segment v1{v1_file.Path(), {Segment::kFormatV1, Segment::kMaxBlockSize}};
+    Segment v2{v2_file.Path()};
+
+    offsets.push_back(v1.Append(kiwi::span(std::string_view{small})));
+    offsets.push_back(v1.Append(kiwi::span(std::string_view{large})));
+
+    // The segment header is written along with the first record, and small
+    // records take a 5-byte chunk header instead of a 7-byte one.
+    EXPECT_EQ(Segment::kSegmentHeaderSize,
+              v2.Append(kiwi::span(std::string_view{small})));
+    EXPECT_EQ(Segment::kSegmentHeaderSize + 5 + small.size(), v2.Size());
+    EXPECT_EQ(small.size() + Segment::kChunkHeaderSize, offsets[1]);
+  }
+
+  // Old segments are detected as such on reopening, and keep their format.
+  Segment v1{v1_file.Path()};
+
+  EXPECT_TRUE(v1.IsValid());
+  EXPECT_EQ(Segment::kFormatV1, v1.GetFormat().version);
+  EXPECT_EQ(small, v1.ReadAt(offsets[0]));
+  EXPECT_EQ(large, v1.ReadAt(offsets[1]));
+
+  auto offset = v1.Append(kiwi::span(std::string_view{small}));
+  EXPECT_EQ(small, v1.ReadAt(offset));
+  EXPECT_EQ(offset, v1.NextRecordOffset(offsets[1]));
+
+  Segment v2{v2_file.Path(), {Segment::kFormatV1, Segment::kMaxBlockSize}};
+
+  EXPECT_EQ(Segment::kFormatV2, v2.GetFormat().version);
+  EXPECT_EQ(small, v2.ReadAt(0));
+}
+
+TEST(Segment, LargeBlocks) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  constexpr int64_t kBlockSize = 1024 * 1024;
+  const std::string large(kBlockSize * 3 / 2, 'B');
+  std::vector<std::string> records;
+  std::vector<Segment::Offset> offsets;
+
+  {
+    Segment segment{temp_file.Path(), {Segment::kFormatV2, kBlockSize}};
+
+    for (int i = 0; i < 64; ++i) {
+      records.push_back(i % 8 == 0 ? large : std::string(i * 100, 'a' + i));
+      offsets.push_back(segment.Append(
+          kiwi::span(static_cast<std::string_view>(records.back()))));
+    }
+
+    // A record spanning one and a half blocks takes two chunks.
+    EXPECT_EQ(*segment.NextRecordOffset(offsets[0]),
+              offsets[0] + large.size() + 2 * Segment::kMaxChunkHeaderSize);
+  }
+
+  Segment segment{temp_file.Path()};
+
+  EXPECT_EQ(kBlockSize, segment.GetFormat().block_size);
+
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i], segment.ReadAt(offsets[i])) << " at record: " << i;
+  }
+
+  EXPECT_EQ(records, segment.ReadBatch(offsets));
+}
+
+template <typename T>
+class BasicSegmentTest : public testing::Test {};
+
+using SegmentTypes =
+    testing::Types<BasicSegment<4096>, DefaultSegment,
+                   BasicSegment<kDynamicBlockSize>,
+                   BasicSegment<kDynamicBlockSize, Crc32cChecksum>,
+                   BasicSegment<4096, XXH64Checksum>, Segment>;
+TYPED_TEST_SUITE(BasicSegmentTest, SegmentTypes);
+
+TYPED_TEST(BasicSegmentTest, WriteAndReadBack) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  std::vector<std::string> records;
+  std::vector<Segment::Offset> offsets;
+
+  {
+    TypeParam segment{temp_file.Path()};
+
+    for (int i = 0; i < 256; ++i) {
+      records.push_back(GenerateRandomString(i % 16 == 0 ? 20000 : 100));
+      offsets.push_back(segment.Append(
+          kiwi::span(static_cast<std::string_view>(records.back()))));
+    }
+  }
+
+  TypeParam segment{temp_file.Path()};
+
+  ASSERT_TRUE(segment.IsValid());
+
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i], segment.ReadAt(offsets[i])) << " at record: " << i;
+  }
+
+  EXPECT_EQ(records, segment.ReadBatch(offsets));
+}
+
+TEST(Segment, FixedBlockSizeRejectsOtherBlockSizes) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  {
+    BasicSegment<4096> segment{temp_file.Path()};
+    segment.Append(kiwi::span(std::string_view{"hello"}));
+  }
+
+  BasicSegment<Segment::kMaxBlockSize> fixed{temp_file.Path()};
+  EXPECT_FALSE(fixed.IsValid());
+
+  Segment segment{temp_file.Path()};
+
+  EXPECT_TRUE(segment.IsValid());
+  EXPECT_EQ(4096, segment.GetFormat().block_size);
+  EXPECT_EQ("hello", segment.ReadAt(0));
+}
+
+TEST(Segment, ChecksumRecordedPerSegment) {
+  for (auto checksum : {ChecksumType::kCrc32, ChecksumType::kCrc32c,
+                        ChecksumType::kXXH64}) {
+    kiwi::ScopedTempFile temp_file;
+    ASSERT_TRUE(temp_file.Create());
+
+    auto record = GenerateRandomString(Segment::kMaxBlockSize);
+
+    {
+      Segment segment{temp_file.Path(),
+                      {Segment::kFormatV2, Segment::kMaxBlockSize, checksum}};
+      segment.Append(kiwi::span(std::string_view{"hello"}));
+      segment.Append(kiwi::span(static_cast<std::string_view>(record)));
+    }
+
+    Segment segment{temp_file.Path()};
+
+    ASSERT_TRUE(segment.IsValid());
+    EXPECT_EQ(checksum, segment.GetFormat().checksum);
+    EXPECT_EQ("hello", segment.ReadAt(0));
+    EXPECT_EQ(record, segment.ReadAt(segment.NextRecordOffset(0).value()));
+
+    // Fixed policies only accept the segments recorded with their checksum.
+    DefaultSegment crc32{temp_file.Path()};
+    BasicSegment<kDynamicBlockSize, XXH64Checksum> xxh64{temp_file.Path()};
+
+    EXPECT_EQ(checksum == ChecksumType::kCrc32, crc32.IsValid());
+    EXPECT_EQ(checksum == ChecksumType::kXXH64, xxh64.IsValid());
+  }
+}
+
+TEST(Segment, AppendPacked) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  Segment segment{temp_file.Path()};
+
+  constexpr int kNum = 5000;
+  std::vector<std::string> records;
+  std::vector<Slice> slices;
+
+  for (int i = 0; i < kNum; ++i) {
+    records.push_back(std::string(1 + i * 37 % 80, 'a' + i % 26));
+  }
+
+  // One oversized record forces a packed chunk to end before it.
+  records[kNum / 2] = std::string(Segment::kMaxBlockSize, 'O');
+
+  for (const auto& record : records) {
+    slices.push_back(kiwi::span(static_cast<std::string_view>(record)));
+  }
+
+  std::vector<std::pair<Segment::Offset, std::size_t>> positions;
+  int64_t payload_size = 0;
+
+  for (std::size_t i = 0; i < slices.size();) {
+    std::size_t count = 0;
+    auto offset =
+        segment.AppendPacked(kiwi::span(slices).subspan(i), &count);
+
+    ASSERT_GE(count, 1);
+
+    for (std::size_t j = 0; j < count; ++j) {
+      positions.emplace_back(offset, j);
+      payload_size += slices[i + j].size();
+    }
+
+    EXPECT_EQ(records.begin() + i + count,
+              std::mismatch(records.begin() + i, records.begin() + i + count,
+                            segment.ReadPackedAt(offset).begin())
+                  .first);
+    i += count;
+  }
+
+  for (int i = 0; i < kNum; ++i) {
+    auto [offset, index] = positions[i];
+
+    EXPECT_EQ(records[i], segment.ReadPackedAt(offset, index))
+        << " at record: " << i;
+  }
+
+  EXPECT_FALSE(segment.ReadPackedAt(positions.back().first,
+                                    positions.back().second + 1));
+
+  // Packed records cost about one byte each beyond their payload, plus the
+  // blocks' padding and chunk headers.
+  EXPECT_LT(segment.Size(), payload_size + kNum * 2 +
+                                (segment.Size() / Segment::kMaxBlockSize + 1) *
+                                    Segment::kMaxBlockSize / 64);
+
+  // Records are walked past packed chunks like any other record.
+  Segment::Offset offset = positions.front().first;
+  int num_chunks = 0;
+
+  while (auto next = segment.NextRecordOffset(offset)) {
+    offset = *next;
+    ++num_chunks;
+  }
+
+  EXPECT_EQ(segment.Size(), offset);
+  EXPECT_LT(num_chunks, kNum / 50);
+}
+
+TEST(Segment, ReadPartialDetectsCorruptedChunks) {
+  kiwi::ScopedTempFile temp_file;
+  ASSERT_TRUE(temp_file.Create());
+
+  Segment::Offset first, second, third;
+
+  {
+    Segment segment{temp_file.Path()};
+    first = segment.Append(kiwi::span(std::string_view{"first"}));
+    second = segment.Append(kiwi::span(std::string_view{"second"}));
+    third = segment.Append(kiwi::span(std::string_view{"third"}));
+  }
+
+  {
+    // Flip a payload byte of the second record and tear off the end of the
+    // third one, as a crash in the middle of an append would.
+    kiwi::File file{temp_file.Path(), kiwi::File::kFlagOpen |
+                                          kiwi::File::kFlagRead |
+                                          kiwi::File::kFlagWrite};
+    char byte;
+    ASSERT_EQ(1, file.Read(third - 1, &byte, 1));
+    byte ^= 0x40;
+    ASSERT_EQ(1, file.Write(third - 1, &byte, 1));
+    ASSERT_TRUE(file.SetLength(file.GetLength() - 3));
+  }
+
+  Segment segment{temp_file.Path()};
+  ASSERT_TRUE(segment.IsValid());
+
+  std::string data;
+  Segment::Offset next_offset = 0;
+
+  EXPECT_EQ(Segment::ReadResult::kEnded,
+            segment.ReadPartialAt(first, segment.Size(), &data, &next_offset));
+  EXPECT_EQ("first", data);
+  EXPECT_EQ(second, next_offset);
+
+  data.clear();
+  EXPECT_EQ(Segment::ReadResult::kCorrupted,
+            segment.ReadPartialAt(second, segment.Size(), &data));
+
+  data.clear();
+  EXPECT_EQ(Segment::ReadResult::kCorrupted,
+            segment.ReadPartialAt(third, segment.Size(), &data));
+
+  // The corrupted chunks do not hide the first record either.
+  EXPECT_EQ(first, segment.FirstRecordOffset(segment.Size()));
+}
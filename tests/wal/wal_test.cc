@@ -0,0 +1,395 @@
+#include "rosekv/wal/wal.hh"
+
+#include <gtest/gtest.h>
+
+#include <kiwi/containers/span.hh>
+#include <kiwi/io/file_enumerator.hh>
+#include <kiwi/io/scoped_temp_dir.hh>
+#include <vector>
+#include <string>
+#include <thread>
+
+using namespace rosekv;
+
+static int CountSegmentFiles(const kiwi::FilePath& dir) {
+  int count = 0;
+  kiwi::FileEnumerator file_iter(dir, false, kiwi::FileEnumerator::kFiles);
+
+  for (auto fp = file_iter.Next(); !fp.empty(); fp = file_iter.Next()) {
+    count += fp.Extension() == kDefSegFileExtension;
+  }
+
+  return count;
+}
+
+class WALTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+
+    options_.wal_dir = temp_dir_.GetPath().value();
+    options_.max_segment_sz = 4 * Segment::kMaxBlockSize;
+  }
+
+  kiwi::ScopedTempDir temp_dir_;
+  Options options_;
+};
+
+TEST(LSN, PacksSegmentIdAndOffset) {
+  constexpr LSN kLsn{7, 4096};
+
+  static_assert(kLsn.GetSegmentId() == 7);
+  static_assert(kLsn.GetOffset() == 4096);
+  static_assert(LSN::FromValue(kLsn.Value()) == kLsn);
+
+  EXPECT_FALSE(LSN{}.IsValid());
+  EXPECT_LT(LSN(1, LSN::kMaxOffset), LSN(2, 0));
+  EXPECT_LT(LSN(2, 0), LSN(2, 1));
+}
+
+TEST_F(WALTest, WriteAndReadBackByLSN) {
+  constexpr int kNumRecords = 64;
+  std::vector<std::pair<LSN, std::string>> records;
+
+  {
+    WAL wal{options_};
+    std::error_code ec;
+
+    for (int i = 0; i < kNumRecords; ++i) {
+      // Mix small and multi-block records so the log spans several segments.
+      auto data = i % 4 == 0
+                      ? std::string(Segment::kMaxBlockSize + i, 'a' + i % 26)
+                      : "record-" + std::to_string(i);
+      auto lsn =
+          wal.Write(kiwi::span(static_cast<std::string_view>(data)), ec);
+      ASSERT_FALSE(ec) << ec.message();
+      ASSERT_TRUE(lsn.IsValid());
+
+      if (!records.empty()) {
+        EXPECT_LT(records.back().first, lsn);
+      }
+
+      records.emplace_back(lsn, std::move(data));
+    }
+
+    ASSERT_GT(records.back().first.GetSegmentId(),
+              records.front().first.GetSegmentId());
+  }
+
+  // Sealed segments are reopened lazily through a cache smaller than the
+  // number of segments.
+  options_.max_open_segments = 1;
+  WAL wal{options_};
+
+  for (const auto& [lsn, data] : records) {
+    std::error_code ec;
+    EXPECT_EQ(data, wal.Read(lsn, ec)) << "at LSN: " << lsn;
+    EXPECT_FALSE(ec) << ec.message();
+  }
+
+  std::error_code ec;
+  wal.Read({records.back().first.GetSegmentId() + 1, 0}, ec);
+  EXPECT_EQ(make_error_code(WALError::kSegmentNotFound), ec);
+}
+
+TEST_F(WALTest, TruncateAfterContinuesFromCut) {
+  const std::string large(Segment::kMaxBlockSize, 'L');
+  std::vector<LSN> lsns;
+
+  WAL wal{options_};
+  std::error_code ec;
+
+  for (int i = 0; i < 16; ++i) {
+    lsns.push_back(
+        wal.Write(kiwi::span(static_cast<std::string_view>(large)), ec));
+    ASSERT_FALSE(ec) << ec.message();
+  }
+
+  auto keep = lsns[3];
+  ASSERT_LT(keep.GetSegmentId(), lsns.back().GetSegmentId());
+
+  wal.TruncateAfter(keep, ec);
+  ASSERT_FALSE(ec) << ec.message();
+
+  EXPECT_EQ(large, wal.Read(keep, ec));
+  EXPECT_FALSE(ec);
+
+  wal.Read(lsns[4], ec);
+  EXPECT_TRUE(ec);
+  ec.clear();
+
+  // Appends continue right after the kept record.
+  auto next = wal.Write(kiwi::span(std::string_view{"new leader"}), ec);
+  ASSERT_FALSE(ec) << ec.message();
+  EXPECT_EQ(lsns[4], next);
+  EXPECT_EQ("new leader", wal.Read(next, ec));
+
+  // The middle of a record is not a valid cut.
+  wal.TruncateAfter({keep.GetSegmentId(), keep.GetOffset() + 1}, ec);
+  EXPECT_EQ(make_error_code(WALError::kInvalidOffset), ec);
+}
+
+TEST_F(WALTest, TruncateFromDiscardsRecord) {
+  const std::string large(Segment::kMaxBlockSize, 'L');
+  std::vector<LSN> lsns;
+
+  WAL wal{options_};
+  std::error_code ec;
+
+  for (int i = 0; i < 16; ++i) {
+    lsns.push_back(
+        wal.Write(kiwi::span(static_cast<std::string_view>(large)), ec));
+    ASSERT_FALSE(ec) << ec.message();
+  }
+
+  ASSERT_LT(lsns[4].GetSegmentId(), lsns.back().GetSegmentId());
+
+  wal.TruncateFrom(lsns[4], ec);
+  ASSERT_FALSE(ec) << ec.message();
+
+  EXPECT_EQ(large, wal.Read(lsns[3], ec));
+  EXPECT_FALSE(ec);
+
+  wal.Read(lsns[4], ec);
+  EXPECT_TRUE(ec);
+  ec.clear();
+
+  // Appends take the place of the discarded record.
+  auto next = wal.Write(kiwi::span(std::string_view{"replayed"}), ec);
+  ASSERT_FALSE(ec) << ec.message();
+  EXPECT_EQ(lsns[4], next);
+  EXPECT_EQ("replayed", wal.Read(next, ec));
+
+  // The cut cannot lie past the end of its segment.
+  wal.TruncateFrom({next.GetSegmentId(), LSN::kMaxOffset}, ec);
+  EXPECT_EQ(make_error_code(WALError::kInvalidOffset), ec);
+}
+
+TEST_F(WALTest, TruncateBeforeDeletesSealedSegments) {
+  const std::string record(Segment::kMaxBlockSize, 'W');
+  constexpr int kNumRecords = 16;
+
+  {
+    WAL wal{options_};
+    std::error_code ec;
+
+    for (int i = 0; i < kNumRecords; ++i) {
+      wal.Write(kiwi::span(static_cast<std::string_view>(record)), ec);
+      ASSERT_FALSE(ec) << ec.message();
+    }
+
+    ASSERT_GT(CountSegmentFiles(temp_dir_.GetPath()), 1);
+
+    // Positions past the active segment are clamped to it.
+    auto num_truncated = wal.TruncateBefore({LSN::kMaxSegmentId, 0});
+
+    EXPECT_GT(num_truncated, 0);
+    EXPECT_EQ(0, wal.TruncateBefore({}));
+  }
+
+  // Destroying the WAL waits for the reclaim thread.
+  EXPECT_EQ(1, CountSegmentFiles(temp_dir_.GetPath()));
+
+  // The remaining segment reopens as a contiguous log.
+  WAL wal{options_};
+  std::error_code ec;
+
+  EXPECT_FALSE(wal.Status());
+  wal.Write(kiwi::span(static_cast<std::string_view>(record)), ec);
+  EXPECT_FALSE(ec) << ec.message();
+}
+
+TEST_F(WALTest, FirstSegmentIdOnlyAppliesToEmptyDirectory) {
+  const std::string record(16, 'W');
+  options_.first_segment_id = 5;
+
+  {
+    WAL wal{options_};
+    std::error_code ec;
+
+    ASSERT_FALSE(wal.Status());
+    auto lsn = wal.Write(kiwi::span(static_cast<std::string_view>(record)), ec);
+    ASSERT_FALSE(ec) << ec.message();
+    EXPECT_EQ(5u, lsn.GetSegmentId());
+  }
+
+  // The ids of existing segments take precedence.
+  options_.first_segment_id = 1;
+  WAL wal{options_};
+  std::error_code ec;
+
+  ASSERT_FALSE(wal.Status());
+  EXPECT_EQ(LSN(5, 0), wal.GetBeginLSN());
+  EXPECT_EQ(6u, wal.SwitchSegment(ec).GetSegmentId());
+  EXPECT_FALSE(ec) << ec.message();
+}
+
+TEST_F(WALTest, SwitchSegmentSeparatesRecords) {
+  WAL wal{options_};
+  std::error_code ec;
+
+  auto write = [&](const std::string& data) {
+    return wal.Write(kiwi::span(static_cast<std::string_view>(data)), ec);
+  };
+
+  write("old-1");
+  write("old-2");
+
+  auto switch_lsn = wal.SwitchSegment(ec);
+  ASSERT_FALSE(ec) << ec.message();
+  EXPECT_EQ(2, CountSegmentFiles(temp_dir_.GetPath()));
+
+  // An empty segment is sealed as well.
+  auto empty_lsn = wal.SwitchSegment(ec);
+  EXPECT_EQ(switch_lsn.GetSegmentId() + 1, empty_lsn.GetSegmentId());
+
+  auto lsn = write("new-1");
+  ASSERT_FALSE(ec) << ec.message();
+  EXPECT_GE(lsn, empty_lsn);
+
+  // Readers step over the empty segment.
+  auto iter = wal.Subscribe();
+  std::vector<std::string> received;
+
+  while (iter->Next(std::chrono::milliseconds(0), ec)) {
+    received.emplace_back(iter->GetData());
+  }
+
+  ASSERT_FALSE(ec) << ec.message();
+  EXPECT_EQ((std::vector<std::string>{"old-1", "old-2", "new-1"}), received);
+
+  // Truncating at the switch drops exactly the records written before it.
+  EXPECT_EQ(1, wal.TruncateBefore(switch_lsn));
+  EXPECT_EQ("new-1", wal.Read(lsn, ec));
+  EXPECT_FALSE(ec) << ec.message();
+}
+
+TEST_F(WALTest, SubscribeDeliversRecordsInOrder) {
+  constexpr int kNumBacklog = 32;
+  constexpr int kNumLive = 256;
+
+  WAL wal{options_};
+  std::error_code ec;
+  std::vector<std::pair<LSN, std::string>> records;
+
+  auto write = [&](int i) {
+    auto data = i % 16 == 0 ? std::string(Segment::kMaxBlockSize, 'a' + i % 26)
+                            : "record-" + std::to_string(i);
+    auto lsn = wal.Write(kiwi::span(static_cast<std::string_view>(data)), ec);
+    records.emplace_back(lsn, std::move(data));
+  };
+
+  // Records written before subscribing are read back from the segments.
+  for (int i = 0; i < kNumBacklog; ++i) {
+    write(i);
+  }
+
+  auto iter = wal.Subscribe();
+  std::thread writer{[&] {
+    for (int i = kNumBacklog; i < kNumBacklog + kNumLive; ++i) {
+      write(i);
+    }
+  }};
+
+  std::vector<std::pair<LSN, std::string>> received;
+  std::error_code iter_ec;
+
+  while (received.size() < kNumBacklog + kNumLive &&
+         iter->Next(std::chrono::seconds(10), iter_ec)) {
+    received.emplace_back(iter->GetLSN(), iter->GetData());
+  }
+
+  writer.join();
+
+  ASSERT_FALSE(ec) << ec.message();
+  ASSERT_FALSE(iter_ec) << iter_ec.message();
+  EXPECT_EQ(records, received);
+
+  // Nothing else has been written.
+  EXPECT_FALSE(iter->Next(std::chrono::milliseconds(10), iter_ec));
+  EXPECT_FALSE(iter_ec);
+}
+
+TEST_F(WALTest, BlockSizeOnlyAppliesToNewSegments) {
+  const std::string record(Segment::kMaxBlockSize * 3 / 2, 'R');
+  std::vector<LSN> lsns;
+
+  for (auto block_size : {Segment::kMaxBlockSize, 256 * 1024}) {
+    options_.block_size = block_size;
+    options_.max_segment_sz = 4 * block_size;
+
+    WAL wal{options_};
+    std::error_code ec;
+
+    for (int i = 0; i < 8; ++i) {
+      lsns.push_back(
+          wal.Write(kiwi::span(static_cast<std::string_view>(record)), ec));
+      ASSERT_FALSE(ec) << ec.message();
+    }
+  }
+
+  WAL wal{options_};
+
+  for (auto lsn : lsns) {
+    std::error_code ec;
+    EXPECT_EQ(record, wal.Read(lsn, ec)) << "at LSN: " << lsn;
+    EXPECT_FALSE(ec) << ec.message();
+  }
+}
+
+TEST_F(WALTest, RecordsSpanSegments) {
+  // Records from a few bytes to several segments long, some of them split
+  // right at a segment boundary.
+  std::vector<std::pair<LSN, std::string>> records;
+
+  {
+    WAL wal{options_};
+    std::error_code ec;
+
+    for (int i = 0; i < 48; ++i) {
+      auto size = i % 6 == 0 ? options_.max_segment_sz * (i % 4 + 1) + i
+                             : Segment::kMaxBlockSize * (i % 3) + i * 100;
+      std::string data(size, 'a' + i % 26);
+      auto lsn =
+          wal.Write(kiwi::span(static_cast<std::string_view>(data)), ec);
+      ASSERT_FALSE(ec) << ec.message();
+
+      records.emplace_back(lsn, std::move(data));
+    }
+
+    records.emplace_back(wal.Write(Slice{}, ec), "");
+    ASSERT_FALSE(ec) << ec.message();
+  }
+
+  WAL wal{options_};
+
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    std::error_code ec;
+    EXPECT_EQ(records[i].second, wal.Read(records[i].first, ec))
+        << "at LSN: " << records[i].first;
+    EXPECT_FALSE(ec) << ec.message();
+  }
+
+  // Subscribers follow records across segments, and skip segments holding
+  // nothing but the middle of a record.
+  auto iter = wal.Subscribe();
+  std::error_code ec;
+
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    ASSERT_TRUE(iter->Next(std::chrono::seconds(10), ec)) << ec.message();
+    EXPECT_EQ(records[i].first, iter->GetLSN());
+    EXPECT_EQ(records[i].second, iter->GetData()) << "at record: " << i;
+  }
+
+  // Truncating after a record spanning segments keeps all of it.
+  auto keep = records[12];
+
+  wal.TruncateAfter(keep.first, ec);
+  ASSERT_FALSE(ec) << ec.message();
+  EXPECT_EQ(keep.second, wal.Read(keep.first, ec));
+  EXPECT_GT(wal.GetEndLSN().GetSegmentId(), keep.first.GetSegmentId());
+
+  auto next = wal.Write(kiwi::span(std::string_view{"after"}), ec);
+  EXPECT_EQ(records[13].first, next);
+  EXPECT_EQ("after", wal.Read(next, ec));
+}